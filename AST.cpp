@@ -22,6 +22,7 @@
 #include "HandleType.h"
 #include "Interface.h"
 #include "Location.h"
+#include "ScalarType.h"
 #include "Scope.h"
 #include "TypeDef.h"
 
@@ -48,12 +49,29 @@ Scope* AST::getRootScope() {
 // used by the parser.
 void AST::addSyntaxError() {
     mSyntaxErrors++;
+    mCoordinator->recordError();
 }
 
 size_t AST::syntaxErrors() const {
     return mSyntaxErrors;
 }
 
+bool AST::errorLimitReached() const {
+    return mCoordinator->errorLimitReached();
+}
+
+std::function<status_t(const Type*)> AST::continueOnError(
+    const std::function<status_t(const Type*)>& func, bool* failed) const {
+    return [this, func, failed](const Type* type) -> status_t {
+        status_t err = func(type);
+        if (err != OK) {
+            *failed = true;
+            if (!mCoordinator->recordError()) return err;
+        }
+        return OK;
+    };
+}
+
 const std::string& AST::getFilename() const {
     return mFileHash->getPath();
 }
@@ -187,7 +205,8 @@ status_t AST::setParseStage(Type::ParseStage oldStage, Type::ParseStage newStage
 
 status_t AST::lookupTypes() {
     std::unordered_set<const Type*> visited;
-    return mRootScope.recursivePass(
+    bool failed = false;
+    status_t err = mRootScope.recursivePass(
         Type::ParseStage::PARSE,
         [&](Type* type) -> status_t {
             Scope* scope = type->isScope() ? static_cast<Scope*>(type) : type->parent();
@@ -202,7 +221,13 @@ status_t AST::lookupTypes() {
                     std::cerr << "ERROR: Failed to lookup type '"
                               << nextRef->getLookupFqName().string() << "' at "
                               << nextRef->location() << "\n";
-                    return UNKNOWN_ERROR;
+                    failed = true;
+                    if (!mCoordinator->recordError()) return UNKNOWN_ERROR;
+
+                    // Keep looking for other unresolved references. This AST
+                    // fails right after this pass, so the placeholder is
+                    // never used for anything but finishing the traversal.
+                    nextType = new ScalarType(ScalarType::KIND_INT32, &mRootScope);
                 }
                 nextRef->set(nextType);
             }
@@ -210,6 +235,9 @@ status_t AST::lookupTypes() {
             return OK;
         },
         &visited);
+    if (err != OK) return err;
+
+    return failed ? UNKNOWN_ERROR : OK;
 }
 
 status_t AST::gatherReferencedTypes() {
@@ -274,16 +302,22 @@ status_t AST::lookupConstantExpressions() {
 
 status_t AST::validateDefinedTypesUniqueNames() const {
     std::unordered_set<const Type*> visited;
-    return mRootScope.recursivePass(
+    bool failed = false;
+    status_t err = mRootScope.recursivePass(
         Type::ParseStage::POST_PARSE,
-        [&](const Type* type) -> status_t {
-            // We only want to validate type definition names in this place.
-            if (type->isScope()) {
-                return static_cast<const Scope*>(type)->validateUniqueNames();
-            }
-            return OK;
-        },
+        continueOnError(
+            [](const Type* type) -> status_t {
+                // We only want to validate type definition names in this place.
+                if (type->isScope()) {
+                    return static_cast<const Scope*>(type)->validateUniqueNames();
+                }
+                return OK;
+            },
+            &failed),
         &visited);
+    if (err != OK) return err;
+
+    return failed ? UNKNOWN_ERROR : OK;
 }
 
 status_t AST::resolveInheritance() {
@@ -309,7 +343,12 @@ status_t AST::evaluateConstantExpressions() {
 
 status_t AST::validate() const {
     std::unordered_set<const Type*> visited;
-    return mRootScope.recursivePass(Type::ParseStage::POST_PARSE, &Type::validate, &visited);
+    bool failed = false;
+    status_t err = mRootScope.recursivePass(Type::ParseStage::POST_PARSE,
+                                            continueOnError(&Type::validate, &failed), &visited);
+    if (err != OK) return err;
+
+    return failed ? UNKNOWN_ERROR : OK;
 }
 
 status_t AST::topologicalReorder() {
@@ -349,16 +388,22 @@ status_t AST::checkAcyclicConstantExpressions() const {
 
 status_t AST::checkForwardReferenceRestrictions() const {
     std::unordered_set<const Type*> visited;
-    return mRootScope.recursivePass(Type::ParseStage::POST_PARSE,
-                                    [](const Type* type) -> status_t {
-                                        for (const Reference<Type>* ref : type->getReferences()) {
-                                            status_t err =
-                                                type->checkForwardReferenceRestrictions(*ref);
-                                            if (err != OK) return err;
-                                        }
-                                        return OK;
-                                    },
-                                    &visited);
+    bool failed = false;
+    status_t err = mRootScope.recursivePass(
+        Type::ParseStage::POST_PARSE,
+        continueOnError(
+            [](const Type* type) -> status_t {
+                for (const Reference<Type>* ref : type->getReferences()) {
+                    status_t err = type->checkForwardReferenceRestrictions(*ref);
+                    if (err != OK) return err;
+                }
+                return OK;
+            },
+            &failed),
+        &visited);
+    if (err != OK) return err;
+
+    return failed ? UNKNOWN_ERROR : OK;
 }
 
 bool AST::addImport(const char *import) {
@@ -91,7 +91,8 @@ struct AST {
     // Recursive tree pass that sets ParseStage of all types to newStage.
     status_t setParseStage(Type::ParseStage oldStage, Type::ParseStage newStage);
 
-    // Recursive tree pass that looks up all referenced types
+    // Recursive tree pass that looks up all referenced types. All references
+    // which fail to resolve are reported (up to the error limit).
     status_t lookupTypes();
 
     // Recursive tree pass that looks up all referenced local identifiers
@@ -143,6 +144,9 @@ struct AST {
     void generateCppAdapterHeader(Formatter& out) const;
     void generateCppAdapterSource(Formatter& out) const;
 
+    void generateCppReplayHeader(Formatter& out) const;
+    void generateCppReplaySource(Formatter& out) const;
+
     void generateJava(Formatter& out, const std::string& limitToType) const;
     void generateJavaTypes(Formatter& out, const std::string& limitToType) const;
 
@@ -150,6 +154,11 @@ struct AST {
 
     void generateDependencies(Formatter& out) const;
 
+    // Reports performance hazards in the methods of the interface, one per
+    // line (see -Lperf-lint). Fails if a finding has severity error.
+    status_t generatePerfLint(Formatter& out) const;
+    static bool isPerfLintCheck(const std::string& name);
+
     void getImportedPackages(std::set<FQName> *importSet) const;
 
     // Run getImportedPackages on this, then run getImportedPackages on
@@ -181,6 +190,8 @@ struct AST {
     // used by the parser.
     void addSyntaxError();
     size_t syntaxErrors() const;
+    // Whether the parser should stop recovering from syntax errors.
+    bool errorLimitReached() const;
 
     bool isIBase() const;
 
@@ -235,6 +246,12 @@ struct AST {
     // used by the parser.
     size_t mSyntaxErrors = 0;
 
+    // Wraps the function of a validating pass so that the pass reports the
+    // error and moves on to the next type, up to the coordinator's error
+    // limit. *failed is set if func failed for any type.
+    std::function<status_t(const Type*)> continueOnError(
+        const std::function<status_t(const Type*)>& func, bool* failed) const;
+
     std::set<FQName> mReferencedTypeNames;
 
     // Helper functions for lookupType.
@@ -273,10 +290,26 @@ struct AST {
     void generateStubImplMethod(Formatter& out, const std::string& className,
                                 const Method* method) const;
     void generatePassthroughMethod(Formatter& out, const Method* method, const Interface* superInterface) const;
+    // With retained, emits <method>_retained instead of _hidl_<method>: the
+    // results are left in the reply parcel, which is moved into a
+    // <method>_reply handle (see generateRetainedReplyDeclaration).
     void generateStaticProxyMethodSource(Formatter& out, const std::string& className,
-                                         const Method* method, const Interface* superInterface) const;
+                                         const Method* method, const Interface* superInterface,
+                                         bool retained = false) const;
+    void generateRetainedReplyDeclaration(Formatter& out, const Method* method) const;
     void generateProxyMethodSource(Formatter& out, const std::string& className,
                                    const Method* method, const Interface* superInterface) const;
+    // Queue of the calls held back by @coalesce in the proxies of this file,
+    // and the proxy method of such a call.
+    void generateProxyCoalescingSource(Formatter& out) const;
+    void generateCoalescedProxyCall(Formatter& out, const Method* method,
+                                    const Interface* superInterface) const;
+    // Marshalling of the @delta argument of a method: the proxy writes the
+    // fields which changed since its previous call, and the stub reads them
+    // into the value it kept for that proxy (see generateStubDeltaSource).
+    void generateProxyDeltaWrite(Formatter& out, const Method* method) const;
+    void generateStubDeltaRead(Formatter& out, const Method* method) const;
+    void generateStubDeltaSource(Formatter& out) const;
     void generateAdapterMethod(Formatter& out, const Method* method) const;
 
     void generateFetchSymbol(Formatter &out, const std::string &ifaceName) const;
@@ -285,6 +318,15 @@ struct AST {
 
     void generateStubSource(Formatter& out, const Interface* iface) const;
 
+    // Admission policy of a stub for @admissionControl and @rateLimit.
+    void generateStubAdmissionSource(Formatter& out, const Interface* iface) const;
+
+    // Queue and worker thread of a stub for @callbackExecutor, and the
+    // queued call of a oneway method replacing the direct one.
+    void generateCallbackExecutorSource(Formatter& out, const Interface* iface) const;
+    void generateQueuedStubCall(Formatter& out, const Method* method,
+                                const std::string& callee) const;
+
     void generateStubSourceForMethod(Formatter& out, const Method* method,
                                      const Interface* superInterface) const;
     void generateStaticStubMethodSource(Formatter& out, const FQName& fqName,
@@ -294,6 +336,22 @@ struct AST {
 
     void generateInterfaceSource(Formatter& out) const;
 
+    // Static broadcast_<method> of the interface for each @broadcast method.
+    void generateBroadcastSignature(Formatter& out, const Method* method,
+                                    const std::string& className) const;
+    void generateBroadcastSource(Formatter& out, const Interface* iface) const;
+    void generateCallbackThreadsSource(Formatter& out, const Interface* iface) const;
+
+    void generateCallGroupDeclaration(Formatter& out, const Interface* iface) const;
+    void generateCallGroupSource(Formatter& out, const Interface* iface) const;
+    void generateCallGroupStubSource(Formatter& out, const Interface* iface) const;
+
+    // Shared memory channel of @sharedMemoryCalls: setup and calls on the
+    // proxy side, the thread serving a channel on the stub side, and the
+    // stub case which accepts a region.
+    void generateSharedMemoryCallsSource(Formatter& out, const Interface* iface) const;
+    void generateSharedMemorySetupStubSource(Formatter& out) const;
+
     enum InstrumentationEvent {
         SERVER_API_ENTRY = 0,
         SERVER_API_EXIT,
@@ -312,6 +370,12 @@ struct AST {
             InstrumentationEvent event,
             const Method *method) const;
 
+    // Reports the transaction started at _hidl_capture_start_ns to the
+    // recorder (see -T).
+    void generateCppCaptureCall(Formatter& out, const Method* method,
+                                const Interface* superInterface, const std::string& side,
+                                const std::string& flags) const;
+
     void generateCppInstrumentationCall(
             Formatter &out,
             InstrumentationEvent event,
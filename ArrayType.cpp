@@ -89,8 +89,8 @@ status_t ArrayType::validate() const {
     return Type::validate();
 }
 
-std::string ArrayType::getCppType(StorageMode mode,
-                                  bool specifyNamespaces) const {
+std::string ArrayType::computeCppType(StorageMode mode,
+                                      bool specifyNamespaces) const {
     const std::string base = mElementType->getCppStackType(specifyNamespaces);
 
     std::string space = specifyNamespaces ? "::android::hardware::" : "";
@@ -126,7 +126,7 @@ std::string ArrayType::getInternalDataCppType() const {
     return result;
 }
 
-std::string ArrayType::getJavaType(bool forInitializer) const {
+std::string ArrayType::computeJavaType(bool forInitializer) const {
     std::string base =
         mElementType->getJavaType(forInitializer);
 
@@ -145,7 +145,7 @@ std::string ArrayType::getJavaType(bool forInitializer) const {
     return base;
 }
 
-std::string ArrayType::getVtsType() const {
+std::string ArrayType::computeVtsType() const {
     return "TYPE_ARRAY";
 }
 
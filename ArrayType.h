@@ -49,14 +49,14 @@ struct ArrayType : public Type {
 
     status_t validate() const override;
 
-    std::string getCppType(StorageMode mode,
-                           bool specifyNamespaces) const override;
+    std::string computeCppType(StorageMode mode,
+                               bool specifyNamespaces) const override;
 
     std::string getInternalDataCppType() const;
 
-    std::string getJavaType(bool forInitializer) const override;
+    std::string computeJavaType(bool forInitializer) const override;
 
-    std::string getVtsType() const override;
+    std::string computeVtsType() const override;
 
     void emitReaderWriter(
             Formatter &out,
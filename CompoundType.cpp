@@ -16,12 +16,15 @@
 
 #include "CompoundType.h"
 
+#include "Annotation.h"
 #include "ArrayType.h"
 #include "ScalarType.h"
 #include "VectorType.h"
 
 #include <android-base/logging.h>
 #include <hidl-util/Formatter.h>
+#include <hidl-util/StringHelper.h>
+#include <algorithm>
 #include <iostream>
 #include <unordered_set>
 
@@ -29,7 +32,10 @@ namespace android {
 
 CompoundType::CompoundType(Style style, const char* localName, const FQName& fullName,
                            const Location& location, Scope* parent)
-    : Scope(localName, fullName, location, parent), mStyle(style), mFields(nullptr) {}
+    : Scope(localName, fullName, location, parent),
+      mStyle(style),
+      mFields(nullptr),
+      mFieldStorage(FIELD_STORAGE_NONE) {}
 
 CompoundType::Style CompoundType::style() const {
     return mStyle;
@@ -39,6 +45,118 @@ void CompoundType::setFields(std::vector<NamedReference<Type>*>* fields) {
     mFields = fields;
 }
 
+const std::vector<NamedReference<Type>*>& CompoundType::getFields() const {
+    return *mFields;
+}
+
+std::vector<CompoundType*> CompoundType::flattenNestedVectorFields() {
+    std::vector<CompoundType*> flattened;
+
+    for (auto* field : *mFields) {
+        // Only literal vec<vec<T>> is flattened, typedefs are not resolved yet.
+        if (!field->isResolved() || !field->shallowGet()->isVector()) {
+            continue;
+        }
+
+        const Type* outer = field->shallowGet();
+        const Reference<Type>* row = outer->getReferences().front();
+        if (!row->isResolved() || !row->shallowGet()->isVector()) {
+            continue;
+        }
+
+        const std::string name = "Flat" + StringHelper::Capitalize(field->name());
+        const Location location = field->location();
+
+        CompoundType* flat = new CompoundType(
+            STYLE_STRUCT, name.c_str(),
+            FQName(fqName().package(), fqName().version(), fqName().name() + "." + name),
+            location, this);
+        flat->mFieldStorage = FIELD_STORAGE_FLATTENED_VECTOR;
+
+        VectorType* offsets = new VectorType(flat);
+        offsets->setElementType(
+            Reference<Type>(new ScalarType(ScalarType::KIND_UINT32, flat), location));
+
+        flat->setFields(new std::vector<NamedReference<Type>*>{
+            new NamedReference<Type>("offsets", Reference<Type>(offsets, location), location),
+            new NamedReference<Type>("elements", *row, location)});
+
+        // Keeps the name and doc comment of the field.
+        static_cast<Reference<Type>&>(*field) = Reference<Type>(flat, location);
+
+        flattened.push_back(flat);
+    }
+
+    return flattened;
+}
+
+bool CompoundType::isFlattenedVector() const {
+    return mFieldStorage == FIELD_STORAGE_FLATTENED_VECTOR;
+}
+
+bool CompoundType::boundFields(Annotation* annotation, std::vector<CompoundType*>* bounded,
+                               std::string* errorMsg) {
+    for (AnnotationParam* param : annotation->params()) {
+        auto it = std::find_if(mFields->begin(), mFields->end(), [&](const auto* field) {
+            return field->name() == param->getName();
+        });
+        if (it == mFields->end()) {
+            *errorMsg = "@bounded refers to unknown field " + param->getName();
+            return false;
+        }
+        NamedReference<Type>* field = *it;
+
+        std::vector<ConstantExpression*> bound = param->getConstantExpressions();
+        if (bound.size() != 1) {
+            *errorMsg = "@bounded size of " + field->name() + " must be a constant expression";
+            return false;
+        }
+
+        // Only literal vec<T> and string are bounded, typedefs are not resolved yet.
+        const bool isString = field->isResolved() && field->shallowGet()->isString();
+        const bool isVector = field->isResolved() && field->shallowGet()->isVector();
+        if (!isString && !isVector) {
+            *errorMsg = "@bounded field " + field->name() + " must be declared as vec<T> or string";
+            return false;
+        }
+
+        const std::string name = "Bounded" + StringHelper::Capitalize(field->name());
+        const Location location = field->location();
+
+        CompoundType* storage = new CompoundType(
+            STYLE_STRUCT, name.c_str(),
+            FQName(fqName().package(), fqName().version(), fqName().name() + "." + name),
+            location, this);
+        storage->mFieldStorage =
+            isString ? FIELD_STORAGE_BOUNDED_STRING : FIELD_STORAGE_BOUNDED_VECTOR;
+
+        const Reference<Type> elementType =
+            isString ? Reference<Type>(new ScalarType(ScalarType::KIND_UINT8, storage), location)
+                     : Reference<Type>(*field->shallowGet()->getReferences().front());
+
+        storage->setFields(new std::vector<NamedReference<Type>*>{
+            new NamedReference<Type>(
+                "size",
+                Reference<Type>(new ScalarType(ScalarType::KIND_UINT32, storage), location),
+                location),
+            new NamedReference<Type>(
+                "elements", Reference<Type>(new ArrayType(elementType, bound[0], storage), location),
+                location)});
+
+        // Keeps the name and doc comment of the field.
+        static_cast<Reference<Type>&>(*field) = Reference<Type>(storage, location);
+
+        bounded->push_back(storage);
+    }
+
+    return true;
+}
+
+bool CompoundType::isBoundedStorage() const {
+    return mFieldStorage == FIELD_STORAGE_BOUNDED_VECTOR ||
+           mFieldStorage == FIELD_STORAGE_BOUNDED_STRING;
+}
+
 std::vector<const Reference<Type>*> CompoundType::getReferences() const {
     std::vector<const Reference<Type>*> ret;
     ret.insert(ret.begin(), mFields->begin(), mFields->end());
@@ -70,6 +188,22 @@ status_t CompoundType::validate() const {
         }
     }
 
+    if (hasJavaView()) {
+        if (mStyle != STYLE_STRUCT || containsInterface()) {
+            std::cerr << "ERROR: @javaView is only supported for structs without interfaces at "
+                      << location() << "\n";
+            return UNKNOWN_ERROR;
+        }
+
+        for (const auto* type : getSubTypes()) {
+            if (type->localName() == "View") {
+                std::cerr << "ERROR: @javaView struct cannot declare a type named View at "
+                          << type->location() << "\n";
+                return UNKNOWN_ERROR;
+            }
+        }
+    }
+
     if (mStyle == STYLE_SAFE_UNION && mFields->size() < 2) {
         std::cerr << "ERROR: Safe union must contain at least two types to be useful at "
                   << location() << "\n";
@@ -154,7 +288,7 @@ std::string CompoundType::typeName() const {
     CHECK(!"Should not be here");
 }
 
-std::string CompoundType::getCppType(
+std::string CompoundType::computeCppType(
         StorageMode mode,
         bool /* specifyNamespaces */) const {
     const std::string base = fullName();
@@ -172,11 +306,11 @@ std::string CompoundType::getCppType(
     CHECK(!"Should not be here");
 }
 
-std::string CompoundType::getJavaType(bool /* forInitializer */) const {
+std::string CompoundType::computeJavaType(bool /* forInitializer */) const {
     return fullJavaName();
 }
 
-std::string CompoundType::getVtsType() const {
+std::string CompoundType::computeVtsType() const {
     switch (mStyle) {
         case STYLE_STRUCT:
         {
@@ -194,6 +328,15 @@ std::string CompoundType::getVtsType() const {
     CHECK(!"Should not be here");
 }
 
+bool CompoundType::hasJavaView() const {
+    for (const auto* annotation : annotations()) {
+        if (annotation->name() == "javaView") {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool CompoundType::containsInterface() const {
     for (const auto& field : *mFields) {
         if (field->type().isCompoundType()) {
@@ -735,6 +878,13 @@ void CompoundType::emitTypeDeclarations(Formatter& out) const {
                 << ";\n";
         }
 
+        if (isFlattenedVector()) {
+            emitFlattenedVectorDeclarations(out);
+        }
+        if (isBoundedStorage()) {
+            emitBoundedStorageDeclarations(out);
+        }
+
         out.unindent();
         out << "};\n\n";
 
@@ -772,6 +922,13 @@ void CompoundType::emitTypeDeclarations(Formatter& out) const {
         }
 
         if (pass == 0) {
+            if (isFlattenedVector()) {
+                emitFlattenedVectorDeclarations(out);
+            }
+            if (isBoundedStorage()) {
+                emitBoundedStorageDeclarations(out);
+            }
+
             out.unindent();
             out << "};\n\n";
         }
@@ -800,6 +957,116 @@ void CompoundType::emitTypeForwardDeclaration(Formatter& out) const {
     out << " " << localName() << ";\n";
 }
 
+void CompoundType::emitGlobalTypeDeclarations(Formatter& out) const {
+    Scope::emitGlobalTypeDeclarations(out);
+
+    if (containsPointer()) {
+        return;
+    }
+
+    out << "namespace android {\n";
+    out << "namespace hardware {\n";
+    out << "namespace details {\n";
+
+    emitReflectionDeclarations(out);
+
+    out << "}  // namespace details\n";
+    out << "}  // namespace hardware\n";
+    out << "}  // namespace android\n\n";
+}
+
+static std::string getReflectionKind(const Type& type) {
+    if (type.isEnum()) return "ENUM";
+    if (type.isScalar() || type.isBitField()) return "SCALAR";
+    if (type.isString()) return "STRING";
+    if (type.isVector()) return "VECTOR";
+    if (type.isArray()) return "ARRAY";
+    if (type.isHandle()) return "HANDLE";
+    if (type.isMemory()) return "MEMORY";
+    if (type.isPointer()) return "POINTER";
+    if (type.isCompoundType()) {
+        switch (static_cast<const CompoundType&>(type).style()) {
+            case CompoundType::STYLE_STRUCT:
+                return "STRUCT";
+            case CompoundType::STYLE_UNION:
+                return "UNION";
+            case CompoundType::STYLE_SAFE_UNION:
+                return "SAFE_UNION";
+        }
+    }
+    return "OTHER";
+}
+
+void CompoundType::emitReflectionDeclarations(Formatter& out) const {
+    const CompoundLayout layout = getCompoundAlignmentAndSize();
+
+    out << "template<> constexpr std::array<hidl_field_descriptor, " << mFields->size()
+        << "> hidl_fields<" << fullName() << "> = ";
+    out.block([&] {
+        size_t offset = layout.innerStruct.offset;
+        for (const auto& field : *mFields) {
+            size_t fieldAlign, fieldSize;
+            field->type().getAlignmentAndSize(&fieldAlign, &fieldSize);
+            offset += Layout::getPad(offset, fieldAlign);
+
+            out << "hidl_field_descriptor{\"" << field->name() << "\", " << offset << ", "
+                << fieldSize << ", hidl_field_kind::" << getReflectionKind(field->type())
+                << ", ";
+            if (field->type().isCompoundType()) {
+                const std::string nested =
+                    "hidl_fields<" + field->type().getCppStackType() + ">";
+                out << nested << ".data(), " << nested << ".size()";
+            } else {
+                out << "nullptr, 0";
+            }
+            out << "},\n";
+
+            if (mStyle == STYLE_STRUCT) {
+                offset += fieldSize;
+            } else {
+                offset = layout.innerStruct.offset;
+            }
+        }
+    }) << ";\n\n";
+
+    const bool hasFields = !mFields->empty();
+    out << "template<> struct hidl_field_visitor<" << fullName() << "> ";
+    out.block([&] {
+        if (mStyle == STYLE_SAFE_UNION) {
+            out << "// Calls visitor(descriptor, field) for the field which is set.\n";
+        } else {
+            out << "// Calls visitor(descriptor, field) for each field in declaration order.\n";
+        }
+        out << "template <typename Object, typename Visitor>\n";
+        out << "static void visit(Object&&" << (hasFields ? " o" : "") << ", Visitor&&"
+            << (hasFields ? " visitor" : "") << ") ";
+        out.block([&] {
+            if (mStyle == STYLE_SAFE_UNION && hasFields) {
+                out << "switch (o.getDiscriminator()) ";
+                out.block([&] {
+                    size_t index = 0;
+                    for (const auto& field : *mFields) {
+                        out << "case " << fullName() << "::hidl_discriminator::" << field->name()
+                            << ": ";
+                        out.block([&] {
+                            out << "visitor(hidl_fields<" << fullName() << ">[" << index++
+                                << "], o." << field->name() << "());\n";
+                            out << "break;\n";
+                        }).endl();
+                    }
+                }).endl();
+                return;
+            }
+
+            size_t index = 0;
+            for (const auto& field : *mFields) {
+                out << "visitor(hidl_fields<" << fullName() << ">[" << index++ << "], o."
+                    << field->name() << ");\n";
+            }
+        }).endl();
+    }) << ";\n\n";
+}
+
 void CompoundType::emitPackageTypeDeclarations(Formatter& out) const {
     Scope::emitPackageTypeDeclarations(out);
 
@@ -1325,6 +1592,153 @@ void CompoundType::emitTypeDefinitions(Formatter& out, const std::string& prefix
     if (mStyle == STYLE_SAFE_UNION) {
         emitSafeUnionTypeDefinitions(out);
     }
+
+    if (isFlattenedVector()) {
+        emitFlattenedVectorDefinitions(out);
+    }
+
+    if (isBoundedStorage()) {
+        emitBoundedStorageDefinitions(out);
+    }
+}
+
+std::string CompoundType::getFlattenedVectorNestedCppType() const {
+    return "::android::hardware::hidl_vec<" + mFields->at(1)->type().getCppStackType() + ">";
+}
+
+void CompoundType::emitFlattenedVectorDeclarations(Formatter& out) const {
+    const std::string elementType =
+        static_cast<const VectorType&>(mFields->at(1)->type()).getElementType()->getCppStackType();
+
+    out << "\n// Row i is elements[offsets[i - 1], offsets[i]), with offsets[-1] == 0.\n"
+        << "struct Row final ";
+
+    out.block([&] {
+        out << "const " << elementType << "* data;\n"
+            << "size_t size;\n\n"
+            << "const " << elementType << "& operator[](size_t index) const { "
+            << "return data[index]; }\n"
+            << "const " << elementType << "* begin() const { return data; }\n"
+            << "const " << elementType << "* end() const { return data + size; }\n";
+    });
+
+    out << ";\n\n"
+        << "size_t rowCount() const;\n"
+        << "Row row(size_t index) const;\n"
+        << getFlattenedVectorNestedCppType() << " toNested() const;\n"
+        << "static " << localName() << " fromNested(const "
+        << getFlattenedVectorNestedCppType() << "& nested);\n";
+}
+
+void CompoundType::emitFlattenedVectorDefinitions(Formatter& out) const {
+    const std::string nestedType = getFlattenedVectorNestedCppType();
+
+    out << "size_t (" << fullName() << "::rowCount)() const ";
+    out.block([&] {
+        out << "return offsets.size();\n";
+    }).endl().endl();
+
+    out << fullName() << "::Row (" << fullName() << "::row)(size_t index) const ";
+    out.block([&] {
+        out << "const uint32_t begin = (index == 0) ? 0 : offsets[index - 1];\n"
+            << "return Row{elements.data() + begin, offsets[index] - begin};\n";
+    }).endl().endl();
+
+    out << nestedType << " (" << fullName() << "::toNested)() const ";
+    out.block([&] {
+        out << nestedType << " nested;\n"
+            << "nested.resize(offsets.size());\n";
+        out.sFor("size_t i = 0; i < offsets.size(); ++i", [&] {
+            out << "const Row current = row(i);\n"
+                << "nested[i].resize(current.size);\n";
+            out.sFor("size_t j = 0; j < current.size; ++j", [&] {
+                out << "nested[i][j] = current[j];\n";
+            }).endl();
+        }).endl();
+        out << "return nested;\n";
+    }).endl().endl();
+
+    out << fullName() << " (" << fullName() << "::fromNested)(const " << nestedType
+        << "& nested) ";
+    out.block([&] {
+        out << "size_t count = 0;\n";
+        out.sFor("size_t i = 0; i < nested.size(); ++i", [&] {
+            out << "count += nested[i].size();\n";
+        }).endl().endl();
+
+        out << localName() << " flat;\n"
+            << "flat.offsets.resize(nested.size());\n"
+            << "flat.elements.resize(count);\n\n"
+            << "size_t end = 0;\n";
+        out.sFor("size_t i = 0; i < nested.size(); ++i", [&] {
+            out.sFor("size_t j = 0; j < nested[i].size(); ++j", [&] {
+                out << "flat.elements[end++] = nested[i][j];\n";
+            }).endl();
+            out << "flat.offsets[i] = end;\n";
+        }).endl();
+        out << "return flat;\n";
+    }).endl().endl();
+}
+
+std::string CompoundType::getBoundedStorageValueCppType() const {
+    if (mFieldStorage == FIELD_STORAGE_BOUNDED_STRING) {
+        return "::android::hardware::hidl_string";
+    }
+    const Type* elementType = static_cast<const ArrayType&>(mFields->at(1)->type()).getElementType();
+    return "::android::hardware::hidl_vec<" + elementType->getCppStackType() + ">";
+}
+
+void CompoundType::emitBoundedStorageDeclarations(Formatter& out) const {
+    const std::string valueType = getBoundedStorageValueCppType();
+
+    out << "\n// Returns false and leaves this unchanged if value exceeds elements.size().\n"
+        << "bool assign(const " << valueType << "& value);\n"
+        << valueType << " get() const;\n";
+}
+
+void CompoundType::emitBoundedStorageDefinitions(Formatter& out) const {
+    const bool isString = mFieldStorage == FIELD_STORAGE_BOUNDED_STRING;
+    const std::string valueType = getBoundedStorageValueCppType();
+
+    out << "bool (" << fullName() << "::assign)(const " << valueType << "& value) ";
+    out.block([&] {
+        out.sIf("value.size() > elements.size()", [&] {
+            out << "return false;\n";
+        }).endl();
+        out.sFor("size_t i = 0; i < value.size(); ++i", [&] {
+            if (isString) {
+                out << "elements[i] = static_cast<uint8_t>(value.c_str()[i]);\n";
+            } else {
+                out << "elements[i] = value[i];\n";
+            }
+        }).endl();
+        out << "size = value.size();\n"
+            << "return true;\n";
+    }).endl().endl();
+
+    out << valueType << " (" << fullName() << "::get)() const ";
+    out.block([&] {
+        if (isString) {
+            out << "return " << valueType
+                << "(reinterpret_cast<const char*>(elements.data()), size);\n";
+            return;
+        }
+        out << valueType << " value;\n"
+            << "value.resize(size);\n";
+        out.sFor("size_t i = 0; i < size; ++i", [&] {
+            out << "value[i] = elements[i];\n";
+        }).endl();
+        out << "return value;\n";
+    }).endl().endl();
+}
+
+static void emitJavaBoundedStorageCheck(Formatter& out) {
+    out.sIf("size < 0 || size > elements.length", [&] {
+        out << "throw new IllegalArgumentException(\n";
+        out.indent(2, [&] {
+            out << "\"size \" + size + \" exceeds capacity \" + elements.length + \".\");\n";
+        });
+    }).endl();
 }
 
 static void emitJavaSafeUnionUnknownDiscriminatorError(Formatter& out, bool fatal) {
@@ -1727,6 +2141,10 @@ void CompoundType::emitJavaTypeDeclarations(Formatter& out, bool atTopLevel) con
             out.unindent();
             out << "}\n";
         }
+
+        if (isBoundedStorage()) {
+            emitJavaBoundedStorageCheck(out);
+        }
         out.unindent();
         out << "}\n\n";
     }
@@ -1814,6 +2232,10 @@ void CompoundType::emitJavaTypeDeclarations(Formatter& out, bool atTopLevel) con
         out << "android.os.HwBlob _hidl_blob, long _hidl_offset) {\n";
         out.unindent();
 
+        if (isBoundedStorage()) {
+            emitJavaBoundedStorageCheck(out);
+        }
+
         if (mStyle == STYLE_SAFE_UNION) {
             getUnionDiscriminatorType()->emitJavaFieldReaderWriter(
                 out, 0 /* depth */, "parcel", "_hidl_blob", "hidl_d",
@@ -1862,10 +2284,368 @@ void CompoundType::emitJavaTypeDeclarations(Formatter& out, bool atTopLevel) con
         out << "}\n";
     }
 
+    if (hasJavaView()) {
+        out << "\n";
+        emitJavaViewDeclarations(out);
+    }
+
     out.unindent();
     out << "};\n\n";
 }
 
+bool CompoundType::isJavaBulkCopyable() const {
+    if (mStyle != STYLE_STRUCT || isBoundedStorage()) {
+        return false;
+    }
+    for (const auto* field : *mFields) {
+        if (field->type().resolveToScalarType() == nullptr) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CompoundType::emitJavaBulkFieldReaderWriter(Formatter& out, const std::string& buffer,
+                                                 const std::string& element,
+                                                 const std::string& offset, bool isReader) const {
+    size_t fieldOffset = 0;
+    for (const auto* field : *mFields) {
+        size_t fieldAlign, fieldSize;
+        field->type().getAlignmentAndSize(&fieldAlign, &fieldSize);
+        fieldOffset += Layout::getPad(fieldOffset, fieldAlign);
+
+        const std::string suffix = field->type().resolveToScalarType()->getJavaSuffix();
+        const std::string at = offset + " + " + std::to_string(fieldOffset);
+        const std::string name = element + "." + field->name();
+        // java.nio.ByteBuffer names its accessors after the Java types.
+        const std::string accessor = suffix == "Int8" || suffix == "Bool" ? ""
+                                     : suffix == "Int16"                  ? "Short"
+                                     : suffix == "Int32"                  ? "Int"
+                                     : suffix == "Int64"                  ? "Long"
+                                                                          : suffix;
+
+        if (isReader) {
+            out << name << " = " << buffer << ".get" << accessor << "(" << at << ")"
+                << (suffix == "Bool" ? " != 0" : "") << ";\n";
+        } else if (suffix == "Bool") {
+            out << buffer << ".put(" << at << ", (byte) (" << name << " ? 1 : 0));\n";
+        } else {
+            out << buffer << ".put" << accessor << "(" << at << ", " << name << ");\n";
+        }
+
+        fieldOffset += fieldSize;
+    }
+}
+
+// How a field or vector element of a @javaView struct is exposed by the view.
+enum class JavaViewKind {
+    // Decoded from the blob whenever it is accessed.
+    DECODE_ON_ACCESS,
+    // Decoded from the blob whenever it is accessed; its buffer is consumed up front.
+    STRING,
+    // Exposed through the view of the nested struct.
+    VIEW,
+    // Needs embedded buffers the view cannot defer, so it is decoded up front.
+    EAGER,
+};
+
+static JavaViewKind getJavaViewKind(const Type& type) {
+    if (!type.needsEmbeddedReadWrite()) {
+        return JavaViewKind::DECODE_ON_ACCESS;
+    }
+    if (type.isString()) {
+        return JavaViewKind::STRING;
+    }
+    if (type.isCompoundType() && static_cast<const CompoundType&>(type).hasJavaView()) {
+        return JavaViewKind::VIEW;
+    }
+    return JavaViewKind::EAGER;
+}
+
+static void emitJavaViewReadString(Formatter& out, const std::string& parcelName,
+                                   const std::string& blobName, const std::string& offset) {
+    out << parcelName << ".readEmbeddedBuffer(\n";
+    out.indent(2, [&] {
+        out << blobName << ".getInt32(" << offset << " + 8 /* offsetof(hidl_string, mSize) */) + 1,\n"
+            << blobName << ".handle(),\n"
+            << offset << " + 0 /* offsetof(hidl_string, mBuffer) */,"
+            << "false /* nullable */);\n";
+    });
+}
+
+void CompoundType::emitJavaViewDeclarations(Formatter& out) const {
+    out << "/**\n"
+        << " * Read-only view of a received " << localName() << ", decoding fields on access.\n"
+        << " * It refers to the memory of the parcel it was read from, which must stay\n"
+        << " * alive until release() is called on this or any view read along with it.\n"
+        << " */\n";
+    out << "public static final class View ";
+    out.block([&] {
+        out << "private final android.os.HwParcel mParcel;\n"
+            << "private final android.os.HwBlob mBlob;\n"
+            << "private final long mOffset;\n";
+
+        for (const auto& field : *mFields) {
+            const Type& type = field->type();
+            const std::string member = "m" + StringHelper::Capitalize(field->name());
+
+            if (type.isVector()) {
+                const Type* elementType = static_cast<const VectorType&>(type).getElementType();
+                JavaViewKind elementKind = getJavaViewKind(*elementType);
+                if (elementKind != JavaViewKind::EAGER) {
+                    out << "private final android.os.HwBlob " << member << "Blob;\n";
+                    if (elementKind == JavaViewKind::VIEW) {
+                        out << "private final " << elementType->getJavaType() << ".View[] "
+                            << member << ";\n";
+                    }
+                    continue;
+                }
+            }
+
+            switch (getJavaViewKind(type)) {
+                case JavaViewKind::VIEW: {
+                    out << "private final " << type.getJavaType() << ".View " << member << ";\n";
+                    break;
+                }
+                case JavaViewKind::EAGER: {
+                    out << "private ";
+                    type.emitJavaFieldInitializer(out, member);
+                    break;
+                }
+                default: {
+                    break;
+                }
+            }
+        }
+        out << "\n";
+
+        out << "public static final View readFromParcel(android.os.HwParcel parcel) ";
+        out.block([&] {
+            out << "android.os.HwBlob blob = parcel.readBuffer("
+                << getCompoundAlignmentAndSize().overall.size << " /* size */);\n"
+                << "return new View(parcel, blob, 0 /* offset */);\n";
+        }).endl().endl();
+
+        // Embedded buffers can only be read in order, so they are all read here.
+        out << "public View(android.os.HwParcel parcel, android.os.HwBlob blob, long offset) ";
+        out.block([&] {
+            out << "mParcel = parcel;\n"
+                << "mBlob = blob;\n"
+                << "mOffset = offset;\n";
+
+            size_t offset = 0;
+            for (const auto& field : *mFields) {
+                const Type& type = field->type();
+                const std::string member = "m" + StringHelper::Capitalize(field->name());
+
+                size_t fieldAlign, fieldSize;
+                type.getAlignmentAndSize(&fieldAlign, &fieldSize);
+                offset += Layout::getPad(offset, fieldAlign);
+                const std::string fieldOffset = "offset + " + std::to_string(offset);
+                offset += fieldSize;
+
+                if (type.isVector()) {
+                    const Type* elementType =
+                        static_cast<const VectorType&>(type).getElementType();
+                    JavaViewKind elementKind = getJavaViewKind(*elementType);
+
+                    if (elementKind != JavaViewKind::EAGER) {
+                        size_t elementAlign, elementSize;
+                        elementType->getAlignmentAndSize(&elementAlign, &elementSize);
+                        const std::string elementOffset =
+                            "_hidl_index_0 * " + std::to_string(elementSize);
+
+                        out.block([&] {
+                            out << "int _hidl_vec_size = blob.getInt32(" << fieldOffset
+                                << " + 8 /* offsetof(hidl_vec<T>, mSize) */);\n"
+                                << member << "Blob = parcel.readEmbeddedBuffer(\n";
+                            out.indent(2, [&] {
+                                out << "_hidl_vec_size * " << elementSize << ","
+                                    << "blob.handle(),\n"
+                                    << fieldOffset
+                                    << " + 0 /* offsetof(hidl_vec<T>, mBuffer) */,"
+                                    << "true /* nullable */);\n";
+                            });
+
+                            if (elementKind == JavaViewKind::VIEW) {
+                                out << member << " = new " << elementType->getJavaType()
+                                    << ".View[_hidl_vec_size];\n";
+                            }
+                            if (elementKind == JavaViewKind::DECODE_ON_ACCESS) {
+                                return;
+                            }
+
+                            out.sFor("int _hidl_index_0 = 0; _hidl_index_0 < _hidl_vec_size; "
+                                     "++_hidl_index_0",
+                                     [&] {
+                                         if (elementKind == JavaViewKind::STRING) {
+                                             emitJavaViewReadString(out, "parcel",
+                                                                    member + "Blob",
+                                                                    elementOffset);
+                                             return;
+                                         }
+                                         out << member << "[_hidl_index_0] = new "
+                                             << elementType->getJavaType() << ".View(parcel, "
+                                             << member << "Blob, " << elementOffset << ");\n";
+                                     })
+                                .endl();
+                        }).endl();
+                        continue;
+                    }
+                }
+
+                switch (getJavaViewKind(type)) {
+                    case JavaViewKind::STRING: {
+                        emitJavaViewReadString(out, "parcel", "blob", fieldOffset);
+                        break;
+                    }
+                    case JavaViewKind::VIEW: {
+                        out << member << " = new " << type.getJavaType() << ".View(parcel, blob, "
+                            << fieldOffset << ");\n";
+                        break;
+                    }
+                    case JavaViewKind::EAGER: {
+                        type.emitJavaFieldReaderWriter(out, 0 /* depth */, "parcel", "blob",
+                                                       member, fieldOffset, true /* isReader */);
+                        break;
+                    }
+                    case JavaViewKind::DECODE_ON_ACCESS: {
+                        break;
+                    }
+                }
+            }
+        }).endl().endl();
+
+        size_t offset = 0;
+        for (const auto& field : *mFields) {
+            const Type& type = field->type();
+            const std::string member = "m" + StringHelper::Capitalize(field->name());
+
+            size_t fieldAlign, fieldSize;
+            type.getAlignmentAndSize(&fieldAlign, &fieldSize);
+            offset += Layout::getPad(offset, fieldAlign);
+            const std::string fieldOffset = "mOffset + " + std::to_string(offset);
+            offset += fieldSize;
+
+            field->emitDocComment(out);
+
+            if (type.isVector()) {
+                const Type* elementType = static_cast<const VectorType&>(type).getElementType();
+                JavaViewKind elementKind = getJavaViewKind(*elementType);
+
+                out << "public final int " << field->name() << "Size() ";
+                out.block([&] {
+                    if (elementKind == JavaViewKind::EAGER) {
+                        out << "return " << member << ".size();\n";
+                    } else {
+                        out << "return mBlob.getInt32(" << fieldOffset
+                            << " + 8 /* offsetof(hidl_vec<T>, mSize) */);\n";
+                    }
+                }).endl().endl();
+
+                size_t elementAlign, elementSize;
+                elementType->getAlignmentAndSize(&elementAlign, &elementSize);
+                const std::string elementOffset = "index * " + std::to_string(elementSize);
+
+                out << "public final " << elementType->getJavaType()
+                    << (elementKind == JavaViewKind::VIEW ? ".View " : " ") << field->name()
+                    << "At(int index) ";
+                out.block([&] {
+                    switch (elementKind) {
+                        case JavaViewKind::DECODE_ON_ACCESS: {
+                            elementType->emitJavaFieldInitializer(out, "_hidl_value");
+                            elementType->emitJavaFieldReaderWriter(
+                                out, 0 /* depth */, "mParcel", member + "Blob", "_hidl_value",
+                                elementOffset, true /* isReader */);
+                            out << "return _hidl_value;\n";
+                            break;
+                        }
+                        case JavaViewKind::STRING: {
+                            out << "return " << member << "Blob.getString(" << elementOffset
+                                << ");\n";
+                            break;
+                        }
+                        case JavaViewKind::VIEW: {
+                            out << "return " << member << "[index];\n";
+                            break;
+                        }
+                        case JavaViewKind::EAGER: {
+                            out << "return " << member << ".get(index);\n";
+                            break;
+                        }
+                    }
+                }).endl().endl();
+                continue;
+            }
+
+            const JavaViewKind kind = getJavaViewKind(type);
+            out << "public final " << type.getJavaType()
+                << (kind == JavaViewKind::VIEW ? ".View " : " ") << field->name() << "() ";
+            out.block([&] {
+                switch (kind) {
+                    case JavaViewKind::DECODE_ON_ACCESS: {
+                        type.emitJavaFieldInitializer(out, "_hidl_value");
+                        type.emitJavaFieldReaderWriter(out, 0 /* depth */, "mParcel", "mBlob",
+                                                       "_hidl_value", fieldOffset,
+                                                       true /* isReader */);
+                        out << "return _hidl_value;\n";
+                        break;
+                    }
+                    case JavaViewKind::STRING: {
+                        out << "return mBlob.getString(" << fieldOffset << ");\n";
+                        break;
+                    }
+                    case JavaViewKind::VIEW:
+                    case JavaViewKind::EAGER: {
+                        out << "return " << member << ";\n";
+                        break;
+                    }
+                }
+            }).endl().endl();
+        }
+
+        out << "/**\n"
+            << " * Decodes all remaining fields into a new " << localName() << ". Fields which\n"
+            << " * the view had to decode up front are shared with it.\n"
+            << " */\n";
+        out << "public final " << fullJavaName() << " materialize() ";
+        out.block([&] {
+            out << fullJavaName() << " _hidl_value = new " << fullJavaName() << "();\n";
+            for (const auto& field : *mFields) {
+                const Type& type = field->type();
+                const std::string target = "_hidl_value." + field->name();
+
+                if (type.isVector()) {
+                    const Type* elementType =
+                        static_cast<const VectorType&>(type).getElementType();
+                    const std::string suffix =
+                        getJavaViewKind(*elementType) == JavaViewKind::VIEW ? ".materialize()"
+                                                                            : "";
+                    out.sFor("int _hidl_index_0 = 0; _hidl_index_0 < " + field->name() +
+                                 "Size(); ++_hidl_index_0",
+                             [&] {
+                                 out << target << ".add(" << field->name()
+                                     << "At(_hidl_index_0)" << suffix << ");\n";
+                             })
+                        .endl();
+                    continue;
+                }
+
+                out << target << " = " << field->name() << "()"
+                    << (getJavaViewKind(type) == JavaViewKind::VIEW ? ".materialize()" : "")
+                    << ";\n";
+            }
+            out << "return _hidl_value;\n";
+        }).endl().endl();
+
+        out << "/** Releases the parcel this view was read from. */\n"
+            << "public final void release() ";
+        out.block([&] {
+            out << "mParcel.release();\n";
+        }).endl();
+    }).endl();
+}
+
 void CompoundType::emitStructReaderWriter(
         Formatter &out, const std::string &prefix, bool isReader) const {
 
@@ -1948,6 +2728,27 @@ void CompoundType::emitStructReaderWriter(
         out << "}\n";
     }
 
+    if (isBoundedStorage()) {
+        out.sIf(name + ".size > " + name + ".elements.size()", [&] {
+            out << "return ::android::BAD_VALUE;\n";
+        }).endl().endl();
+    }
+
+    if (isReader && isFlattenedVector()) {
+        // Rows are located through the received offsets, which must stay within elements.
+        out << "size_t _hidl_end = 0;\n";
+        out.sFor("size_t _hidl_index = 0; _hidl_index < " + name + ".offsets.size(); ++_hidl_index",
+                 [&] {
+                     out.sIf(name + ".offsets[_hidl_index] < _hidl_end", [&] {
+                         out << "return ::android::BAD_VALUE;\n";
+                     }).endl();
+                     out << "_hidl_end = " << name << ".offsets[_hidl_index];\n";
+                 }).endl();
+        out.sIf("_hidl_end != " + name + ".elements.size()", [&] {
+            out << "return ::android::BAD_VALUE;\n";
+        }).endl().endl();
+    }
+
     out << "return _hidl_err;\n";
 
     out.unindent();
@@ -2064,6 +2865,11 @@ bool CompoundType::needsEmbeddedReadWrite() const {
         return false;
     }
 
+    // The size of bounded storage is checked while reading and writing.
+    if (isBoundedStorage()) {
+        return true;
+    }
+
     for (const auto &field : *mFields) {
         if (field->type().needsEmbeddedReadWrite()) {
             return true;
@@ -25,6 +25,8 @@
 
 namespace android {
 
+struct Annotation;
+
 struct CompoundType : public Scope {
     enum Style {
         STYLE_STRUCT,
@@ -38,6 +40,23 @@ struct CompoundType : public Scope {
     Style style() const;
 
     void setFields(std::vector<NamedReference<Type>*>* fields);
+    const std::vector<NamedReference<Type>*>& getFields() const;
+
+    // Replaces every vec<vec<T>> field with a generated nested struct holding
+    // all elements in a single vector plus the end offset of each row, so the
+    // field is transported as two buffers instead of one buffer per row (see
+    // @flatten). Returns the generated structs; the caller adds them to this scope.
+    std::vector<CompoundType*> flattenNestedVectorFields();
+    bool isFlattenedVector() const;
+
+    // Replaces each vec<T> or string field named in @bounded(field = N, ...)
+    // with a generated nested struct storing up to N elements inline, so the
+    // field is transported inside this struct's buffer instead of a buffer of
+    // its own. The generated structs are appended to *bounded; the caller adds
+    // them to this scope.
+    bool boundFields(Annotation* annotation, std::vector<CompoundType*>* bounded,
+                     std::string* errorMsg);
+    bool isBoundedStorage() const;
 
     bool isCompoundType() const override;
 
@@ -51,12 +70,12 @@ struct CompoundType : public Scope {
     status_t validateUniqueNames() const;
     status_t validateSubTypeNames() const;
 
-    std::string getCppType(StorageMode mode,
-                           bool specifyNamespaces) const override;
+    std::string computeCppType(StorageMode mode,
+                               bool specifyNamespaces) const override;
 
-    std::string getJavaType(bool forInitializer) const override;
+    std::string computeJavaType(bool forInitializer) const override;
 
-    std::string getVtsType() const override;
+    std::string computeVtsType() const override;
 
     void emitReaderWriter(
             Formatter &out,
@@ -124,6 +143,7 @@ struct CompoundType : public Scope {
 
     void emitTypeDeclarations(Formatter& out) const override;
     void emitTypeForwardDeclaration(Formatter& out) const override;
+    void emitGlobalTypeDeclarations(Formatter& out) const override;
     void emitPackageTypeDeclarations(Formatter& out) const override;
     void emitPackageTypeHeaderDefinitions(Formatter& out) const override;
     void emitPackageHwDeclarations(Formatter& out) const override;
@@ -145,6 +165,20 @@ struct CompoundType : public Scope {
     void getAlignmentAndSize(size_t *align, size_t *size) const override;
 
     bool containsInterface() const;
+
+    // True for structs of scalars (and enums). Java copies vectors of them
+    // through a single byte[] and decodes or encodes the elements from it at
+    // fixed strides, instead of one HwBlob call per field.
+    bool isJavaBulkCopyable() const;
+    // Reads or writes element (a local of this type) at offset of the
+    // java.nio.ByteBuffer buffer.
+    void emitJavaBulkFieldReaderWriter(Formatter& out, const std::string& buffer,
+                                       const std::string& element, const std::string& offset,
+                                       bool isReader) const;
+
+    // True for structs annotated with @javaView, for which the Java backend
+    // emits a View class decoding fields from the received blob on access.
+    bool hasJavaView() const;
 private:
 
     struct Layout {
@@ -166,8 +200,22 @@ private:
         Layout discriminator;
     };
 
+    // What a struct generated for a field of its parent stores.
+    enum FieldStorage {
+        FIELD_STORAGE_NONE,
+        FIELD_STORAGE_FLATTENED_VECTOR,
+        FIELD_STORAGE_BOUNDED_VECTOR,
+        FIELD_STORAGE_BOUNDED_STRING,
+    };
+
     Style mStyle;
     std::vector<NamedReference<Type>*>* mFields;
+    FieldStorage mFieldStorage;
+
+    // Emits hidl_fields<T> and hidl_field_visitor<T> (declared at the top of
+    // every generated header). Only for types whose C++ layout is the one
+    // hidl-gen computes, i.e. which contain no pointers.
+    void emitReflectionDeclarations(Formatter& out) const;
 
     void emitLayoutAsserts(Formatter& out, const Layout& localLayout,
                            const std::string& localLayoutName) const;
@@ -175,6 +223,13 @@ private:
     void emitInvalidSubTypeNamesError(const std::string& subTypeName,
                                       const Location& location) const;
 
+    void emitFlattenedVectorDeclarations(Formatter& out) const;
+    void emitFlattenedVectorDefinitions(Formatter& out) const;
+    std::string getFlattenedVectorNestedCppType() const;
+    std::string getBoundedStorageValueCppType() const;
+    void emitBoundedStorageDeclarations(Formatter& out) const;
+    void emitBoundedStorageDefinitions(Formatter& out) const;
+
     void emitSafeUnionTypeDefinitions(Formatter& out) const;
     void emitSafeUnionTypeConstructors(Formatter& out) const;
     void emitSafeUnionTypeDeclarations(Formatter& out) const;
@@ -206,6 +261,8 @@ private:
             bool isReader,
             ErrorMode mode) const;
 
+    void emitJavaViewDeclarations(Formatter& out) const;
+
     void emitStructReaderWriter(
             Formatter &out, const std::string &prefix, bool isReader) const;
     void emitResolveReferenceDef(Formatter& out, const std::string& prefix, bool isReader) const;
@@ -18,9 +18,12 @@
 
 #include <dirent.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <fstream>
 #include <iterator>
+#include <sstream>
 
 #include <android-base/logging.h>
 #include <hidl-hash/Hash.h>
@@ -40,6 +43,21 @@ static bool existdir(const char *name) {
     return true;
 }
 
+static bool readFile(const std::string& path, std::string* contents) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream.is_open()) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << stream.rdbuf();
+    *contents = buffer.str();
+    return !stream.bad();
+}
+
+// Outputs are written next to their final location and only moved in place by
+// commitOutputs if they differ from what is already there.
+static const std::string kPendingSuffix = ".hidl-gen-pending";
+
 namespace android {
 
 const std::string &Coordinator::getRootPath() const {
@@ -66,10 +84,54 @@ bool Coordinator::isVerbose() const {
     return mVerbose;
 }
 
+void Coordinator::setTransactionCapture(bool value) {
+    mTransactionCapture = value;
+}
+
+bool Coordinator::isTransactionCaptureEnabled() const {
+    return mTransactionCapture;
+}
+
+void Coordinator::setPerfLintSeverity(const std::string& check, const std::string& severity) {
+    mPerfLintSeverities[check] = severity;
+}
+
+std::string Coordinator::getPerfLintSeverity(const std::string& check,
+                                             const std::string& defaultSeverity) const {
+    auto it = mPerfLintSeverities.find(check);
+    return it == mPerfLintSeverities.end() ? defaultSeverity : it->second;
+}
+
+void Coordinator::setErrorLimit(size_t limit) {
+    mErrorLimit = limit;
+}
+
+size_t Coordinator::errorCount() const {
+    return mErrorCount;
+}
+
+bool Coordinator::errorLimitReached() const {
+    return mErrorLimit != 0 && mErrorCount >= mErrorLimit;
+}
+
+bool Coordinator::recordError() const {
+    mErrorCount++;
+    return !errorLimitReached();
+}
+
+bool Coordinator::continueAfterError(size_t errorsBefore) const {
+    if (mErrorCount == errorsBefore) return recordError();
+    return !errorLimitReached();
+}
+
 void Coordinator::setDepFile(const std::string& depFile) {
     mDepFile = depFile;
 }
 
+void Coordinator::setOutputManifest(const std::string& outputManifest) {
+    mOutputManifest = outputManifest;
+}
+
 const std::string& Coordinator::getOwner() const {
     return mOwner;
 }
@@ -118,13 +180,22 @@ Formatter Coordinator::getFormatter(const FQName& fqName, Location location,
         return Formatter::invalid();
     }
 
-    FILE* file = fopen(filepath.c_str(), "w");
+    std::string writePath = filepath;
+    if (!mOutputManifest.empty()) {
+        writePath += kPendingSuffix;
+    }
+
+    FILE* file = fopen(writePath.c_str(), "w");
 
     if (file == nullptr) {
-        fprintf(stderr, "ERROR: could not open file %s: %d\n", filepath.c_str(), errno);
+        fprintf(stderr, "ERROR: could not open file %s: %d\n", writePath.c_str(), errno);
         return Formatter::invalid();
     }
 
+    if (!mOutputManifest.empty()) {
+        mPendingOutputs.push_back(filepath);
+    }
+
     return Formatter(file);
 }
 
@@ -206,6 +277,98 @@ status_t Coordinator::writeDepFile(const std::string& forFile) const {
     return OK;
 }
 
+status_t Coordinator::commitOutputs(const std::vector<std::string>& outputFiles) const {
+    // Outputs are not tracked
+    if (mOutputManifest.empty()) return OK;
+
+    for (const std::string& path : mPendingOutputs) {
+        const std::string pendingPath = path + kPendingSuffix;
+
+        std::string previous;
+        std::string current;
+        if (readFile(path, &previous) && readFile(pendingPath, &current) && previous == current) {
+            // Keep the old timestamp so that nothing depending on this output is rebuilt.
+            if (unlink(pendingPath.c_str()) != 0) {
+                fprintf(stderr, "ERROR: could not remove %s: %d\n", pendingPath.c_str(), errno);
+                return UNKNOWN_ERROR;
+            }
+            continue;
+        }
+
+        if (rename(pendingPath.c_str(), path.c_str()) != 0) {
+            fprintf(stderr, "ERROR: could not move %s to %s: %d\n", pendingPath.c_str(),
+                    path.c_str(), errno);
+            return UNKNOWN_ERROR;
+        }
+    }
+    mPendingOutputs.clear();
+
+    std::set<std::string> generated;
+    for (const std::string& outputFile : outputFiles) {
+        const std::string relative = StringHelper::LTrim(outputFile, mOutputPath);
+        if (!relative.empty()) generated.insert(relative);
+    }
+
+    std::string previousManifest;
+    if (readFile(mOutputManifest, &previousManifest)) {
+        std::vector<std::string> previousOutputs;
+        StringHelper::SplitString(previousManifest, '\n', &previousOutputs);
+
+        for (const std::string& file : previousOutputs) {
+            if (file.empty() || generated.find(file) != generated.end()) {
+                continue;
+            }
+
+            status_t err = removeStaleOutput(file);
+            if (err != OK) return err;
+        }
+    }
+
+    onFileAccess(mOutputManifest, "w");
+
+    FILE* file = fopen(mOutputManifest.c_str(), "w");
+    if (file == nullptr) {
+        fprintf(stderr, "ERROR: could not open output manifest at %s.\n",
+                mOutputManifest.c_str());
+        return UNKNOWN_ERROR;
+    }
+
+    Formatter out(file);
+    for (const std::string& output : generated) {
+        out << output << "\n";
+    }
+    return OK;
+}
+
+status_t Coordinator::removeStaleOutput(const std::string& file) const {
+    // Only ever remove files inside of the output directory.
+    if (StringHelper::StartsWith(file, "/") || file.find("..") != std::string::npos) {
+        fprintf(stderr, "ERROR: refusing to remove %s listed in %s.\n", file.c_str(),
+                mOutputManifest.c_str());
+        return UNKNOWN_ERROR;
+    }
+
+    const std::string path = mOutputPath + file;
+    if (mVerbose) {
+        fprintf(stderr, "VERBOSE: removing stale output %s\n", path.c_str());
+    }
+
+    if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+        fprintf(stderr, "ERROR: could not remove stale output %s: %d\n", path.c_str(), errno);
+        return UNKNOWN_ERROR;
+    }
+
+    // Stops at the first directory which is not empty (or at the output directory itself).
+    for (size_t slashPos = file.rfind('/'); slashPos != std::string::npos && slashPos != 0;
+         slashPos = file.rfind('/', slashPos - 1)) {
+        if (rmdir((mOutputPath + file.substr(0, slashPos)).c_str()) != 0) {
+            break;
+        }
+    }
+
+    return OK;
+}
+
 AST* Coordinator::parse(const FQName& fqName, std::set<AST*>* parsedASTs,
                         Enforce enforcement) const {
     AST* ret;
@@ -248,7 +411,10 @@ status_t Coordinator::parseOptional(const FQName& fqName, AST** ast, std::set<AS
         FQName typesName = fqName.getTypesForPackage();
         // Do not enforce on imports. Do not add imports' imports to this AST.
         status_t err = parseOptional(typesName, &typesAST, nullptr, Enforce::NONE);
-        if (err != OK) return err;
+        if (err != OK) {
+            *ast = nullptr;
+            return err;
+        }
 
         // fall through.
     }
@@ -279,8 +445,14 @@ status_t Coordinator::parseOptional(const FQName& fqName, AST** ast, std::set<AS
 
     onFileAccess(path, "r");
 
+    const size_t errorsBefore = mErrorCount;
+
     // parse file takes ownership of file
     if (parseFile(*ast, std::move(file)) != OK || (*ast)->postParse() != OK) {
+        // A failure which didn't count its own errors (e.g. an unrecovered
+        // syntax error) still counts once towards the limit.
+        if (mErrorCount == errorsBefore) recordError();
+
         delete *ast;
         *ast = nullptr;
         return UNKNOWN_ERROR;
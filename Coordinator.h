@@ -44,6 +44,39 @@ struct Coordinator {
 
     void setDepFile(const std::string& depFile);
 
+    // Whether C++ proxies and stubs report each transaction to the recorder
+    // installed with setHidlTransactionRecorder (for -Lc++-replay traces).
+    void setTransactionCapture(bool value);
+    bool isTransactionCaptureEnabled() const;
+
+    // Severity (off, note, warning or error) of a -Lperf-lint check, as set
+    // with -W. Checks which were not set have defaultSeverity.
+    void setPerfLintSeverity(const std::string& check, const std::string& severity);
+    std::string getPerfLintSeverity(const std::string& check,
+                                    const std::string& defaultSeverity) const;
+
+    // Errors are counted across all files and packages processed by this
+    // coordinator. Parsing and validation recover from an error and keep
+    // going (to report the independent errors which follow it) until the
+    // limit is reached. A limit of 0 means no limit.
+    void setErrorLimit(size_t limit);
+    size_t errorCount() const;
+    bool errorLimitReached() const;
+
+    // Counts an error, returns whether processing may continue past it.
+    bool recordError() const;
+
+    // To be called after a step which failed. Counts the failure unless the
+    // step already counted its own errors since errorCount() was
+    // errorsBefore, and returns whether processing may continue.
+    bool continueAfterError(size_t errorsBefore) const;
+
+    // When an output manifest is set, hidl-gen owns its output directory:
+    // outputs whose contents did not change are left untouched, and outputs
+    // recorded in the previous manifest which are no longer generated are
+    // removed (see commitOutputs).
+    void setOutputManifest(const std::string& outputManifest);
+
     const std::string& getOwner() const;
     void setOwner(const std::string& owner);
 
@@ -71,6 +104,12 @@ struct Coordinator {
 
     status_t writeDepFile(const std::string& forFile) const;
 
+    // Must be called once all Formatters returned by getFormatter are destroyed.
+    // "outputFiles" is every file generated by this invocation. Replaces changed
+    // outputs, prunes stale ones and rewrites the output manifest. No-op if no
+    // output manifest was set.
+    status_t commitOutputs(const std::vector<std::string>& outputFiles) const;
+
     enum class Enforce {
         FULL,     // default
         NO_HASH,  // only for use with -Lhash
@@ -133,8 +172,14 @@ struct Coordinator {
                                           Enforce enforcement = Enforce::FULL) const;
 
 private:
+    static constexpr size_t kDefaultErrorLimit = 20;
+
     static bool MakeParentHierarchy(const std::string &path);
 
+    // Removes a stale output (relative to mOutputPath) and any parent
+    // directories left empty by doing so.
+    status_t removeStaleOutput(const std::string& file) const;
+
     enum class HashStatus {
         ERROR,
         UNFROZEN,
@@ -168,10 +213,16 @@ private:
     std::string mRootPath;    // root of android source tree (to locate package roots)
     std::string mOutputPath;  // root of output directory
     std::string mDepFile;     // location to write depfile
+    std::string mOutputManifest;  // location of the list of generated files
 
     // hidl-gen options
     bool mVerbose = false;
+    bool mTransactionCapture = false;
+    std::map<std::string, std::string> mPerfLintSeverities;
     std::string mOwner;
+    size_t mErrorLimit = kDefaultErrorLimit;
+
+    mutable size_t mErrorCount = 0;
 
     // cache to parse().
     mutable std::map<FQName, AST *> mCache;
@@ -181,6 +232,9 @@ private:
 
     mutable std::set<std::string> mReadFiles;
 
+    // outputs written to a pending file, to be committed by commitOutputs()
+    mutable std::vector<std::string> mPendingOutputs;
+
     // Returns the given path if it is absolute, otherwise it returns
     // the path relative to mRootPath
     std::string makeAbsolute(const std::string& string) const;
@@ -27,7 +27,7 @@ std::string DeathRecipientType::typeName() const {
     return "death recipient";
 }
 
-std::string DeathRecipientType::getCppType(StorageMode mode,
+std::string DeathRecipientType::computeCppType(StorageMode mode,
                                    bool specifyNamespaces) const {
     const std::string base =
           std::string(specifyNamespaces ? "::android::" : "")
@@ -47,12 +47,12 @@ std::string DeathRecipientType::getCppType(StorageMode mode,
     }
 }
 
-std::string DeathRecipientType::getJavaType(bool /* forInitializer */) const {
+std::string DeathRecipientType::computeJavaType(bool /* forInitializer */) const {
     // TODO(b/33440494) decouple from hwbinder
     return "android.os.IHwBinder.DeathRecipient";
 }
 
-std::string DeathRecipientType::getVtsType() const {
+std::string DeathRecipientType::computeVtsType() const {
     return "TYPE_DEATH_RECIPIENT";
 }
 
@@ -25,13 +25,13 @@ namespace android {
 struct DeathRecipientType : public Type {
     DeathRecipientType(Scope* parent);
 
-    std::string getCppType(
+    std::string computeCppType(
             StorageMode mode,
             bool specifyNamespaces) const override;
 
-    std::string getJavaType(bool forInitializer) const override;
+    std::string computeJavaType(bool forInitializer) const override;
 
-    std::string getVtsType() const override;
+    std::string computeVtsType() const override;
     std::string typeName() const override;
 
     void emitReaderWriter(
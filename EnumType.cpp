@@ -163,12 +163,12 @@ bool EnumType::deepCanCheckEquality(std::unordered_set<const Type*>* /* visited
     return true;
 }
 
-std::string EnumType::getCppType(StorageMode,
-                                 bool /* specifyNamespaces */) const {
+std::string EnumType::computeCppType(StorageMode,
+                                     bool /* specifyNamespaces */) const {
     return fullName();
 }
 
-std::string EnumType::getJavaType(bool forInitializer) const {
+std::string EnumType::computeJavaType(bool forInitializer) const {
     return mStorageType->resolveToScalarType()->getJavaType(forInitializer);
 }
 
@@ -180,7 +180,7 @@ std::string EnumType::getJavaTypeClass() const {
     return mStorageType->resolveToScalarType()->getJavaTypeClass();
 }
 
-std::string EnumType::getVtsType() const {
+std::string EnumType::computeVtsType() const {
     return "TYPE_ENUM";
 }
 
@@ -300,6 +300,18 @@ void EnumType::emitIteratorDeclaration(Formatter& out) const {
             }
         }
     }) << ";\n";
+
+    out << "template<> constexpr std::array<const char*, " << elementCount
+        << "> hidl_enum_names<" << getCppStackType() << "> = ";
+    out.block([&] {
+        auto enumerators = typeChain();
+        std::reverse(enumerators.begin(), enumerators.end());
+        for (const auto* type : enumerators) {
+            for (const auto* enumValue : type->mValues) {
+                out << "\"" << enumValue->name() << "\",\n";
+            }
+        }
+    }) << ";\n";
 }
 
 void EnumType::emitEnumBitwiseOperator(
@@ -816,12 +828,12 @@ const ScalarType *BitFieldType::resolveToScalarType() const {
     return mElementType->resolveToScalarType();
 }
 
-std::string BitFieldType::getCppType(StorageMode mode,
+std::string BitFieldType::computeCppType(StorageMode mode,
                                  bool specifyNamespaces) const {
     return getElementEnumType()->getBitfieldCppType(mode, specifyNamespaces);
 }
 
-std::string BitFieldType::getJavaType(bool forInitializer) const {
+std::string BitFieldType::computeJavaType(bool forInitializer) const {
     return getElementEnumType()->getBitfieldJavaType(forInitializer);
 }
 
@@ -833,7 +845,7 @@ std::string BitFieldType::getJavaTypeClass() const {
     return getElementEnumType()->getBitfieldJavaTypeClass();
 }
 
-std::string BitFieldType::getVtsType() const {
+std::string BitFieldType::computeVtsType() const {
     return "TYPE_MASK";
 }
 
@@ -51,15 +51,15 @@ struct EnumType : public Scope {
     bool isEnum() const override;
     bool deepCanCheckEquality(std::unordered_set<const Type*>* visited) const override;
 
-    std::string getCppType(StorageMode mode,
-                           bool specifyNamespaces) const override;
+    std::string computeCppType(StorageMode mode,
+                               bool specifyNamespaces) const override;
 
-    std::string getJavaType(bool forInitializer) const override;
+    std::string computeJavaType(bool forInitializer) const override;
     std::string getJavaTypeClass() const override;
 
     std::string getJavaSuffix() const override;
 
-    std::string getVtsType() const override;
+    std::string computeVtsType() const override;
 
     std::string getBitfieldCppType(StorageMode mode, bool specifyNamespaces = true) const;
     std::string getBitfieldJavaType(bool forInitializer = false) const;
@@ -181,15 +181,15 @@ struct BitFieldType : public TemplatedType {
 
     const ScalarType *resolveToScalarType() const override;
 
-    std::string getCppType(StorageMode mode,
-                           bool specifyNamespaces) const override;
+    std::string computeCppType(StorageMode mode,
+                               bool specifyNamespaces) const override;
 
-    std::string getJavaType(bool forInitializer) const override;
+    std::string computeJavaType(bool forInitializer) const override;
     std::string getJavaTypeClass() const override;
 
     std::string getJavaSuffix() const override;
 
-    std::string getVtsType() const override;
+    std::string computeVtsType() const override;
 
     const EnumType* getEnumType() const;
 
@@ -30,13 +30,17 @@ std::string FmqType::templatedTypeName() const {
     return mName;
 }
 
+bool FmqType::isFmq() const {
+    return true;
+}
+
 std::string FmqType::fullName() const {
     return mNamespace +
             (mNamespace.empty() ? "" : "::") +
             mName + "<" + mElementType->getCppStackType(true) + ">";
 }
 
-std::string FmqType::getCppType(
+std::string FmqType::computeCppType(
         StorageMode mode,
         bool) const {
 
@@ -163,7 +167,7 @@ bool FmqType::isCompatibleElementType(const Type* elementType) const {
     return (!elementType->isInterface() && !elementType->needsEmbeddedReadWrite());
 }
 
-std::string FmqType::getVtsType() const {
+std::string FmqType::computeVtsType() const {
     if (mName == "MQDescriptorSync") {
         return "TYPE_FMQ_SYNC";
     } else if (mName == "MQDescriptorUnsync") {
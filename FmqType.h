@@ -29,7 +29,9 @@ struct FmqType : public TemplatedType {
 
     std::string templatedTypeName() const override;
 
-    std::string getCppType(
+    bool isFmq() const override;
+
+    std::string computeCppType(
             StorageMode mode,
             bool specifyNamespaces) const override;
 
@@ -62,7 +64,7 @@ struct FmqType : public TemplatedType {
     bool resultNeedsDeref() const override;
     bool isCompatibleElementType(const Type* elementType) const override;
 
-    std::string getVtsType() const override;
+    std::string computeVtsType() const override;
     std::string getVtsValueName() const override;
  private:
     std::string mNamespace;
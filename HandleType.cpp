@@ -33,8 +33,8 @@ std::string HandleType::typeName() const {
     return "handle";
 }
 
-std::string HandleType::getCppType(StorageMode mode,
-                                   bool specifyNamespaces) const {
+std::string HandleType::computeCppType(StorageMode mode,
+                                       bool specifyNamespaces) const {
     const std::string base =
           std::string(specifyNamespaces ? "::android::hardware::" : "")
         + "hidl_handle";
@@ -51,7 +51,7 @@ std::string HandleType::getCppType(StorageMode mode,
     }
 }
 
-std::string HandleType::getJavaType(bool /* forInitializer */) const {
+std::string HandleType::computeJavaType(bool /* forInitializer */) const {
     return "android.os.NativeHandle";
 }
 
@@ -59,7 +59,7 @@ std::string HandleType::getJavaSuffix() const {
     return "NativeHandle";
 }
 
-std::string HandleType::getVtsType() const {
+std::string HandleType::computeVtsType() const {
     return "TYPE_HANDLE";
 }
 
@@ -18,6 +18,7 @@
 
 #include "Annotation.h"
 #include "ArrayType.h"
+#include "CompoundType.h"
 #include "ConstantExpression.h"
 #include "DeathRecipientType.h"
 #include "Method.h"
@@ -27,6 +28,7 @@
 
 #include <unistd.h>
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <sstream>
@@ -65,12 +67,23 @@ enum {
     HIDL_GET_REF_INFO_TRANSACTION             = B_PACK_CHARS(0x0f, 'R', 'E', 'F'),
     HIDL_DEBUG_TRANSACTION                    = B_PACK_CHARS(0x0f, 'D', 'B', 'G'),
     HIDL_HASH_CHAIN_TRANSACTION               = B_PACK_CHARS(0x0f, 'H', 'S', 'H'),
+    HIDL_CALL_GROUP_TRANSACTION               = B_PACK_CHARS(0x0f, 'G', 'R', 'P'),
+    HIDL_SHARED_MEMORY_SETUP_TRANSACTION      = B_PACK_CHARS(0x0f, 'S', 'H', 'M'),
     LAST_HIDL_TRANSACTION   = 0x0fffffff,
 };
 
 const std::unique_ptr<ConstantExpression> Interface::FLAG_ONE_WAY =
     std::make_unique<LiteralConstantExpression>(ScalarType::KIND_UINT32, 0x01, "oneway");
 
+const std::unique_ptr<ConstantExpression> Interface::CALL_GROUP_TRANSACTION =
+    std::make_unique<LiteralConstantExpression>(ScalarType::KIND_UINT32,
+                                                HIDL_CALL_GROUP_TRANSACTION, "callGroup");
+
+const std::unique_ptr<ConstantExpression> Interface::SHARED_MEMORY_SETUP_TRANSACTION =
+    std::make_unique<LiteralConstantExpression>(ScalarType::KIND_UINT32,
+                                                HIDL_SHARED_MEMORY_SETUP_TRANSACTION,
+                                                "sharedMemorySetup");
+
 Interface::Interface(const char* localName, const FQName& fullName, const Location& location,
                      Scope* parent, const Reference<Type>& superType, const Hash* fileHash)
     : Scope(localName, fullName, location, parent), mSuperType(superType), mFileHash(fileHash) {}
@@ -130,7 +143,7 @@ bool Interface::fillLinkToDeathMethod(Method *method) const {
                 },
                 {IMPL_PROXY,
                     [](auto &out) {
-                        out << "::android::hardware::ProcessState::self()->startThreadPool();\n";
+                        out << "start_callback_threadpool();\n";
                         out << "::android::hardware::hidl_binder_death_recipient *binder_recipient"
                             << " = new ::android::hardware::hidl_binder_death_recipient(recipient, cookie, this);\n"
                             << "std::unique_lock<std::mutex> lock(_hidl_mMutex);\n"
@@ -476,7 +489,7 @@ std::vector<const Reference<Type>*> Interface::getReferences() const {
 }
 
 std::vector<const ConstantExpression*> Interface::getConstantExpressions() const {
-    std::vector<const ConstantExpression*> ret;
+    std::vector<const ConstantExpression*> ret = Scope::getConstantExpressions();
     for (const auto* method : methods()) {
         const auto& retMethod = method->getConstantExpressions();
         ret.insert(ret.end(), retMethod.begin(), retMethod.end());
@@ -540,6 +553,30 @@ status_t Interface::validate() const {
     err = validateAnnotations();
     if (err != OK) return err;
 
+    err = validateCallGroup();
+    if (err != OK) return err;
+
+    err = validateCallbackThreads();
+    if (err != OK) return err;
+
+    err = validateRateLimits();
+    if (err != OK) return err;
+
+    err = validateCallbackExecutor();
+    if (err != OK) return err;
+
+    err = validateCoalescing();
+    if (err != OK) return err;
+
+    err = validateDelta();
+    if (err != OK) return err;
+
+    err = validateSharedMemoryCalls();
+    if (err != OK) return err;
+
+    err = validateBroadcast();
+    if (err != OK) return err;
+
     return Scope::validate();
 }
 
@@ -587,16 +624,395 @@ status_t Interface::validateAnnotations() const {
         for (const Annotation* annotation : method->annotations()) {
             const std::string name = annotation->name();
 
-            if (name == "entry" || name == "exit" || name == "callflow") {
+            if (name == "entry" || name == "exit" || name == "callflow" || name == "rateLimit" ||
+                name == "perfLintSuppress" || name == "coalesce" || name == "delta" ||
+                name == "broadcast") {
                 continue;
             }
 
             std::cerr << "ERROR: Unrecognized annotation '" << name
                       << "' for method: " << method->name() << ". An annotation should be one of: "
-                      << "entry, exit, callflow." << std::endl;
+                      << "entry, exit, callflow, rateLimit, perfLintSuppress, coalesce, delta, "
+                      << "broadcast."
+                      << std::endl;
+            return UNKNOWN_ERROR;
+        }
+    }
+    return OK;
+}
+
+status_t Interface::validateCallGroup() const {
+    if (!hasCallGroup()) {
+        return OK;
+    }
+
+    for (const auto* type : getSubTypes()) {
+        if (type->localName() == "CallGroup") {
+            std::cerr << "ERROR: @callGroup interface cannot declare a type named CallGroup at "
+                      << type->location() << std::endl;
+            return UNKNOWN_ERROR;
+        }
+    }
+
+    for (const auto& tuple : allMethodsFromRoot()) {
+        const Method* method = tuple.method();
+        if (method->name() == "execute" || method->name() == "getStatus") {
+            std::cerr << "ERROR: Method '" << method->name()
+                      << "' conflicts with the generated CallGroup of interface " << localName()
+                      << " at " << method->location() << std::endl;
+            return UNKNOWN_ERROR;
+        }
+    }
+
+    return OK;
+}
+
+// Upper bound for @callbackThreads, well above what a single client needs.
+static constexpr size_t kMaxCallbackThreads = 64;
+
+static const Annotation* findCallbackThreadsAnnotation(const Interface* iface) {
+    for (const auto* annotation : iface->annotations()) {
+        if (annotation->name() == "callbackThreads") {
+            return annotation;
+        }
+    }
+    return nullptr;
+}
+
+status_t Interface::validateCallbackThreads() const {
+    const Annotation* annotation = findCallbackThreadsAnnotation(this);
+    if (annotation == nullptr) {
+        return OK;
+    }
+
+    const AnnotationParam* count = annotation->getParam("count");
+    if (annotation->params().size() != 1 || count == nullptr ||
+        count->getConstantExpressions().size() != 1) {
+        std::cerr << "ERROR: @callbackThreads requires a single count=<number> parameter at "
+                  << location() << std::endl;
+        return UNKNOWN_ERROR;
+    }
+
+    const ConstantExpression* value = count->getConstantExpressions()[0];
+    if (value->castSizeT() < 1 || value->castSizeT() > kMaxCallbackThreads) {
+        std::cerr << "ERROR: @callbackThreads count must be between 1 and " << kMaxCallbackThreads
+                  << " at " << location() << std::endl;
+        return UNKNOWN_ERROR;
+    }
+
+    return OK;
+}
+
+size_t Interface::callbackThreads() const {
+    size_t threads = 0;
+    for (const Interface* iface : typeChain()) {
+        const Annotation* annotation = findCallbackThreadsAnnotation(iface);
+        if (annotation != nullptr) {
+            const auto* count = annotation->getParam("count")->getConstantExpressions()[0];
+            threads = std::max(threads, count->castSizeT());
+        }
+    }
+    return threads;
+}
+
+status_t Interface::validateRateLimits() const {
+    for (const Method* method : methods()) {
+        const Annotation* annotation = method->rateLimit();
+        if (annotation == nullptr) {
+            continue;
+        }
+
+        for (const auto* param : annotation->params()) {
+            if ((param->getName() != "callsPerSecond" && param->getName() != "burst") ||
+                param->getConstantExpressions().size() != 1) {
+                std::cerr << "ERROR: @rateLimit takes callsPerSecond=<number> and optionally "
+                          << "burst=<number> at " << method->location() << std::endl;
+                return UNKNOWN_ERROR;
+            }
+            if (param->getConstantExpressions()[0]->castSizeT() < 1) {
+                std::cerr << "ERROR: @rateLimit " << param->getName()
+                          << " must be at least 1 at " << method->location() << std::endl;
+                return UNKNOWN_ERROR;
+            }
+        }
+
+        if (annotation->getParam("callsPerSecond") == nullptr) {
+            std::cerr << "ERROR: @rateLimit requires callsPerSecond=<number> at "
+                      << method->location() << std::endl;
+            return UNKNOWN_ERROR;
+        }
+    }
+
+    return OK;
+}
+
+static const Annotation* findCallbackExecutorAnnotation(const Interface* iface) {
+    for (const auto* annotation : iface->annotations()) {
+        if (annotation->name() == "callbackExecutor") {
+            return annotation;
+        }
+    }
+    return nullptr;
+}
+
+status_t Interface::validateCallbackExecutor() const {
+    const Annotation* annotation = findCallbackExecutorAnnotation(this);
+    if (annotation == nullptr) {
+        return OK;
+    }
+
+    for (const auto* param : annotation->params()) {
+        if (param->getName() == "capacity") {
+            if (param->getConstantExpressions().size() != 1 ||
+                param->getConstantExpressions()[0]->castSizeT() < 1) {
+                std::cerr << "ERROR: @callbackExecutor capacity must be at least 1 at "
+                          << location() << std::endl;
+                return UNKNOWN_ERROR;
+            }
+        } else if (param->getName() == "overflow") {
+            const std::vector<std::string> values = param->getValues();
+            if (values.size() != 1 ||
+                (values[0] != "\"dropOldest\"" && values[0] != "\"coalesce\"" &&
+                 values[0] != "\"block\"")) {
+                std::cerr << "ERROR: @callbackExecutor overflow must be one of \"dropOldest\", "
+                          << "\"coalesce\" or \"block\" at " << location() << std::endl;
+                return UNKNOWN_ERROR;
+            }
+        } else {
+            std::cerr << "ERROR: @callbackExecutor takes capacity=<number> and optionally "
+                      << "overflow=\"<policy>\" at " << location() << std::endl;
+            return UNKNOWN_ERROR;
+        }
+    }
+
+    if (annotation->getParam("capacity") == nullptr) {
+        std::cerr << "ERROR: @callbackExecutor requires capacity=<number> at " << location()
+                  << std::endl;
+        return UNKNOWN_ERROR;
+    }
+
+    return OK;
+}
+
+status_t Interface::validateCoalescing() const {
+    for (const Method* method : methods()) {
+        const Annotation* annotation = method->coalesce();
+        if (annotation == nullptr) {
+            continue;
+        }
+
+        if (!method->isOneway()) {
+            std::cerr << "ERROR: @coalesce can only be used on oneway methods at "
+                      << method->location() << std::endl;
+            return UNKNOWN_ERROR;
+        }
+
+        for (const auto* param : annotation->params()) {
+            if (param->getName() == "delayMs") {
+                if (param->getConstantExpressions().size() != 1) {
+                    std::cerr << "ERROR: @coalesce delayMs must be a number at "
+                              << method->location() << std::endl;
+                    return UNKNOWN_ERROR;
+                }
+                continue;
+            }
+
+            if (param->getName() != "keys") {
+                std::cerr << "ERROR: @coalesce takes keys={\"<argument>\", ...} and "
+                          << "delayMs=<number> at " << method->location() << std::endl;
+                return UNKNOWN_ERROR;
+            }
+
+            for (const std::string& value : param->getValues()) {
+                const auto arg = std::find_if(
+                    method->args().begin(), method->args().end(),
+                    [&](const auto* arg) { return "\"" + arg->name() + "\"" == value; });
+                if (arg == method->args().end()) {
+                    std::cerr << "ERROR: @coalesce key " << value << " is not an argument of "
+                              << method->name() << " at " << method->location() << std::endl;
+                    return UNKNOWN_ERROR;
+                }
+                const Type* type = (*arg)->type().resolve();
+                if (type->resolveToScalarType() == nullptr && !type->isString()) {
+                    std::cerr << "ERROR: @coalesce key " << value
+                              << " must be a scalar, enum or string argument at "
+                              << method->location() << std::endl;
+                    return UNKNOWN_ERROR;
+                }
+            }
+        }
+    }
+
+    return OK;
+}
+
+status_t Interface::validateDelta() const {
+    for (const Method* method : methods()) {
+        const Annotation* annotation = method->delta();
+        if (annotation == nullptr) {
+            continue;
+        }
+
+        if (annotation->params().size() != 1 || annotation->getParam("arg") == nullptr ||
+            annotation->getParam("arg")->getValues().size() != 1) {
+            std::cerr << "ERROR: @delta takes arg=\"<argument>\" at " << method->location()
+                      << std::endl;
+            return UNKNOWN_ERROR;
+        }
+
+        if (method->coalesce() != nullptr) {
+            std::cerr << "ERROR: @delta cannot be combined with @coalesce at "
+                      << method->location() << std::endl;
+            return UNKNOWN_ERROR;
+        }
+
+        // The proxy updates its copy of the argument once the stub has
+        // replied, which oneway calls never do.
+        if (method->isOneway()) {
+            std::cerr << "ERROR: @delta cannot be used on oneway method " << method->name()
+                      << " at " << method->location() << std::endl;
+            return UNKNOWN_ERROR;
+        }
+
+        const NamedReference<Type>* arg = method->deltaArg();
+        if (arg == nullptr) {
+            std::cerr << "ERROR: @delta arg " << annotation->getParam("arg")->getValues()[0]
+                      << " is not an argument of " << method->name() << " at "
+                      << method->location() << std::endl;
+            return UNKNOWN_ERROR;
+        }
+
+        const Type* type = arg->type().resolve();
+        if (!type->isCompoundType() ||
+            static_cast<const CompoundType*>(type)->style() != CompoundType::STYLE_STRUCT) {
+            std::cerr << "ERROR: @delta arg " << arg->name() << " must be a struct at "
+                      << method->location() << std::endl;
+            return UNKNOWN_ERROR;
+        }
+
+        // Changed fields are sent as a bitmap in a uint64_t, and found by
+        // comparing them with the previous value.
+        const auto& fields = static_cast<const CompoundType*>(type)->getFields();
+        if (fields.size() > 64) {
+            std::cerr << "ERROR: @delta arg " << arg->name() << " has more than 64 fields at "
+                      << method->location() << std::endl;
+            return UNKNOWN_ERROR;
+        }
+        for (const auto* field : fields) {
+            if (!field->type().canCheckEquality()) {
+                std::cerr << "ERROR: @delta arg " << arg->name() << " has field " << field->name()
+                          << ", which cannot be compared, at " << method->location()
+                          << std::endl;
+                return UNKNOWN_ERROR;
+            }
+        }
+
+        // The changed fields are sent ahead of the arguments, which Java
+        // proxies and stubs do not know to read or write.
+        if (isJavaCompatible()) {
+            std::cerr << "ERROR: @delta cannot be used in " << localName()
+                      << ", which is Java compatible, at " << method->location() << std::endl;
+            return UNKNOWN_ERROR;
+        }
+    }
+
+    return OK;
+}
+
+// Bounds of the @sharedMemoryCalls region: a page at least, and no more
+// than the binder buffer a transaction could use instead.
+static constexpr size_t kMinSharedMemoryCallsSize = 4096;
+static constexpr size_t kMaxSharedMemoryCallsSize = 1024 * 1024;
+
+static const Annotation* findSharedMemoryCallsAnnotation(const Interface* iface) {
+    for (const auto* annotation : iface->annotations()) {
+        if (annotation->name() == "sharedMemoryCalls") {
+            return annotation;
+        }
+    }
+    return nullptr;
+}
+
+status_t Interface::validateSharedMemoryCalls() const {
+    const Annotation* annotation = findSharedMemoryCallsAnnotation(this);
+    if (annotation == nullptr) {
+        return OK;
+    }
+
+    const AnnotationParam* size = annotation->getParam("size");
+    if (size == nullptr || annotation->params().size() != 1 ||
+        size->getConstantExpressions().size() != 1) {
+        std::cerr << "ERROR: @sharedMemoryCalls takes size=<bytes> at " << location()
+                  << std::endl;
+        return UNKNOWN_ERROR;
+    }
+
+    const size_t bytes = size->getConstantExpressions()[0]->castSizeT();
+    if (bytes < kMinSharedMemoryCallsSize || bytes > kMaxSharedMemoryCallsSize) {
+        std::cerr << "ERROR: @sharedMemoryCalls size must be between "
+                  << kMinSharedMemoryCallsSize << " and " << kMaxSharedMemoryCallsSize
+                  << " at " << location() << std::endl;
+        return UNKNOWN_ERROR;
+    }
+
+    return OK;
+}
+
+// Whether a value of the type carries binder objects or file descriptors.
+static bool containsInterfaceOrHandle(const Type* type, std::unordered_set<const Type*>* visited) {
+    type = type->resolve();
+    if (type->isInterface() || type->isHandle() || type->isMemory() || type->isFmq()) {
+        return true;
+    }
+    if (!visited->insert(type).second) {
+        return false;
+    }
+    for (const auto* ref : type->getReferences()) {
+        if (containsInterfaceOrHandle(ref->get(), visited)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+status_t Interface::validateBroadcast() const {
+    for (const Method* method : methods()) {
+        const Annotation* annotation = method->broadcast();
+        if (annotation == nullptr) {
+            continue;
+        }
+
+        if (!annotation->params().empty()) {
+            std::cerr << "ERROR: @broadcast takes no parameters at " << method->location()
+                      << std::endl;
+            return UNKNOWN_ERROR;
+        }
+
+        if (!method->isOneway()) {
+            std::cerr << "ERROR: @broadcast can only be used on oneway methods at "
+                      << method->location() << std::endl;
+            return UNKNOWN_ERROR;
+        }
+
+        // The request is sent as is, without going through the proxy of
+        // each target.
+        if (method->delta() != nullptr) {
+            std::cerr << "ERROR: @broadcast cannot be combined with @delta at "
+                      << method->location() << std::endl;
             return UNKNOWN_ERROR;
         }
+
+        for (const auto* arg : method->args()) {
+            std::unordered_set<const Type*> visited;
+            if (containsInterfaceOrHandle(arg->get(), &visited)) {
+                std::cerr << "ERROR: @broadcast argument " << arg->name()
+                          << " cannot contain interfaces or handles at " << method->location()
+                          << std::endl;
+                return UNKNOWN_ERROR;
+            }
+        }
     }
+
     return OK;
 }
 
@@ -737,8 +1153,8 @@ FQName Interface::getPassthroughFqName() const {
     return fqName().getInterfacePassthroughFqName();
 }
 
-std::string Interface::getCppType(StorageMode mode,
-                                  bool specifyNamespaces) const {
+std::string Interface::computeCppType(StorageMode mode,
+                                      bool specifyNamespaces) const {
     const std::string base =
           std::string(specifyNamespaces ? "::android::" : "")
         + "sp<"
@@ -755,11 +1171,11 @@ std::string Interface::getCppType(StorageMode mode,
     }
 }
 
-std::string Interface::getJavaType(bool /* forInitializer */) const {
+std::string Interface::computeJavaType(bool /* forInitializer */) const {
     return fullJavaName();
 }
 
-std::string Interface::getVtsType() const {
+std::string Interface::computeVtsType() const {
     if (StringHelper::EndsWith(localName(), "Callback")) {
         return "TYPE_HIDL_CALLBACK";
     } else {
@@ -869,7 +1285,7 @@ void Interface::emitJavaReaderWriter(
         bool isReader) const {
     if (isReader) {
         out << fullJavaName()
-            << ".asInterface("
+            << (isJavaTrustedDeclaredType() ? ".asDeclaredInterface(" : ".asInterface(")
             << parcelObj
             << ".readStrongBinder());\n";
     } else {
@@ -975,6 +1391,108 @@ bool Interface::hasOnewayMethods() const {
     return false;
 }
 
+bool Interface::hasCallGroup() const {
+    for (const Interface* iface : typeChain()) {
+        for (const auto* annotation : iface->annotations()) {
+            if (annotation->name() == "callGroup") {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool Interface::isJavaTrustedDeclaredType() const {
+    for (const auto* annotation : annotations()) {
+        if (annotation->name() == "javaTrustDeclaredType") {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Interface::hasCallbackExecutor() const {
+    return findCallbackExecutorAnnotation(this) != nullptr;
+}
+
+size_t Interface::callbackExecutorCapacity() const {
+    return findCallbackExecutorAnnotation(this)
+        ->getParam("capacity")
+        ->getConstantExpressions()[0]
+        ->castSizeT();
+}
+
+std::string Interface::callbackExecutorOverflow() const {
+    const AnnotationParam* overflow = findCallbackExecutorAnnotation(this)->getParam("overflow");
+    return overflow == nullptr ? "dropOldest" : overflow->getSingleString();
+}
+
+bool Interface::hasCoalescedMethods() const {
+    for (const auto& tuple : allMethodsFromRoot()) {
+        if (tuple.method()->coalesce() != nullptr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Interface::hasDeltaMethods() const {
+    for (const auto& tuple : allMethodsFromRoot()) {
+        if (tuple.method()->delta() != nullptr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Interface::hasSharedMemoryCalls() const {
+    return sharedMemoryCallsSize() > 0;
+}
+
+size_t Interface::sharedMemoryCallsSize() const {
+    size_t size = 0;
+    for (const Interface* iface : typeChain()) {
+        const Annotation* annotation = findSharedMemoryCallsAnnotation(iface);
+        if (annotation != nullptr) {
+            const auto* bytes = annotation->getParam("size")->getConstantExpressions()[0];
+            size = std::max(size, bytes->castSizeT());
+        }
+    }
+    return size;
+}
+
+bool Interface::hasBroadcastMethods() const {
+    return std::any_of(userDefinedMethods().begin(), userDefinedMethods().end(),
+                       [](const Method* method) { return method->broadcast() != nullptr; });
+}
+
+bool Interface::hasAdmissionControl() const {
+    for (const Interface* iface : typeChain()) {
+        for (const auto* annotation : iface->annotations()) {
+            if (annotation->name() == "admissionControl") {
+                return true;
+            }
+        }
+    }
+    for (const auto& tuple : allMethodsFromRoot()) {
+        if (tuple.method()->rateLimit() != nullptr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<InterfaceAndMethod> Interface::callGroupMethods() const {
+    std::vector<InterfaceAndMethod> methods;
+    for (const auto& tuple : allMethodsFromRoot()) {
+        const Method* method = tuple.method();
+        if (!method->isHidlReserved() && !method->isOneway()) {
+            methods.push_back(tuple);
+        }
+    }
+    return methods;
+}
+
 bool Interface::deepIsJavaCompatible(std::unordered_set<const Type*>* visited) const {
     if (superType() != nullptr && !superType()->isJavaCompatible(visited)) {
         return false;
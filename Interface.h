@@ -33,6 +33,8 @@ struct InterfaceAndMethod;
 
 struct Interface : public Scope {
     const static std::unique_ptr<ConstantExpression> FLAG_ONE_WAY;
+    const static std::unique_ptr<ConstantExpression> CALL_GROUP_TRANSACTION;
+    const static std::unique_ptr<ConstantExpression> SHARED_MEMORY_SETUP_TRANSACTION;
 
     Interface(const char* localName, const FQName& fullName, const Location& location,
               Scope* parent, const Reference<Type>& superType, const Hash* fileHash);
@@ -86,12 +88,12 @@ struct Interface : public Scope {
     FQName getStubFqName() const;
     FQName getPassthroughFqName() const;
 
-    std::string getCppType(
+    std::string computeCppType(
             StorageMode mode,
             bool specifyNamespaces) const override;
 
-    std::string getJavaType(bool forInitializer) const override;
-    std::string getVtsType() const override;
+    std::string computeJavaType(bool forInitializer) const override;
+    std::string computeVtsType() const override;
 
     std::vector<const Reference<Type>*> getReferences() const override;
     std::vector<const Reference<Type>*> getStrongReferences() const override;
@@ -102,6 +104,14 @@ struct Interface : public Scope {
     status_t validate() const override;
     status_t validateUniqueNames() const;
     status_t validateAnnotations() const;
+    status_t validateCallGroup() const;
+    status_t validateCallbackThreads() const;
+    status_t validateRateLimits() const;
+    status_t validateCallbackExecutor() const;
+    status_t validateCoalescing() const;
+    status_t validateDelta() const;
+    status_t validateSharedMemoryCalls() const;
+    status_t validateBroadcast() const;
 
     void emitReaderWriter(
             Formatter &out,
@@ -129,6 +139,72 @@ struct Interface : public Scope {
 
     bool hasOnewayMethods() const;
 
+    // Whether this interface or one of its super types is annotated with
+    // @callGroup, in which case a CallGroup batching several two-way calls
+    // into a single transaction is generated for it.
+    bool hasCallGroup() const;
+    // Methods that can be queued on the CallGroup: all two-way user methods,
+    // in transaction code order.
+    std::vector<InterfaceAndMethod> callGroupMethods() const;
+
+    // Number of binder threads that clients of this interface need for
+    // incoming calls, from @callbackThreads(count=N) on this interface or a
+    // super type (the largest wins). 0 if not annotated.
+    size_t callbackThreads() const;
+
+    // Whether this interface is annotated with @javaTrustDeclaredType. Binders
+    // read from a parcel as this type are then wrapped in a Java proxy without
+    // checking their interface chain first.
+    bool isJavaTrustedDeclaredType() const;
+
+    // Whether the stub consults an admission policy before reading the
+    // arguments of a user method: this interface or a super type is annotated
+    // with @admissionControl, or one of its methods with @rateLimit.
+    bool hasAdmissionControl() const;
+
+    // Whether this interface is annotated with
+    // @callbackExecutor(capacity=N, overflow="dropOldest"|"coalesce"|"block").
+    // The stub then queues the oneway methods declared here (up to capacity
+    // calls per object) and runs them on a thread of their own, so binder
+    // threads return right after reading the arguments.
+    bool hasCallbackExecutor() const;
+    size_t callbackExecutorCapacity() const;
+    // What happens to a call arriving when its object has capacity calls
+    // queued: the oldest of them is dropped ("dropOldest"), the newest of
+    // them with the same method is replaced, else the oldest is dropped
+    // ("coalesce"), or the binder thread waits for room ("block").
+    std::string callbackExecutorOverflow() const;
+
+    // Whether this interface or a super type has a oneway method annotated
+    // with @coalesce. Its proxy then holds such calls back for delayMs, and a
+    // later call with the same method and key arguments replaces the one
+    // still waiting. Waiting calls are sent before any other call made
+    // through the same proxy.
+    bool hasCoalescedMethods() const;
+
+    // Whether this interface or a super type has a method annotated with
+    // @delta(arg="<arg>"). Its proxy then keeps the last value of that struct
+    // argument and sends only the fields which changed, which the stub copies
+    // into the value it kept for the same client proxy.
+    bool hasDeltaMethods() const;
+
+    // Whether this interface or a super type is annotated with
+    // @sharedMemoryCalls(size=<bytes>). Proxies then set up a shared memory
+    // region of that size with the stub on first use, and make two-way calls
+    // with only scalar arguments and results through it, which a thread of
+    // the stub waits on. Other calls, and all calls to a stub without the
+    // region, go through binder.
+    bool hasSharedMemoryCalls() const;
+    // Largest size of the @sharedMemoryCalls region of this interface or a
+    // super type.
+    size_t sharedMemoryCallsSize() const;
+
+    // Whether a oneway method declared in this interface is annotated with
+    // @broadcast. The interface then has a static broadcast_<method> which
+    // marshals the arguments once and sends the same request to a list of
+    // targets, dropping the dead ones from the list.
+    bool hasBroadcastMethods() const;
+
     bool deepIsJavaCompatible(std::unordered_set<const Type*>* visited) const override;
 
     bool isNeverStrongReference() const override;
@@ -25,8 +25,8 @@ namespace android {
 
 MemoryType::MemoryType(Scope* parent) : Type(parent) {}
 
-std::string MemoryType::getCppType(StorageMode mode,
-                                   bool specifyNamespaces) const {
+std::string MemoryType::computeCppType(StorageMode mode,
+                                       bool specifyNamespaces) const {
     const std::string base =
           std::string(specifyNamespaces ? "::android::hardware::" : "")
         + "hidl_memory";
@@ -47,7 +47,7 @@ std::string MemoryType::typeName() const {
     return "memory";
 }
 
-std::string MemoryType::getVtsType() const {
+std::string MemoryType::computeVtsType() const {
     return "TYPE_HIDL_MEMORY";
 }
 
@@ -69,6 +69,59 @@ const std::vector<Annotation *> &Method::annotations() const {
     return *mAnnotations;
 }
 
+const Annotation* Method::rateLimit() const {
+    for (const auto* annotation : *mAnnotations) {
+        if (annotation->name() == "rateLimit") {
+            return annotation;
+        }
+    }
+    return nullptr;
+}
+
+const Annotation* Method::coalesce() const {
+    for (const auto* annotation : *mAnnotations) {
+        if (annotation->name() == "coalesce") {
+            return annotation;
+        }
+    }
+    return nullptr;
+}
+
+const Annotation* Method::delta() const {
+    for (const auto* annotation : *mAnnotations) {
+        if (annotation->name() == "delta") {
+            return annotation;
+        }
+    }
+    return nullptr;
+}
+
+const NamedReference<Type>* Method::deltaArg() const {
+    const Annotation* annotation = delta();
+    if (annotation == nullptr) {
+        return nullptr;
+    }
+    const AnnotationParam* param = annotation->getParam("arg");
+    if (param == nullptr || param->getValues().size() != 1) {
+        return nullptr;
+    }
+    for (const auto* arg : *mArgs) {
+        if ("\"" + arg->name() + "\"" == param->getValues()[0]) {
+            return arg;
+        }
+    }
+    return nullptr;
+}
+
+const Annotation* Method::broadcast() const {
+    for (const auto* annotation : *mAnnotations) {
+        if (annotation->name() == "broadcast") {
+            return annotation;
+        }
+    }
+    return nullptr;
+}
+
 std::vector<Reference<Type>*> Method::getReferences() {
     const auto& constRet = static_cast<const Method*>(this)->getReferences();
     std::vector<Reference<Type>*> ret(constRet.size());
@@ -67,6 +67,18 @@ struct Method : DocCommentable {
     bool isHidlReserved() const { return mIsHidlReserved; }
     const std::vector<Annotation *> &annotations() const;
 
+    // @rateLimit(callsPerSecond=<n>, burst=<n>) of the method, or nullptr.
+    const Annotation* rateLimit() const;
+    // @coalesce(keys={"<arg>", ...}, delayMs=<n>) of the method, or nullptr.
+    const Annotation* coalesce() const;
+    // @delta(arg="<arg>") of the method, or nullptr.
+    const Annotation* delta() const;
+    // The struct argument named by @delta, which proxies send as the fields
+    // changed since the previous call. nullptr if there is none.
+    const NamedReference<Type>* deltaArg() const;
+    // @broadcast of the method, or nullptr.
+    const Annotation* broadcast() const;
+
     std::vector<Reference<Type>*> getReferences();
     std::vector<const Reference<Type>*> getReferences() const;
 
@@ -34,12 +34,18 @@ std::string NamedType::localName() const {
     return mLocalName;
 }
 
-std::string NamedType::fullName() const {
-    return mFullName.cppName();
+const std::string& NamedType::fullName() const {
+    if (mFullCppName.empty()) {
+        mFullCppName = mFullName.cppName();
+    }
+    return mFullCppName;
 }
 
-std::string NamedType::fullJavaName() const {
-    return mFullName.javaName();
+const std::string& NamedType::fullJavaName() const {
+    if (mFullJavaName.empty()) {
+        mFullJavaName = mFullName.javaName();
+    }
+    return mFullJavaName;
 }
 
 const Location &NamedType::location() const {
@@ -36,10 +36,10 @@ struct NamedType : public Type {
 
     std::string localName() const;
 
-    /* short for fqName().cppName() */
-    std::string fullName() const;
-    /* short for fqName().fullJavaName() */
-    std::string fullJavaName() const;
+    /* short for fqName().cppName(), computed once */
+    const std::string& fullName() const;
+    /* short for fqName().fullJavaName(), computed once */
+    const std::string& fullJavaName() const;
 
     const Location& location() const;
 
@@ -53,6 +53,9 @@ struct NamedType : public Type {
     const FQName mFullName;
     const Location mLocation;
 
+    mutable std::string mFullCppName;
+    mutable std::string mFullJavaName;
+
     DISALLOW_COPY_AND_ASSIGN(NamedType);
 };
 
@@ -31,8 +31,8 @@ bool PointerType::isElidableType() const {
     return true;
 }
 
-std::string PointerType::getCppType(StorageMode /*mode*/,
-                                    bool /*specifyNamespaces*/) const {
+std::string PointerType::computeCppType(StorageMode /*mode*/,
+                                        bool /*specifyNamespaces*/) const {
     return "void*";
 }
 
@@ -40,7 +40,7 @@ std::string PointerType::typeName() const {
     return "local pointer";
 }
 
-std::string PointerType::getVtsType() const {
+std::string PointerType::computeVtsType() const {
     return "TYPE_POINTER";
 }
 
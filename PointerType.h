@@ -31,11 +31,11 @@ struct PointerType : public Type {
 
     std::string typeName() const override;
 
-    std::string getCppType(
+    std::string computeCppType(
             StorageMode mode,
             bool specifyNamespaces) const override;
 
-    std::string getVtsType() const override;
+    std::string computeVtsType() const override;
 
     void emitReaderWriter(
             Formatter &out,
@@ -34,7 +34,7 @@ std::vector<const Reference<Type>*> RefType::getStrongReferences() const {
     return {};
 }
 
-std::string RefType::getVtsType() const {
+std::string RefType::computeVtsType() const {
     return "TYPE_REF";
 }
 
@@ -75,7 +75,7 @@ bool RefType::isCompatibleElementType(const Type* elementType) const {
  * ref<ref<ref<T>>> t_3ptr;
  * in this case the const's will get stacked on the left (const const const T *** t_3ptr)
  * but in this implementation it would be clearer (T const* const* const* t_3ptr) */
-std::string RefType::getCppType(StorageMode /*mode*/, bool specifyNamespaces) const {
+std::string RefType::computeCppType(StorageMode /*mode*/, bool specifyNamespaces) const {
     return mElementType->getCppStackType(specifyNamespaces)
             + " const*";
 }
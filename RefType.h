@@ -34,10 +34,10 @@ struct RefType : public TemplatedType {
 
     std::vector<const Reference<Type>*> getStrongReferences() const override;
 
-    std::string getCppType(StorageMode mode,
-                           bool specifyNamespaces) const override;
+    std::string computeCppType(StorageMode mode,
+                               bool specifyNamespaces) const override;
 
-    std::string getVtsType() const override;
+    std::string computeVtsType() const override;
     std::string getVtsValueName() const override;
 
     void emitReaderWriter(
@@ -47,7 +47,7 @@ std::string ScalarType::typeName() const {
     return getCppStackType();
 }
 
-std::string ScalarType::getCppType(StorageMode, bool) const {
+std::string ScalarType::computeCppType(StorageMode, bool) const {
     static const char *const kName[] = {
         "bool",
         "int8_t",
@@ -65,7 +65,7 @@ std::string ScalarType::getCppType(StorageMode, bool) const {
     return kName[mKind];
 }
 
-std::string ScalarType::getJavaType(bool /* forInitializer */) const {
+std::string ScalarType::computeJavaType(bool /* forInitializer */) const {
     static const char *const kName[] = {
         "boolean",
         "byte",
@@ -119,7 +119,7 @@ std::string ScalarType::getJavaSuffix() const {
     return kSuffix[mKind];
 }
 
-std::string ScalarType::getVtsType() const {
+std::string ScalarType::computeVtsType() const {
     return "TYPE_SCALAR";
 }
 
@@ -49,16 +49,16 @@ struct ScalarType : public Type {
     std::string typeName() const override;
     bool isValidEnumStorageType() const;
 
-    std::string getCppType(
+    std::string computeCppType(
             StorageMode mode,
             bool specifyNamespaces) const override;
 
-    std::string getJavaType(bool forInitializer) const override;
+    std::string computeJavaType(bool forInitializer) const override;
     std::string getJavaTypeClass() const override;
 
     std::string getJavaSuffix() const override;
 
-    std::string getVtsType() const override;
+    std::string computeVtsType() const override;
     std::string getVtsScalarType() const;
 
     void emitReaderWriter(
@@ -36,8 +36,8 @@ std::string StringType::typeName() const {
     return "string";
 }
 
-std::string StringType::getCppType(StorageMode mode,
-                                   bool specifyNamespaces) const {
+std::string StringType::computeCppType(StorageMode mode,
+                                       bool specifyNamespaces) const {
     const std::string base =
           std::string(specifyNamespaces ? "::android::hardware::" : "")
         + "hidl_string";
@@ -54,7 +54,7 @@ std::string StringType::getCppType(StorageMode mode,
     }
 }
 
-std::string StringType::getJavaType(bool /* forInitializer */) const {
+std::string StringType::computeJavaType(bool /* forInitializer */) const {
     return "String";
 }
 
@@ -62,7 +62,7 @@ std::string StringType::getJavaSuffix() const {
     return "String";
 }
 
-std::string StringType::getVtsType() const {
+std::string StringType::computeVtsType() const {
     return "TYPE_STRING";
 }
 
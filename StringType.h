@@ -31,15 +31,15 @@ struct StringType : public Type {
 
     std::string typeName() const override;
 
-    std::string getCppType(
+    std::string computeCppType(
             StorageMode mode,
             bool specifyNamespaces) const override;
 
-    std::string getJavaType(bool /* forInitializer */) const override;
+    std::string computeJavaType(bool /* forInitializer */) const override;
 
     std::string getJavaSuffix() const override;
 
-    std::string getVtsType() const override;
+    std::string computeVtsType() const override;
 
     void emitReaderWriter(
             Formatter &out,
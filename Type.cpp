@@ -56,6 +56,10 @@ bool Type::isBitField() const {
     return false;
 }
 
+bool Type::isFmq() const {
+    return false;
+}
+
 bool Type::isHandle() const {
     return false;
 }
@@ -369,7 +373,27 @@ const Scope* Type::parent() const {
     return mParent;
 }
 
-std::string Type::getCppType(StorageMode, bool) const {
+template <typename Compute>
+const std::string& Type::memoizeName(NameCache* cache, const Compute& compute) const {
+    if (cache->valid) {
+        return cache->name;
+    }
+
+    cache->name = compute();
+
+    // Before parsing is completed, references and constant expressions that
+    // names depend on may still change.
+    cache->valid = mParseStage == ParseStage::COMPLETED;
+
+    return cache->name;
+}
+
+const std::string& Type::getCppType(StorageMode mode, bool specifyNamespaces) const {
+    return memoizeName(&mCppTypeNames[mode][specifyNamespaces ? 1 : 0],
+                       [&] { return computeCppType(mode, specifyNamespaces); });
+}
+
+std::string Type::computeCppType(StorageMode, bool) const {
     CHECK(!"Should not be here") << typeName();
     return std::string();
 }
@@ -379,7 +403,12 @@ std::string Type::decorateCppName(
     return getCppType(mode, specifyNamespaces) + " " + name;
 }
 
-std::string Type::getJavaType(bool /* forInitializer */) const {
+const std::string& Type::getJavaType(bool forInitializer) const {
+    return memoizeName(&mJavaTypeNames[forInitializer ? 1 : 0],
+                       [&] { return computeJavaType(forInitializer); });
+}
+
+std::string Type::computeJavaType(bool /* forInitializer */) const {
     CHECK(!"Should not be here") << typeName();
     return std::string();
 }
@@ -397,7 +426,11 @@ std::string Type::getJavaSuffix() const {
     return std::string();
 }
 
-std::string Type::getVtsType() const {
+const std::string& Type::getVtsType() const {
+    return memoizeName(&mVtsTypeName, [&] { return computeVtsType(); });
+}
+
+std::string Type::computeVtsType() const {
     CHECK(!"Should not be here") << typeName();
     return std::string();
 }
@@ -659,15 +692,15 @@ bool Type::deepNeedsResolveReferences(std::unordered_set<const Type*>* /* visite
     return false;
 }
 
-std::string Type::getCppStackType(bool specifyNamespaces) const {
+const std::string& Type::getCppStackType(bool specifyNamespaces) const {
     return getCppType(StorageMode_Stack, specifyNamespaces);
 }
 
-std::string Type::getCppResultType(bool specifyNamespaces) const {
+const std::string& Type::getCppResultType(bool specifyNamespaces) const {
     return getCppType(StorageMode_Result, specifyNamespaces);
 }
 
-std::string Type::getCppArgumentType(bool specifyNamespaces) const {
+const std::string& Type::getCppArgumentType(bool specifyNamespaces) const {
     return getCppType(StorageMode_Argument, specifyNamespaces);
 }
 
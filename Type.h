@@ -45,6 +45,7 @@ struct Type : DocCommentable {
     virtual bool isBitField() const;
     virtual bool isCompoundType() const;
     virtual bool isEnum() const;
+    virtual bool isFmq() const;
     virtual bool isHandle() const;
     virtual bool isInterface() const;
     virtual bool isNamedType() const;
@@ -154,20 +155,21 @@ struct Type : DocCommentable {
     };
 
     // specifyNamespaces: whether to specify namespaces for built-in types
-    virtual std::string getCppType(
-            StorageMode mode,
-            bool specifyNamespaces) const;
+    // Type names are rendered once by computeCppType, computeJavaType and
+    // computeVtsType and memoized once parsing is completed.
+    const std::string& getCppType(StorageMode mode, bool specifyNamespaces) const;
+    virtual std::string computeCppType(StorageMode mode, bool specifyNamespaces) const;
 
     std::string decorateCppName(
             const std::string &name,
             StorageMode mode,
             bool specifyNamespaces) const;
 
-    std::string getCppStackType(bool specifyNamespaces = true) const;
+    const std::string& getCppStackType(bool specifyNamespaces = true) const;
 
-    std::string getCppResultType(bool specifyNamespaces = true) const;
+    const std::string& getCppResultType(bool specifyNamespaces = true) const;
 
-    std::string getCppArgumentType(bool specifyNamespaces = true) const;
+    const std::string& getCppArgumentType(bool specifyNamespaces = true) const;
 
     std::string getCppTypeCast(const std::string& objName,
                                bool specifyNamespaces = true) const;
@@ -176,7 +178,8 @@ struct Type : DocCommentable {
     // end of the returned string.
     // if forInitializer == true, actual dimensions are included, i.e. [3][5],
     // otherwise (and by default), they are omitted, i.e. [][].
-    virtual std::string getJavaType(bool forInitializer = false) const;
+    const std::string& getJavaType(bool forInitializer = false) const;
+    virtual std::string computeJavaType(bool forInitializer) const;
 
     // Identical to getJavaType() for most types, except: primitives, in which
     // case the wrapper type is returned, and generics (such as ArrayList<?>),
@@ -187,7 +190,8 @@ struct Type : DocCommentable {
     virtual std::string getJavaTypeCast(const std::string& objName) const;
     virtual std::string getJavaSuffix() const;
 
-    virtual std::string getVtsType() const;
+    const std::string& getVtsType() const;
+    virtual std::string computeVtsType() const;
     virtual std::string getVtsValueName() const;
 
     enum ErrorMode {
@@ -373,9 +377,23 @@ struct Type : DocCommentable {
             const std::string &name) const;
 
    private:
+    struct NameCache {
+        bool valid = false;
+        std::string name;
+    };
+
+    // Defined in and only used by Type.cpp. The callable is a template so that
+    // calls which hit the cache do not build a std::function.
+    template <typename Compute>
+    const std::string& memoizeName(NameCache* cache, const Compute& compute) const;
+
     ParseStage mParseStage = ParseStage::PARSE;
     Scope* const mParent;
 
+    mutable NameCache mCppTypeNames[StorageMode_Result + 1][2 /* specifyNamespaces */];
+    mutable NameCache mJavaTypeNames[2 /* forInitializer */];
+    mutable NameCache mVtsTypeName;
+
     DISALLOW_COPY_AND_ASSIGN(Type);
 };
 
@@ -86,8 +86,8 @@ std::vector<const Reference<Type>*> VectorType::getStrongReferences() const {
     return {};
 }
 
-std::string VectorType::getCppType(StorageMode mode,
-                                   bool specifyNamespaces) const {
+std::string VectorType::computeCppType(StorageMode mode,
+                                       bool specifyNamespaces) const {
     const std::string base =
           std::string(specifyNamespaces ? "::android::hardware::" : "")
         + "hidl_vec<"
@@ -112,7 +112,7 @@ std::string VectorType::getCppType(StorageMode mode,
     }
 }
 
-std::string VectorType::getJavaType(bool /* forInitializer */) const {
+std::string VectorType::computeJavaType(bool /* forInitializer */) const {
     const std::string elementJavaType = mElementType->isTemplatedType()
         ? mElementType->getJavaType()
         : mElementType->getJavaTypeClass();
@@ -124,7 +124,7 @@ std::string VectorType::getJavaTypeClass() const {
     return "java.util.ArrayList";
 }
 
-std::string VectorType::getVtsType() const {
+std::string VectorType::computeVtsType() const {
     return "TYPE_VECTOR";
 }
 
@@ -595,6 +595,16 @@ void VectorType::EmitJavaFieldReaderWriterForElementType(
     size_t elementAlign, elementSize;
     elementType->getAlignmentAndSize(&elementAlign, &elementSize);
 
+    const Type* resolvedElementType = elementType->resolve();
+    const CompoundType* bulkElementType =
+            resolvedElementType->isCompoundType() &&
+                            static_cast<const CompoundType*>(resolvedElementType)
+                                    ->isJavaBulkCopyable()
+                    ? static_cast<const CompoundType*>(resolvedElementType)
+                    : nullptr;
+    const std::string iteratorOffset =
+            "_hidl_index_" + std::to_string(depth) + " * " + std::to_string(elementSize);
+
     if (isReader) {
         out << "{\n";
         out.indent();
@@ -626,6 +636,16 @@ void VectorType::EmitJavaFieldReaderWriterForElementType(
         out << fieldName << ".clear();\n";
         std::string iteratorName = "_hidl_index_" + std::to_string(depth);
 
+        if (bulkElementType != nullptr) {
+            // One copy out of the blob, then fixed-stride decoding.
+            out << "byte[] _hidl_vec_bytes = new byte[_hidl_vec_size * " << elementSize
+                << "];\n";
+            out << "childBlob.copyToInt8Array(0, _hidl_vec_bytes, _hidl_vec_bytes.length);\n";
+            out << "java.nio.ByteBuffer _hidl_vec_buffer = java.nio.ByteBuffer.wrap("
+                << "_hidl_vec_bytes).order(\n";
+            out.indent(2, [&] { out << "java.nio.ByteOrder.nativeOrder());\n"; });
+        }
+
         out << "for (int "
             << iteratorName
             << " = 0; "
@@ -639,14 +659,15 @@ void VectorType::EmitJavaFieldReaderWriterForElementType(
 
         elementType->emitJavaFieldInitializer(out, "_hidl_vec_element");
 
-        elementType->emitJavaFieldReaderWriter(
-                out,
-                depth + 1,
-                parcelName,
-                "childBlob",
-                "_hidl_vec_element",
-                iteratorName + " * " + std::to_string(elementSize),
-                true /* isReader */);
+        if (bulkElementType != nullptr) {
+            bulkElementType->emitJavaBulkFieldReaderWriter(out, "_hidl_vec_buffer",
+                                                           "_hidl_vec_element", iteratorOffset,
+                                                           true /* isReader */);
+        } else {
+            elementType->emitJavaFieldReaderWriter(out, depth + 1, parcelName, "childBlob",
+                                                   "_hidl_vec_element", iteratorOffset,
+                                                   true /* isReader */);
+        }
 
         out << fieldName
             << ".add(_hidl_vec_element);\n";
@@ -685,6 +706,13 @@ void VectorType::EmitJavaFieldReaderWriterForElementType(
 
     std::string iteratorName = "_hidl_index_" + std::to_string(depth);
 
+    if (bulkElementType != nullptr) {
+        // Encode at fixed strides, then one copy into the blob.
+        out << "java.nio.ByteBuffer _hidl_vec_buffer = java.nio.ByteBuffer.allocate("
+            << "_hidl_vec_size * " << elementSize << ").order(\n";
+        out.indent(2, [&] { out << "java.nio.ByteOrder.nativeOrder());\n"; });
+    }
+
     out << "for (int "
         << iteratorName
         << " = 0; "
@@ -696,19 +724,27 @@ void VectorType::EmitJavaFieldReaderWriterForElementType(
 
     out.indent();
 
-    elementType->emitJavaFieldReaderWriter(
-            out,
-            depth + 1,
-            parcelName,
-            "childBlob",
-            fieldName + ".get(" + iteratorName + ")",
-            iteratorName + " * " + std::to_string(elementSize),
-            false /* isReader */);
+    if (bulkElementType != nullptr) {
+        const std::string typeName = bulkElementType->getJavaType(false /* forInitializer */);
+        out << typeName << " _hidl_vec_element = " << fieldName << ".get(" << iteratorName
+            << ");\n";
+        bulkElementType->emitJavaBulkFieldReaderWriter(out, "_hidl_vec_buffer",
+                                                       "_hidl_vec_element", iteratorOffset,
+                                                       false /* isReader */);
+    } else {
+        elementType->emitJavaFieldReaderWriter(out, depth + 1, parcelName, "childBlob",
+                                               fieldName + ".get(" + iteratorName + ")",
+                                               iteratorOffset, false /* isReader */);
+    }
 
     out.unindent();
 
     out << "}\n";
 
+    if (bulkElementType != nullptr) {
+        out << "childBlob.putInt8Array(0, _hidl_vec_buffer.array());\n";
+    }
+
     out << blobName
         << ".putBlob("
         << offset
@@ -38,14 +38,14 @@ struct VectorType : public TemplatedType {
 
     bool deepCanCheckEquality(std::unordered_set<const Type*>* visited) const override;
 
-    std::string getCppType(
+    std::string computeCppType(
             StorageMode mode,
             bool specifyNamespaces) const override;
 
-    std::string getJavaType(bool forInitializer) const override;
+    std::string computeJavaType(bool forInitializer) const override;
     std::string getJavaTypeClass() const override;
 
-    std::string getVtsType() const override;
+    std::string computeVtsType() const override;
     std::string getVtsValueName() const override;
 
     void emitReaderWriter(
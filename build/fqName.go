@@ -97,6 +97,9 @@ func (f *fqName) sourcesName() string {
 func (f *fqName) headersName() string {
 	return f.string() + "_genc++_headers"
 }
+func (f *fqName) packageHeaderName() string {
+	return f.string() + "_genc++_package_header"
+}
 func (f *fqName) javaName() string {
 	return f.sanitizedString() + "-java"
 }
@@ -127,6 +130,12 @@ func (f *fqName) adapterHelperSourcesName() string {
 func (f *fqName) adapterHelperHeadersName() string {
 	return f.string() + "-adapter-helper_genc++_headers"
 }
+func (f *fqName) replayName() string {
+	return f.string() + "-replay"
+}
+func (f *fqName) replaySourcesName() string {
+	return f.string() + "-replay_genc++"
+}
 
 func (f *fqName) vtsSpecName() string {
 	return f.string() + "-vts.spec"
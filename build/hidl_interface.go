@@ -38,23 +38,29 @@ var (
 	vtsc      = pctx.HostBinToolVariable("vtsc", "vtsc")
 	soong_zip = pctx.HostBinToolVariable("soong_zip", "soong_zip")
 
+	// hidl-gen owns ${genDir} through ${manifest}: unchanged outputs keep their
+	// timestamps (hence restat) and outputs which are no longer generated are removed.
 	hidlRule = pctx.StaticRule("hidlRule", blueprint.RuleParams{
 		Depfile:     "${depfile}",
 		Deps:        blueprint.DepsGCC,
-		Command:     "rm -rf ${genDir} && ${hidl} -R -p . -d ${depfile} -o ${genDir} -L ${language} ${roots} ${fqName}",
+		Command:     "${hidl} -R -p . -d ${depfile} -M ${manifest} -o ${genDir} -L ${language} ${flags} ${roots} ${fqName}",
 		CommandDeps: []string{"${hidl}"},
+		Restat:      true,
 		Description: "HIDL ${language}: ${in} => ${out}",
-	}, "depfile", "fqName", "genDir", "language", "roots")
+	}, "depfile", "flags", "fqName", "genDir", "language", "manifest", "roots")
 
 	hidlSrcJarRule = pctx.StaticRule("hidlSrcJarRule", blueprint.RuleParams{
 		Depfile: "${depfile}",
 		Deps:    blueprint.DepsGCC,
-		Command: "rm -rf ${genDir} && " +
-			"${hidl} -R -p . -d ${depfile} -o ${genDir}/srcs -L ${language} ${roots} ${fqName} && " +
-			"${soong_zip} -o ${genDir}/srcs.srcjar -C ${genDir}/srcs -D ${genDir}/srcs",
+		Command: "${hidl} -R -p . -d ${depfile} -M ${manifest} -o ${genDir}/srcs -L ${language} ${flags} ${roots} ${fqName} && " +
+			"${soong_zip} -o ${genDir}/srcs.srcjar.tmp -C ${genDir}/srcs -D ${genDir}/srcs && " +
+			"if cmp -s ${genDir}/srcs.srcjar.tmp ${genDir}/srcs.srcjar; then " +
+			"rm ${genDir}/srcs.srcjar.tmp; " +
+			"else mv ${genDir}/srcs.srcjar.tmp ${genDir}/srcs.srcjar; fi",
 		CommandDeps: []string{"${hidl}", "${soong_zip}"},
+		Restat:      true,
 		Description: "HIDL ${language}: ${in} => srcs.srcjar",
-	}, "depfile", "fqName", "genDir", "language", "roots")
+	}, "depfile", "flags", "fqName", "genDir", "language", "manifest", "roots")
 
 	vtsRule = pctx.StaticRule("vtsRule", blueprint.RuleParams{
 		Command:     "rm -rf ${genDir} && ${vtsc} -m${mode} -t${type} ${inputDir}/${packagePath} ${genDir}/${packagePath}",
@@ -75,6 +81,7 @@ type hidlGenProperties struct {
 	Interfaces []string
 	Inputs     []string
 	Outputs    []string
+	Flags      []string
 }
 
 type hidlGenRule struct {
@@ -144,9 +151,11 @@ func (g *hidlGenRule) GenerateAndroidBuildActions(ctx android.ModuleContext) {
 		ImplicitOutputs: g.genOutputs[1:],
 		Args: map[string]string{
 			"depfile":  g.genOutputs[0].String() + ".d",
+			"flags":    strings.Join(g.properties.Flags, " "),
 			"genDir":   g.genOutputDir.String(),
 			"fqName":   g.properties.FqName,
 			"language": g.properties.Language,
+			"manifest": android.PathForModuleGen(ctx, "hidl-gen.outputs").String(),
 			"roots":    strings.Join(fullRootOptions, " "),
 		},
 	})
@@ -285,6 +294,12 @@ type hidlInterfaceProperties struct {
 	// Whether to generate VTS-related testing libraries.
 	Gen_vts *bool
 
+	// Whether C++ proxies and stubs report each transaction to the recorder
+	// of libhidl-gen-support (hidl-gen -T). Also generates the
+	// <name>-replay library, which replays recorded traces.
+	// Default: false
+	Transaction_capture *bool
+
 	// example: -randroid.hardware:hardware/interfaces
 	Full_root_option string `blueprint:"mutated"`
 }
@@ -430,6 +445,14 @@ This corresponds to the "-r%s:<some path>" option that would be passed into hidl
 	shouldGenerateJava := proptools.BoolDefault(i.properties.Gen_java, true)
 	shouldGenerateJavaConstants := i.properties.Gen_java_constants
 	shouldGenerateVts := shouldGenerateLibrary && proptools.BoolDefault(i.properties.Gen_vts, true)
+	shouldCaptureTransactions := shouldGenerateLibrary && proptools.Bool(i.properties.Transaction_capture)
+
+	var captureFlags []string
+	var captureLibs []string
+	if shouldCaptureTransactions {
+		captureFlags = []string{"-T"}
+		captureLibs = []string{"libhidl-gen-support"}
+	}
 
 	var libraryIfExists []string
 	if shouldGenerateLibrary {
@@ -451,6 +474,7 @@ This corresponds to the "-r%s:<some path>" option that would be passed into hidl
 		Interfaces: i.properties.Interfaces,
 		Inputs:     i.properties.Srcs,
 		Outputs:    concat(wrap(name.dir(), interfaces, "All.cpp"), wrap(name.dir(), types, ".cpp")),
+		Flags:      captureFlags,
 	}, &i.inheritCommonProperties)
 	mctx.CreateModule(android.ModuleFactoryAdaptor(hidlGenFactory), &nameProperties{
 		Name: proptools.StringPtr(name.headersName()),
@@ -468,6 +492,18 @@ This corresponds to the "-r%s:<some path>" option that would be passed into hidl
 			wrap(name.dir(), types, ".h"),
 			wrap(name.dir()+"hw", types, ".h")),
 	}, &i.inheritCommonProperties)
+	// PackageAll.h includes all of the headers above, to be precompiled by
+	// modules which use many HAL packages.
+	mctx.CreateModule(android.ModuleFactoryAdaptor(hidlGenFactory), &nameProperties{
+		Name: proptools.StringPtr(name.packageHeaderName()),
+	}, &hidlGenProperties{
+		Language:   "c++-package-header",
+		FqName:     name.string(),
+		Root:       i.properties.Root,
+		Interfaces: i.properties.Interfaces,
+		Inputs:     i.properties.Srcs,
+		Outputs:    []string{name.dir() + "PackageAll.h"},
+	}, &i.inheritCommonProperties)
 
 	if shouldGenerateLibrary {
 		mctx.CreateModule(android.ModuleFactoryAdaptor(cc.LibraryFactory), &ccProperties{
@@ -477,7 +513,7 @@ This corresponds to the "-r%s:<some path>" option that would be passed into hidl
 			Double_loadable:    proptools.BoolPtr(isDoubleLoadable(name.string())),
 			Defaults:           []string{"hidl-module-defaults"},
 			Generated_sources:  []string{name.sourcesName()},
-			Generated_headers:  []string{name.headersName()},
+			Generated_headers:  []string{name.headersName(), name.packageHeaderName()},
 			Shared_libs: concat(cppDependencies, []string{
 				"libhidlbase",
 				"libhidltransport",
@@ -485,17 +521,53 @@ This corresponds to the "-r%s:<some path>" option that would be passed into hidl
 				"liblog",
 				"libutils",
 				"libcutils",
-			}),
+			}, captureLibs),
 			Export_shared_lib_headers: concat(cppDependencies, []string{
 				"libhidlbase",
 				"libhidltransport",
 				"libhwbinder",
 				"libutils",
-			}),
-			Export_generated_headers: []string{name.headersName()},
+			}, captureLibs),
+			Export_generated_headers:  []string{name.headersName(), name.packageHeaderName()},
+			Header_libs:               []string{"libhidl-gen-support-headers"},
+			Export_header_lib_headers: []string{"libhidl-gen-support-headers"},
 		}, &i.properties.VndkProperties, &i.inheritCommonProperties)
 	}
 
+	if shouldCaptureTransactions {
+		mctx.CreateModule(android.ModuleFactoryAdaptor(hidlGenFactory), &nameProperties{
+			Name: proptools.StringPtr(name.replaySourcesName()),
+		}, &hidlGenProperties{
+			Language:   "c++-replay",
+			FqName:     name.string(),
+			Root:       i.properties.Root,
+			Interfaces: i.properties.Interfaces,
+			Inputs:     i.properties.Srcs,
+			Outputs: concat(wrap(name.dir()+"Replay", interfaces, ".h"),
+				wrap(name.dir()+"Replay", interfaces, ".cpp")),
+		}, &i.inheritCommonProperties)
+		mctx.CreateModule(android.ModuleFactoryAdaptor(cc.LibraryFactory), &ccProperties{
+			Name:              proptools.StringPtr(name.replayName()),
+			Vendor_available:  proptools.BoolPtr(true),
+			Defaults:          []string{"hidl-module-defaults"},
+			Generated_sources: []string{name.replaySourcesName()},
+			Generated_headers: []string{name.replaySourcesName()},
+			Shared_libs: []string{
+				name.string(),
+				"libhidl-gen-support",
+				"libhidlbase",
+				"libhidltransport",
+				"libhwbinder",
+				"libutils",
+			},
+			Export_shared_lib_headers: []string{
+				name.string(),
+				"libhidl-gen-support",
+			},
+			Export_generated_headers: []string{name.replaySourcesName()},
+		}, &i.inheritCommonProperties)
+	}
+
 	if shouldGenerateJava {
 		mctx.CreateModule(android.ModuleFactoryAdaptor(hidlGenFactory), &nameProperties{
 			Name: proptools.StringPtr(name.javaSourcesName()),
@@ -38,6 +38,8 @@ type ccProperties struct {
 	Export_shared_lib_headers []string
 	Export_static_lib_headers []string
 	Export_generated_headers  []string
+	Header_libs               []string
+	Export_header_lib_headers []string
 	Double_loadable           *bool
 	Cflags                    []string
 }
@@ -112,6 +112,20 @@ enum class TokenGrammar(val value: String, val category: TokenCategory) {
     EXIT("exit", TokenCategory.Annotation),
     CALLFLOW("callflow", TokenCategory.Annotation),
     EXPORT("export", TokenCategory.Annotation),
+    FLATTEN("flatten", TokenCategory.Annotation),
+    JAVA_VIEW("javaView", TokenCategory.Annotation),
+    BOUNDED("bounded", TokenCategory.Annotation),
+    CALL_GROUP("callGroup", TokenCategory.Annotation),
+    JAVA_TRUST_DECLARED_TYPE("javaTrustDeclaredType", TokenCategory.Annotation),
+    CALLBACK_THREADS("callbackThreads", TokenCategory.Annotation),
+    ADMISSION_CONTROL("admissionControl", TokenCategory.Annotation),
+    RATE_LIMIT("rateLimit", TokenCategory.Annotation),
+    CALLBACK_EXECUTOR("callbackExecutor", TokenCategory.Annotation),
+    COALESCE("coalesce", TokenCategory.Annotation),
+    DELTA("delta", TokenCategory.Annotation),
+    SHARED_MEMORY_CALLS("sharedMemoryCalls", TokenCategory.Annotation),
+    BROADCAST("broadcast", TokenCategory.Annotation),
+    PERF_LINT_SUPPRESS("perfLintSuppress", TokenCategory.Annotation),
 
     // javadoc tags. Not all supported in HIDL
     // http://docs.oracle.com/javase/1.5.0/docs/tooldocs/windows/javadoc.html#javadoctags
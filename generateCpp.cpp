@@ -16,6 +16,9 @@
 
 #include "AST.h"
 
+#include "Annotation.h"
+#include "CompoundType.h"
+#include "ConstantExpression.h"
 #include "Coordinator.h"
 #include "EnumType.h"
 #include "HidlTypeAssertion.h"
@@ -29,11 +32,59 @@
 #include <hidl-util/Formatter.h>
 #include <hidl-util/StringHelper.h>
 #include <android-base/logging.h>
+#include <sstream>
 #include <string>
 #include <vector>
 
 namespace android {
 
+// Whether the proxy offers <method>_retained, which hands out the reply
+// parcel instead of copying results out of it: two-way user methods with a
+// result that is read as a view into the reply (vectors, strings, structs).
+static bool canRetainReply(const Method* method) {
+    if (method->isHidlReserved() || method->isOneway() || method->delta() != nullptr) {
+        return false;
+    }
+    return std::any_of(method->results().begin(), method->results().end(),
+                       [](const auto* result) { return result->type().resultNeedsDeref(); });
+}
+
+// Whether a proxy with @sharedMemoryCalls makes a call through the shared
+// memory region: two-way user methods whose arguments and results are all
+// scalars, so that their parcels never carry binder objects.
+static bool canCallOverSharedMemory(const Method* method) {
+    if (method->isHidlReserved() || method->isOneway()) {
+        return false;
+    }
+    const auto isScalar = [](const auto* arg) {
+        return arg->type().resolve()->resolveToScalarType() != nullptr;
+    };
+    return std::all_of(method->args().begin(), method->args().end(), isScalar) &&
+           std::all_of(method->results().begin(), method->results().end(), isScalar);
+}
+
+// Fields of the @delta argument of a method. Field i is sent when bit i of
+// the bitmap of changed fields is set.
+static const std::vector<NamedReference<Type>*>& deltaFields(const Method* method) {
+    return static_cast<const CompoundType*>(method->deltaArg()->type().resolve())->getFields();
+}
+
+// Bitmap with a bit set for every field of the @delta argument, which is
+// what a proxy sends when the stub has no value of its own to update yet.
+static std::string deltaAllFields(const Method* method) {
+    const size_t count = deltaFields(method).size();
+    std::ostringstream mask;
+    mask << "0x" << std::hex << (count == 64 ? ~0ull : (1ull << count) - 1) << "ull";
+    return mask.str();
+}
+
+// Arguments of <method>_retained which precede the reply handle.
+static void emitRetainedArgSignature(Formatter& out, const Method* method) {
+    for (const auto* arg : method->args()) {
+        out << arg->type().getCppArgumentType() << " " << arg->name() << ", ";
+    }
+}
+
 void AST::getPackageComponents(
         std::vector<std::string> *components) const {
     mPackage.getPackageComponents(components);
@@ -245,6 +296,10 @@ void AST::generateInterfaceHeader(Formatter& out) const {
         }
     }
 
+    const Scope& typeScope = iface ? static_cast<const Scope&>(*iface) : mRootScope;
+    if (!typeScope.getSubTypes().empty()) {
+        out << "#include <hidl-gen-support/Reflection.h>\n";
+    }
     out << "#include <hidl/HidlSupport.h>\n";
     out << "#include <hidl/MQDescriptor.h>\n";
 
@@ -364,12 +419,52 @@ void AST::generateInterfaceHeader(Formatter& out) const {
             out << "\n// helper methods for interactions with the hwservicemanager\n";
             declareServiceManagerInteractions(out, iface->localName());
         }
+
+        if (iface->callbackThreads() > 0) {
+            out << "\n";
+            DocComment("Raises the binder threadpool maximum of this process to the " +
+                       std::to_string(iface->callbackThreads()) +
+                       " threads which @callbackThreads asks for, unless it is already that "
+                       "large. Generated code never changes the threadpool configuration, so "
+                       "the process owner calls this, before passing callbacks to services of "
+                       "this interface. Returns the status of setThreadPoolConfiguration.")
+                    .emit(out);
+            out << "static ::android::status_t configureCallbackThreadpool();\n";
+        }
+
+        if (iface->hasBroadcastMethods()) {
+            out << "\n// broadcast static functions\n";
+            for (const Method* method : iface->userDefinedMethods()) {
+                if (method->broadcast() == nullptr) {
+                    continue;
+                }
+                DocComment("Calls " + method->name() +
+                           " on every target, marshalling the arguments once for all remote "
+                           "ones. Returns the status of each call in the order of targets, "
+                           "then removes the targets which are dead from the list.")
+                        .emit(out);
+                out << "static ";
+                generateBroadcastSignature(out, method, "");
+                out << ";\n";
+            }
+        }
+
+        if (iface->hasCallGroup()) {
+            out << "\n";
+            DocComment("Queues several two-way calls and sends them in a single transaction.")
+                    .emit(out);
+            out << "struct CallGroup;\n";
+        }
     }
 
     if (iface) {
         out.unindent();
 
         out << "};\n\n";
+
+        if (iface->hasCallGroup()) {
+            generateCallGroupDeclaration(out, iface);
+        }
     }
 
     out << "//\n";
@@ -699,6 +794,21 @@ void AST::generateStubHeader(Formatter& out) const {
 
     out << "::android::sp<" << iface->localName() << "> getImpl() { return _hidl_mImpl; }\n";
 
+    if (iface->hasAdmissionControl()) {
+        out << "\n";
+        DocComment(
+            "Decides whether a call from pid/uid to the method with serial ID code is let in. "
+            "Rejected calls fail with WOULD_BLOCK before their arguments are read.")
+            .emit(out);
+        out << "using AdmissionPolicy = bool (*)(uint32_t code, pid_t pid, uid_t uid);\n";
+        out << "// Replaces defaultAdmissionPolicy for every " << klassName
+            << " of this process, or restores it with nullptr.\n";
+        out << "static void setAdmissionPolicy(AdmissionPolicy policy);\n";
+        out << "// Limits each calling process to the @rateLimit of a method, admits all other "
+               "calls.\n";
+        out << "static bool defaultAdmissionPolicy(uint32_t code, pid_t pid, uid_t uid);\n";
+    }
+
     generateMethods(out,
                     [&](const Method* method, const Interface*) {
                         if (method->isHidlReserved() && method->overridesCppImpl(IMPL_PROXY)) {
@@ -763,6 +873,15 @@ void AST::generateProxyHeader(Formatter& out) const {
 
     out << "#include <hidl/HidlTransportSupport.h>\n\n";
 
+    const std::vector<Method*>& userMethods = iface->userDefinedMethods();
+    if (std::any_of(userMethods.begin(), userMethods.end(), canRetainReply) ||
+        iface->hasDeltaMethods()) {
+        out << "#include <memory>\n\n";
+    }
+    if (iface->hasCoalescedMethods()) {
+        out << "#include <atomic>\n\n";
+    }
+
     std::vector<std::string> packageComponents;
     getPackageAndVersionComponents(
             &packageComponents, false /* cpp_compatible */);
@@ -806,6 +925,10 @@ void AST::generateProxyHeader(Formatter& out) const {
                 << "::android::hardware::IInterface* _hidl_this, "
                 << "::android::hardware::details::HidlInstrumentor *_hidl_this_instrumentor";
 
+            if (method->delta() != nullptr) {
+                out << ", uint64_t _hidl_delta_stream, uint64_t _hidl_delta_present";
+            }
+
             if (!method->hasEmptyCppArgSignature()) {
                 out << ", ";
             }
@@ -814,6 +937,13 @@ void AST::generateProxyHeader(Formatter& out) const {
         },
         false /* include parents */);
 
+    for (const Method* method : iface->userDefinedMethods()) {
+        if (canRetainReply(method)) {
+            generateRetainedReplyDeclaration(out, method);
+            out << "\n";
+        }
+    }
+
     generateMethods(out, [&](const Method* method, const Interface*) {
         method->generateCppSignature(out);
         out << " override;\n";
@@ -825,6 +955,25 @@ void AST::generateProxyHeader(Formatter& out) const {
     out << "std::mutex _hidl_mMutex;\n"
         << "std::vector<::android::sp<::android::hardware::hidl_binder_death_recipient>>"
         << " _hidl_mDeathRecipients;\n";
+    if (iface->hasCoalescedMethods()) {
+        out << "// Held while sending calls held back by @coalesce, so that they and the\n"
+            << "// other calls of this proxy are sent in order.\n";
+        out << "std::mutex _hidl_mCoalesceSendLock;\n";
+        out << "// Number of calls of this proxy waiting to be coalesced.\n";
+        out << "std::atomic<size_t> _hidl_mCoalescedCalls{0};\n";
+    }
+    for (const auto& tuple : iface->allMethodsFromRoot()) {
+        const Method* method = tuple.method();
+        if (method->delta() == nullptr) {
+            continue;
+        }
+        out << "// Last " << method->deltaArg()->name() << " sent by " << method->name()
+            << "(), which the next call only sends the changes to.\n";
+        out << "std::mutex _hidl_mDeltaLock_" << method->name() << ";\n";
+        out << "bool _hidl_mDeltaBusy_" << method->name() << " = false;\n";
+        out << "std::unique_ptr<" << method->deltaArg()->type().getCppStackType()
+            << "> _hidl_mDeltaBase_" << method->name() << ";\n";
+    }
     out.unindent();
     out << "};\n\n";
 
@@ -833,6 +982,55 @@ void AST::generateProxyHeader(Formatter& out) const {
     out << "\n#endif  // " << guard << "\n";
 }
 
+void AST::generateRetainedReplyDeclaration(Formatter& out, const Method* method) const {
+    const std::string replyName = method->name() + "_reply";
+    const Interface* iface = mRootScope.getInterface();
+
+    DocComment("Results of " + method->name() +
+               "() left in the reply parcel, which this object owns. Results which are "
+               "not scalars are returned as views into the parcel, valid for as long as "
+               "this object is alive, so they are never copied. Move-only.")
+            .emit(out);
+    out << "class " << replyName << " {\n";
+    out << "  public:\n";
+    out.indent([&] {
+        out << replyName << "() = default;\n";
+        out << replyName << "(" << replyName << "&&) = default;\n";
+        out << replyName << "& operator=(" << replyName << "&&) = default;\n\n";
+
+        for (const auto* result : method->results()) {
+            const Type& type = result->type();
+            if (type.resultNeedsDeref()) {
+                out << "const " << type.getCppStackType() << "& " << result->name()
+                    << "() const { return *_hidl_out_" << result->name() << "; }\n";
+            } else {
+                out << type.getCppResultType() << " " << result->name()
+                    << "() const { return _hidl_out_" << result->name() << "; }\n";
+            }
+        }
+    });
+    out << "\n";
+    out << "  private:\n";
+    out.indent([&] {
+        out << "friend struct " << iface->getProxyName() << ";\n\n";
+        out << "std::unique_ptr<::android::hardware::Parcel> _hidl_reply;\n";
+        for (const auto* result : method->results()) {
+            out << result->type().getCppResultType() << " _hidl_out_" << result->name()
+                << "{};\n";
+        }
+    });
+    out << "};\n\n";
+
+    DocComment("Calls " + method->name() + "() on a remote interface and moves the reply "
+               "into *_hidl_retained instead of passing the results to a callback. Fails "
+               "with EX_UNSUPPORTED_OPERATION for interfaces which are not remote.")
+            .emit(out);
+    out << "static ::android::hardware::Return<void> " << method->name() << "_retained("
+        << "const ::android::sp<" << iface->localName() << ">& _hidl_this, ";
+    emitRetainedArgSignature(out, method);
+    out << replyName << "* _hidl_retained);\n";
+}
+
 void AST::generateCppSource(Formatter& out) const {
     std::string baseName = getBaseName();
     const Interface *iface = getInterface();
@@ -864,6 +1062,74 @@ void AST::generateCppSource(Formatter& out) const {
         }
 
         out << "#include <hidl/ServiceManagement.h>\n";
+
+        if (iface->hasAdmissionControl()) {
+            out << "#include <hwbinder/IPCThreadState.h>\n";
+            out << "#include <utils/Timers.h>\n";
+            out << "#include <algorithm>\n";
+            out << "#include <atomic>\n";
+            out << "#include <map>\n";
+            out << "#include <mutex>\n";
+        }
+
+        if (iface->hasCoalescedMethods()) {
+            out << "#include <utils/Timers.h>\n";
+            out << "#include <atomic>\n";
+            out << "#include <condition_variable>\n";
+            out << "#include <deque>\n";
+            out << "#include <functional>\n";
+            out << "#include <limits>\n";
+            out << "#include <mutex>\n";
+            out << "#include <string>\n";
+            out << "#include <thread>\n";
+            out << "#include <vector>\n";
+        }
+
+        if (iface->hasDeltaMethods()) {
+            out << "#include <hwbinder/IPCThreadState.h>\n";
+            out << "#include <algorithm>\n";
+            out << "#include <map>\n";
+            out << "#include <memory>\n";
+            out << "#include <mutex>\n";
+            out << "#include <tuple>\n";
+        }
+
+        if (iface->hasBroadcastMethods()) {
+            out << "#include <algorithm>\n";
+            out << "#include <vector>\n";
+        }
+
+        if (iface->hasSharedMemoryCalls()) {
+            out << "#include <cutils/ashmem.h>\n";
+            out << "#include <hwbinder/IPCThreadState.h>\n";
+            out << "#include <linux/futex.h>\n";
+            out << "#include <pthread.h>\n";
+            out << "#include <sys/mman.h>\n";
+            out << "#include <sys/syscall.h>\n";
+            out << "#include <unistd.h>\n";
+            out << "#include <atomic>\n";
+            out << "#include <climits>\n";
+            out << "#include <cstring>\n";
+            out << "#include <map>\n";
+            out << "#include <mutex>\n";
+            out << "#include <thread>\n";
+            out << "#include <utility>\n";
+        }
+
+        if (mCoordinator->isTransactionCaptureEnabled()) {
+            out << "#include <hidl-gen-support/TransactionCapture.h>\n";
+        }
+
+        if (iface->hasCallbackExecutor()) {
+            out << "#include <algorithm>\n";
+            out << "#include <condition_variable>\n";
+            out << "#include <deque>\n";
+            out << "#include <functional>\n";
+            out << "#include <map>\n";
+            out << "#include <mutex>\n";
+            out << "#include <thread>\n";
+            out << "#include <utility>\n";
+        }
     } else {
         generateCppPackageInclude(out, mPackage, "types");
         generateCppPackageInclude(out, mPackage, "hwtypes");
@@ -885,6 +1151,39 @@ void AST::generateCppSource(Formatter& out) const {
             << "::descriptor(\""
             << iface->fqName().string()
             << "\");\n\n";
+
+        // Stubs are created for every local callback object sent over binder,
+        // so the instrumentor names are built once instead of per object.
+        out << "static const std::string& instrumentor_package() ";
+        out.block([&] {
+            out << "static const std::string package(\"" << mPackage.string() << "\");\n";
+            out << "return package;\n";
+        }).endl().endl();
+        out << "static const std::string& instrumentor_interface() ";
+        out.block([&] {
+            out << "static const std::string name(\"" << iface->localName() << "\");\n";
+            out << "return name;\n";
+        }).endl().endl();
+
+        // Proxies sending an interface need the threadpool for the incoming
+        // calls on it. It only has to be started once, which a function-local
+        // static checks without taking the ProcessState lock on every call.
+        // Its size is left to the process owner, see
+        // configureCallbackThreadpool.
+        out << "static void start_callback_threadpool() ";
+        out.block([&] {
+            out << "static const bool started = [] ";
+            out.block([&] {
+                out << "::android::hardware::ProcessState::self()->startThreadPool();\n";
+                out << "return true;\n";
+            });
+            out << "();\n";
+            out << "(void)started;\n";
+        }).endl().endl();
+
+        // libhidl looks up these maps by descriptor, and implementations built
+        // against older headers need not run any code of this file first, so
+        // the wrapper constructors are registered when the library is loaded.
         out << "__attribute__((constructor)) ";
         out << "static void static_constructor() {\n";
         out.indent([&] {
@@ -933,7 +1232,19 @@ void AST::generateCppSource(Formatter& out) const {
         out << "};\n\n";
 
         generateInterfaceSource(out);
+        if (iface->callbackThreads() > 0) {
+            generateCallbackThreadsSource(out, iface);
+        }
+        if (iface->hasBroadcastMethods()) {
+            generateBroadcastSource(out, iface);
+        }
+        if (iface->hasSharedMemoryCalls()) {
+            generateSharedMemoryCallsSource(out, iface);
+        }
         generateProxySource(out, iface->fqName());
+        if (iface->hasCallGroup()) {
+            generateCallGroupSource(out, iface);
+        }
         generateStubSource(out, iface);
         generatePassthroughSource(out);
 
@@ -1030,8 +1341,47 @@ void AST::generateProxyMethodSource(Formatter& out, const std::string& klassName
     }
 
     out.block([&] {
+        if (method->coalesce() != nullptr) {
+            generateCoalescedProxyCall(out, method, superInterface);
+            return;
+        }
+
+        if (mRootScope.getInterface()->hasCoalescedMethods()) {
+            out << "flush_coalesced_calls(&_hidl_mCoalesceSendLock, &_hidl_mCoalescedCalls);\n\n";
+        }
+
         const bool returnsValue = !method->results().empty();
         const NamedReference<Type>* elidedReturn = method->canElideCallback();
+        const NamedReference<Type>* deltaArg = method->deltaArg();
+        const std::string deltaBase = "_hidl_mDeltaBase_" + method->name();
+
+        if (deltaArg != nullptr) {
+            // Only one call at a time sends changes, so the stub sees them in
+            // the order the base was updated in. Calls made meanwhile send the
+            // whole value with stream 0, which the stub does not keep.
+            out << "uint64_t _hidl_delta_stream = 0;\n";
+            out << "uint64_t _hidl_delta_present = " << deltaAllFields(method) << ";\n";
+            out.block([&] {
+                out << "std::lock_guard<std::mutex> _hidl_delta_lock(_hidl_mDeltaLock_"
+                    << method->name() << ");\n";
+                out.sIf("!_hidl_mDeltaBusy_" + method->name(), [&] {
+                    out << "_hidl_mDeltaBusy_" << method->name() << " = true;\n";
+                    out << "_hidl_delta_stream = reinterpret_cast<uintptr_t>(this);\n";
+                    out.sIf(deltaBase + " != nullptr", [&] {
+                        out << "_hidl_delta_present = 0;\n";
+                        const auto& fields = deltaFields(method);
+                        for (size_t i = 0; i < fields.size(); ++i) {
+                            out.sIf(deltaBase + "->" + fields[i]->name() + " != " +
+                                        deltaArg->name() + "." + fields[i]->name(),
+                                    [&] {
+                                        out << "_hidl_delta_present |= 1ull << " << i << ";\n";
+                                    })
+                                .endl();
+                        }
+                    }).endl();
+                }).endl();
+            }).endl().endl();
+        }
 
         method->generateCppReturnType(out);
 
@@ -1043,6 +1393,10 @@ void AST::generateProxyMethodSource(Formatter& out, const std::string& klassName
             << method->name()
             << "(this, this";
 
+        if (deltaArg != nullptr) {
+            out << ", _hidl_delta_stream, _hidl_delta_present";
+        }
+
         if (!method->hasEmptyCppArgSignature()) {
             out << ", ";
         }
@@ -1060,55 +1414,315 @@ void AST::generateProxyMethodSource(Formatter& out, const std::string& klassName
 
         out << ");\n\n";
 
+        if (deltaArg != nullptr) {
+            out.sIf("_hidl_delta_stream != 0", [&] {
+                out << "std::lock_guard<std::mutex> _hidl_delta_lock(_hidl_mDeltaLock_"
+                    << method->name() << ");\n";
+                out << "_hidl_mDeltaBusy_" << method->name() << " = false;\n";
+                out.sIf("!_hidl_out.isOkUnchecked()", [&] {
+                    out << "// The stub may not have applied this call, so the next one\n"
+                        << "// sends every field again.\n";
+                    out << deltaBase << ".reset();\n";
+                }).sElseIf(deltaBase + " == nullptr", [&] {
+                    out << deltaBase << " = std::make_unique<"
+                        << deltaArg->type().getCppStackType() << ">(" << deltaArg->name()
+                        << ");\n";
+                }).sElse([&] {
+                    const auto& fields = deltaFields(method);
+                    for (size_t i = 0; i < fields.size(); ++i) {
+                        out.sIf("(_hidl_delta_present & (1ull << " + std::to_string(i) +
+                                    ")) != 0",
+                                [&] {
+                                    out << deltaBase << "->" << fields[i]->name() << " = "
+                                        << deltaArg->name() << "." << fields[i]->name()
+                                        << ";\n";
+                                })
+                            .endl();
+                    }
+                }).endl();
+            }).endl().endl();
+        }
+
         out << "return _hidl_out;\n";
     }).endl().endl();
 }
 
+void AST::generateProxyCoalescingSource(Formatter& out) const {
+    // Calls held back by @coalesce, oldest first, for all proxies of this
+    // file. A worker thread sends them once their delay has passed. A proxy
+    // is told apart by its send lock, which it keeps while it has calls here.
+    out << "struct coalesced_call ";
+    out.block([&] {
+        out << "::android::sp<::android::RefBase> proxy;\n";
+        out << "std::mutex* sendLock;\n";
+        out << "std::atomic<size_t>* pending;\n";
+        out << "std::string key;\n";
+        out << "nsecs_t sendAtNs;\n";
+        out << "std::function<void()> send;\n";
+    }) << ";\n\n";
+
+    out << "struct coalescing_queue ";
+    out.block([&] {
+        out << "std::mutex lock;\n";
+        out << "std::condition_variable changed;\n";
+        out << "std::deque<coalesced_call> calls;\n";
+    }) << ";\n\n";
+
+    out << "// Takes the calls of the proxy with sendLock off the queue, in order, up to\n"
+        << "// the first one which is not due by untilNs.\n";
+    out << "static std::vector<std::function<void()>> take_coalesced_calls(\n";
+    out.indent(2, [&] {
+        out << "coalescing_queue& queue, const std::mutex* sendLock, nsecs_t untilNs) ";
+    });
+    out.block([&] {
+        out << "std::vector<std::function<void()>> due;\n";
+        out << "for (auto it = queue.calls.begin(); it != queue.calls.end();) ";
+        out.block([&] {
+            out.sIf("it->sendLock != sendLock", [&] {
+                out << "++it;\n";
+                out << "continue;\n";
+            }).endl();
+            out.sIf("it->sendAtNs > untilNs", [&] { out << "break;\n"; }).endl();
+            out << "due.push_back(std::move(it->send));\n";
+            out << "--*it->pending;\n";
+            out << "it = queue.calls.erase(it);\n";
+        }).endl();
+        out << "return due;\n";
+    }).endl().endl();
+
+    out << "static coalescing_queue& get_coalescing_queue() ";
+    out.block([&] {
+        out << "static coalescing_queue* const queue = [] ";
+        out.block([&] {
+            out << "coalescing_queue* created = new coalescing_queue;\n";
+            out << "std::thread([created] ";
+            out.block([&] {
+                out << "std::unique_lock<std::mutex> guard(created->lock);\n";
+                out << "for (;;) ";
+                out.block([&] {
+                    out.sIf("created->calls.empty()", [&] {
+                        out << "created->changed.wait(guard);\n";
+                        out << "continue;\n";
+                    }).endl();
+                    out << "const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);\n";
+                    out.sIf("created->calls.front().sendAtNs > now", [&] {
+                        out << "created->changed.wait_for(guard, std::chrono::nanoseconds(\n";
+                        out.indent(2, [&] {
+                            out << "created->calls.front().sendAtNs - now));\n";
+                        });
+                        out << "continue;\n";
+                    }).endl();
+                    out << "// The send lock of the proxy is taken before its calls are, so\n"
+                        << "// that it cannot send a call of its own in between.\n";
+                    out << "::android::sp<::android::RefBase> proxy = "
+                        << "created->calls.front().proxy;\n";
+                    out << "std::mutex* sendLock = created->calls.front().sendLock;\n";
+                    out << "guard.unlock();\n";
+                    out << "std::lock_guard<std::mutex> sending(*sendLock);\n";
+                    out << "guard.lock();\n";
+                    out << "std::vector<std::function<void()>> due = "
+                        << "take_coalesced_calls(*created, sendLock, now);\n";
+                    out << "guard.unlock();\n";
+                    out << "for (const auto& send : due) send();\n";
+                    out << "guard.lock();\n";
+                }).endl();
+            });
+            out << ").detach();\n";
+            out << "return created;\n";
+        });
+        out << "();\n";
+        out << "return *queue;\n";
+    }).endl().endl();
+
+    out << "// Queues send, replacing the waiting call of the proxy with the same key. The\n"
+        << "// replacement moves to the end of the queue, after the calls made since the\n"
+        << "// one it replaces, but keeps its send time.\n";
+    out << "static void coalesce_call(::android::sp<::android::RefBase> proxy, "
+        << "std::mutex* sendLock,\n";
+    out.indent(2, [&] {
+        out << "std::atomic<size_t>* pending, std::string key, nsecs_t delayNs,\n";
+        out << "std::function<void()> send) ";
+    });
+    out.block([&] {
+        out << "coalescing_queue& queue = get_coalescing_queue();\n";
+        out << "std::lock_guard<std::mutex> guard(queue.lock);\n";
+        out << "nsecs_t sendAtNs = systemTime(SYSTEM_TIME_MONOTONIC) + delayNs;\n";
+        out << "for (auto it = queue.calls.begin(); it != queue.calls.end(); ++it) ";
+        out.block([&] {
+            out.sIf("it->sendLock == sendLock && it->key == key", [&] {
+                out << "sendAtNs = it->sendAtNs;\n";
+                out << "queue.calls.erase(it);\n";
+                out << "--*pending;\n";
+                out << "break;\n";
+            }).endl();
+        }).endl();
+        out << "++*pending;\n";
+        out << "queue.calls.push_back({std::move(proxy), sendLock, pending, std::move(key), "
+            << "sendAtNs,\n";
+        out.indent(2, [&] { out << "std::move(send)});\n"; });
+        out << "queue.changed.notify_all();\n";
+    }).endl().endl();
+
+    out << "// Sends the waiting calls of the proxy with sendLock, before it sends a call of\n"
+        << "// its own.\n";
+    out << "static void flush_coalesced_calls(std::mutex* sendLock, "
+        << "const std::atomic<size_t>* pending) ";
+    out.block([&] {
+        out << "std::lock_guard<std::mutex> sending(*sendLock);\n";
+        out.sIf("*pending == 0", [&] { out << "return;\n"; }).endl();
+        out << "coalescing_queue& queue = get_coalescing_queue();\n";
+        out << "std::vector<std::function<void()>> due;\n";
+        out.block([&] {
+            out << "std::lock_guard<std::mutex> guard(queue.lock);\n";
+            out << "due = take_coalesced_calls(queue, sendLock, "
+                << "std::numeric_limits<nsecs_t>::max());\n";
+        }).endl();
+        out << "for (const auto& send : due) send();\n";
+    }).endl().endl();
+}
+
+void AST::generateCoalescedProxyCall(Formatter& out, const Method* method,
+                                     const Interface* superInterface) const {
+    const Annotation* annotation = method->coalesce();
+    const AnnotationParam* delayMs = annotation->getParam("delayMs");
+    const AnnotationParam* keys = annotation->getParam("keys");
+
+    // The key tells calls apart which must not replace each other: the
+    // method and the values of its key arguments.
+    out << "std::string _hidl_key = \"" << method->getSerialId() << "\";\n";
+    if (keys != nullptr) {
+        for (const std::string& value : keys->getValues()) {
+            const auto* arg = *std::find_if(
+                method->args().begin(), method->args().end(),
+                [&](const auto* arg) { return "\"" + arg->name() + "\"" == value; });
+            const Type* type = arg->type().resolve();
+            if (type->isString()) {
+                out << "_hidl_key += \"|\" + std::to_string(" << arg->name() << ".size()) + \":\";\n";
+                out << "_hidl_key.append(" << arg->name() << ".c_str(), " << arg->name()
+                    << ".size());\n";
+            } else {
+                out << "_hidl_key += \"|\" + std::to_string(static_cast<"
+                    << type->resolveToScalarType()->getCppStackType() << ">(" << arg->name()
+                    << "));\n";
+            }
+        }
+    }
+
+    out << "::android::sp<" << mRootScope.getInterface()->getProxyName()
+        << "> _hidl_proxy = this;\n";
+    out << "coalesce_call(_hidl_proxy, &_hidl_mCoalesceSendLock, &_hidl_mCoalescedCalls,\n";
+    out << "        std::move(_hidl_key), ";
+    if (delayMs == nullptr) {
+        out << "0 /* delayNs */";
+    } else {
+        out << delayMs->getConstantExpressions()[0]->cppValue() << " * 1000000LL /* delayMs */";
+    }
+    out << ", [_hidl_proxy";
+    for (const auto* arg : method->args()) {
+        out << ", " << arg->name();
+    }
+    out << "] ";
+    out.block([&] {
+        out << "::android::hardware::Return<void> _hidl_ret = "
+            << superInterface->fqName().cppNamespace() << "::" << superInterface->getProxyName()
+            << "::_hidl_" << method->name() << "(_hidl_proxy.get(), _hidl_proxy.get()";
+        for (const auto* arg : method->args()) {
+            out << ", " << arg->name();
+        }
+        out << ");\n";
+        out.sIf("!_hidl_ret.isOk()", [&] {
+            out << "ALOGE(\"Coalesced " << method->name() << " failed: %s\", "
+                << "_hidl_ret.description().c_str());\n";
+        }).endl();
+    });
+    out << ");\n\n";
+    out << "return ::android::hardware::Return<void>();\n";
+}
+
 void AST::generateStaticProxyMethodSource(Formatter& out, const std::string& klassName,
-                                          const Method* method, const Interface* superInterface) const {
+                                          const Method* method, const Interface* superInterface,
+                                          bool retained) const {
     if (method->isHidlReserved() && method->overridesCppImpl(IMPL_PROXY)) {
         return;
     }
 
-    method->generateCppReturnType(out);
+    if (retained) {
+        out << "::android::hardware::Return<void> " << klassName << "::" << method->name()
+            << "_retained(const ::android::sp<" << superInterface->localName()
+            << ">& _hidl_this, ";
+        emitRetainedArgSignature(out, method);
+        out << method->name() << "_reply* _hidl_retained) {\n";
+    } else {
+        method->generateCppReturnType(out);
 
-    out << klassName
-        << "::_hidl_"
-        << method->name()
-        << "("
-        << "::android::hardware::IInterface *_hidl_this, "
-        << "::android::hardware::details::HidlInstrumentor *_hidl_this_instrumentor";
+        out << klassName
+            << "::_hidl_"
+            << method->name()
+            << "("
+            << "::android::hardware::IInterface *_hidl_this, "
+            << "::android::hardware::details::HidlInstrumentor *_hidl_this_instrumentor";
 
-    if (!method->hasEmptyCppArgSignature()) {
-        out << ", ";
-    }
+        if (method->delta() != nullptr) {
+            out << ", uint64_t _hidl_delta_stream, uint64_t _hidl_delta_present";
+        }
+
+        if (!method->hasEmptyCppArgSignature()) {
+            out << ", ";
+        }
 
-    method->emitCppArgSignature(out);
-    out << ") {\n";
+        method->emitCppArgSignature(out);
+        out << ") {\n";
+    }
 
     out.indent();
 
-    out << "#ifdef __ANDROID_DEBUGGABLE__\n";
-    out << "bool mEnableInstrumentation = _hidl_this_instrumentor->isInstrumentationEnabled();\n";
-    out << "const auto &mInstrumentationCallbacks = _hidl_this_instrumentor->getInstrumentationCallbacks();\n";
-    out << "#else\n";
-    out << "(void) _hidl_this_instrumentor;\n";
-    out << "#endif // __ANDROID_DEBUGGABLE__\n";
-
     const bool returnsValue = !method->results().empty();
-    const NamedReference<Type>* elidedReturn = method->canElideCallback();
-    if (returnsValue && elidedReturn == nullptr) {
-        generateCheckNonNull(out, "_hidl_cb");
-    }
+    const NamedReference<Type>* elidedReturn = retained ? nullptr : method->canElideCallback();
 
-    generateCppInstrumentationCall(
-            out,
-            InstrumentationEvent::CLIENT_API_ENTRY,
-            method,
-            superInterface);
+    if (retained) {
+        // There is no instrumentor to report to: _hidl_this may be a proxy
+        // for a derived interface.
+        out.sIf("_hidl_retained == nullptr", [&] {
+            out << "return ::android::hardware::Status::fromExceptionCode(\n";
+            out.indent(2, [&] {
+                out << "::android::hardware::Status::EX_ILLEGAL_ARGUMENT,\n"
+                    << "\"Null reply handle passed.\");\n";
+            });
+        }).endl();
+        out.sIf("_hidl_this == nullptr || !_hidl_this->isRemote()", [&] {
+            out << "return ::android::hardware::Status::fromExceptionCode(\n";
+            out.indent(2, [&] {
+                out << "::android::hardware::Status::EX_UNSUPPORTED_OPERATION,\n"
+                    << "\"Replies can only be retained from remote interfaces.\");\n";
+            });
+        }).endl().endl();
+    } else {
+        out << "#ifdef __ANDROID_DEBUGGABLE__\n";
+        out << "bool mEnableInstrumentation = _hidl_this_instrumentor->isInstrumentationEnabled();\n";
+        out << "const auto &mInstrumentationCallbacks = _hidl_this_instrumentor->getInstrumentationCallbacks();\n";
+        out << "#else\n";
+        out << "(void) _hidl_this_instrumentor;\n";
+        out << "#endif // __ANDROID_DEBUGGABLE__\n";
+
+        if (returnsValue && elidedReturn == nullptr) {
+            generateCheckNonNull(out, "_hidl_cb");
+        }
+
+        generateCppInstrumentationCall(
+                out,
+                InstrumentationEvent::CLIENT_API_ENTRY,
+                method,
+                superInterface);
+    }
 
     out << "::android::hardware::Parcel _hidl_data;\n";
-    out << "::android::hardware::Parcel _hidl_reply;\n";
+    if (retained) {
+        out << "std::unique_ptr<::android::hardware::Parcel> _hidl_reply_owner =\n";
+        out.indent(2, [&] { out << "std::make_unique<::android::hardware::Parcel>();\n"; });
+        out << "::android::hardware::Parcel& _hidl_reply = *_hidl_reply_owner;\n";
+    } else {
+        out << "::android::hardware::Parcel _hidl_reply;\n";
+    }
     out << "::android::status_t _hidl_err;\n";
     out << "::android::hardware::Status _hidl_status;\n\n";
 
@@ -1126,6 +1740,10 @@ void AST::generateStaticProxyMethodSource(Formatter& out, const std::string& kla
         if (arg->type().isInterface()) {
             hasInterfaceArgument = true;
         }
+        if (arg == method->deltaArg()) {
+            generateProxyDeltaWrite(out, method);
+            continue;
+        }
         emitCppReaderWriter(
                 out,
                 "_hidl_data",
@@ -1138,6 +1756,9 @@ void AST::generateStaticProxyMethodSource(Formatter& out, const std::string& kla
 
     // Second DFS: resolve references.
     for (const auto &arg : method->args()) {
+        if (arg == method->deltaArg()) {
+            continue;
+        }
         emitCppResolveReferences(
                 out,
                 "_hidl_data",
@@ -1150,10 +1771,25 @@ void AST::generateStaticProxyMethodSource(Formatter& out, const std::string& kla
 
     if (hasInterfaceArgument) {
         // Start binder threadpool to handle incoming transactions
-        out << "::android::hardware::ProcessState::self()->startThreadPool();\n";
+        out << "start_callback_threadpool();\n";
+    }
+    const bool capture = mCoordinator->isTransactionCaptureEnabled() && !method->isHidlReserved();
+    if (capture) {
+        out << "{\n";
+        out.indent();
+        out << "int64_t _hidl_capture_start_ns = ::android::hardware::details::hidlCaptureBegin();\n";
     }
-    out << "_hidl_err = ::android::hardware::IInterface::asBinder(_hidl_this)->transact("
-        << method->getSerialId()
+
+    if (retained) {
+        out << "_hidl_err = ::android::hardware::toBinder<" << superInterface->localName()
+            << ">(_hidl_this)->transact(";
+    } else if (mRootScope.getInterface()->hasSharedMemoryCalls() &&
+               canCallOverSharedMemory(method)) {
+        out << "_hidl_err = shm_transact(_hidl_this, ";
+    } else {
+        out << "_hidl_err = ::android::hardware::IInterface::asBinder(_hidl_this)->transact(";
+    }
+    out << method->getSerialId()
         << " /* "
         << method->name()
         << " */, _hidl_data, &_hidl_reply";
@@ -1163,6 +1799,34 @@ void AST::generateStaticProxyMethodSource(Formatter& out, const std::string& kla
     }
     out << ");\n";
 
+    if (capture) {
+        generateCppCaptureCall(out, method, superInterface, "CLIENT",
+                               method->isOneway() ? Interface::FLAG_ONE_WAY->cppValue() : "0");
+        out.unindent();
+        out << "}\n";
+    }
+
+    if (method->delta() != nullptr) {
+        out.sIf("_hidl_err == ::android::NAME_NOT_FOUND && _hidl_delta_present != " +
+                        deltaAllFields(method),
+                [&] {
+                    out << "// The stub has dropped the value this call changes, so send "
+                        << "all of it.\n";
+                    out << "return _hidl_" << method->name()
+                        << "(_hidl_this, _hidl_this_instrumentor, _hidl_delta_stream, "
+                        << deltaAllFields(method);
+                    for (const auto* arg : method->args()) {
+                        out << ", " << arg->name();
+                    }
+                    if (!method->results().empty() && method->canElideCallback() == nullptr) {
+                        out << ", _hidl_cb";
+                    }
+                    out << ");\n";
+                })
+            .endl()
+            .endl();
+    }
+
     out << "if (_hidl_err != ::android::OK) { goto _hidl_error; }\n\n";
 
     if (!method->isOneway()) {
@@ -1195,7 +1859,14 @@ void AST::generateStaticProxyMethodSource(Formatter& out, const std::string& kla
                     true /* addPrefixToName */);
         }
 
-        if (returnsValue && elidedReturn == nullptr) {
+        if (retained) {
+            out << "_hidl_retained->_hidl_reply = std::move(_hidl_reply_owner);\n";
+            for (const auto* result : method->results()) {
+                out << "_hidl_retained->_hidl_out_" << result->name() << " = _hidl_out_"
+                    << result->name() << ";\n";
+            }
+            out << "\n";
+        } else if (returnsValue && elidedReturn == nullptr) {
             out << "_hidl_cb(";
 
             out.join(method->results().begin(), method->results().end(), ", ", [&] (const auto &arg) {
@@ -1209,11 +1880,13 @@ void AST::generateStaticProxyMethodSource(Formatter& out, const std::string& kla
         }
     }
 
-    generateCppInstrumentationCall(
-            out,
-            InstrumentationEvent::CLIENT_API_EXIT,
-            method,
-            superInterface);
+    if (!retained) {
+        generateCppInstrumentationCall(
+                out,
+                InstrumentationEvent::CLIENT_API_EXIT,
+                method,
+                superInterface);
+    }
 
     if (elidedReturn != nullptr) {
         out << "_hidl_status.setFromStatusT(_hidl_err);\n";
@@ -1244,6 +1917,10 @@ void AST::generateStaticProxyMethodSource(Formatter& out, const std::string& kla
 void AST::generateProxySource(Formatter& out, const FQName& fqName) const {
     const std::string klassName = fqName.getInterfaceProxyName();
 
+    if (mRootScope.getInterface()->hasCoalescedMethods()) {
+        generateProxyCoalescingSource(out);
+    }
+
     out << klassName
         << "::"
         << klassName
@@ -1256,11 +1933,8 @@ void AST::generateProxySource(Formatter& out, const FQName& fqName) const {
         << "<"
         << fqName.getInterfaceName()
         << ">(_hidl_impl),\n"
-        << "  ::android::hardware::details::HidlInstrumentor(\""
-        << mPackage.string()
-        << "\", \""
-        << fqName.getInterfaceName()
-        << "\") {\n";
+        << "  ::android::hardware::details::HidlInstrumentor("
+        << "instrumentor_package(), instrumentor_interface()) {\n";
 
     out.unindent();
     out.unindent();
@@ -1272,43 +1946,163 @@ void AST::generateProxySource(Formatter& out, const FQName& fqName) const {
                     },
                     false /* include parents */);
 
+    const Interface* iface = mRootScope.getInterface();
+    for (const Method* method : iface->userDefinedMethods()) {
+        if (canRetainReply(method)) {
+            generateStaticProxyMethodSource(out, klassName, method, iface, true /* retained */);
+        }
+    }
+
     generateMethods(out, [&](const Method* method, const Interface* superInterface) {
         generateProxyMethodSource(out, klassName, method, superInterface);
     });
 }
 
-void AST::generateStubSource(Formatter& out, const Interface* iface) const {
-    const std::string interfaceName = iface->localName();
-    const std::string klassName = iface->getStubName();
+void AST::generateProxyDeltaWrite(Formatter& out, const Method* method) const {
+    const NamedReference<Type>* arg = method->deltaArg();
+    const auto& fields = deltaFields(method);
 
-    out << klassName
-        << "::"
-        << klassName
-        << "(const ::android::sp<" << interfaceName <<"> &_hidl_impl)\n";
+    out << "_hidl_err = _hidl_data.writeUint64(_hidl_delta_stream);\n";
+    out << "if (_hidl_err != ::android::OK) { goto _hidl_error; }\n\n";
+    out << "_hidl_err = _hidl_data.writeUint64(_hidl_delta_present);\n";
+    out << "if (_hidl_err != ::android::OK) { goto _hidl_error; }\n\n";
 
-    out.indent();
-    out.indent();
+    for (size_t i = 0; i < fields.size(); ++i) {
+        const std::string tempFieldName = "_hidl_delta_" + fields[i]->name();
 
-    if (iface->isIBase()) {
-        out << ": ::android::hardware::details::HidlInstrumentor(\"";
-    } else {
-        out << ": "
-            << gIBaseFqName.getInterfaceStubFqName().cppName()
-            << "(_hidl_impl, \"";
+        out.sIf("(_hidl_delta_present & (1ull << " + std::to_string(i) + ")) != 0", [&] {
+            out << fields[i]->type().getCppArgumentType() << " " << tempFieldName << " = "
+                << arg->name() << "." << fields[i]->name() << ";\n";
+            fields[i]->type().emitReaderWriter(out, tempFieldName, "_hidl_data",
+                                               false /* parcelObjIsPointer */, false /* reader */,
+                                               Type::ErrorMode_Goto);
+        }).endl().endl();
     }
+}
 
-    out << mPackage.string()
-        << "\", \""
-        << interfaceName
-        << "\") { \n";
-    out.indent();
-    out << "_hidl_mImpl = _hidl_impl;\n";
-    out << "auto prio = ::android::hardware::details::gServicePrioMap->get("
-        << "_hidl_impl, {SCHED_NORMAL, 0});\n";
-    out << "mSchedPolicy = prio.sched_policy;\n";
-    out << "mSchedPriority = prio.prio;\n";
-    out << "setRequestingSid(::android::hardware::details::gServiceSidMap->get(_hidl_impl, "
-           "false));\n";
+void AST::generateStubDeltaRead(Formatter& out, const Method* method) const {
+    const NamedReference<Type>* arg = method->deltaArg();
+    const auto& fields = deltaFields(method);
+    const std::string valueType = arg->type().getCppStackType();
+
+    out << "uint64_t _hidl_delta_stream;\n";
+    out << "uint64_t _hidl_delta_present;\n\n";
+    out << "_hidl_err = _hidl_data.readUint64(&_hidl_delta_stream);\n";
+    out << "if (_hidl_err != ::android::OK) { return _hidl_err; }\n\n";
+    out << "_hidl_err = _hidl_data.readUint64(&_hidl_delta_present);\n";
+    out << "if (_hidl_err != ::android::OK) { return _hidl_err; }\n\n";
+
+    out << "// Stream 0 carries a whole value, which later calls do not refer to.\n";
+    out << "std::shared_ptr<delta_base<" << valueType << ">> _hidl_delta_base =\n";
+    out.indent(2, [&] {
+        out << "_hidl_delta_stream == 0 ? std::make_shared<delta_base<" << valueType << ">>()\n";
+        out.indent(2, [&] {
+            out << ": get_delta_base<" << valueType << ">(" << method->getSerialId() << " /* "
+                << method->name() << " */, _hidl_this, _hidl_delta_stream);\n";
+        });
+    });
+    out.sIf("_hidl_delta_present != " + deltaAllFields(method) + " && !_hidl_delta_base->valid",
+            [&] {
+                out << "// The proxy sends every field again when told so.\n";
+                out << "_hidl_err = ::android::NAME_NOT_FOUND;\n";
+                out << "return _hidl_err;\n";
+            }).endl();
+    out << "_hidl_delta_base->valid = false;\n\n";
+
+    for (size_t i = 0; i < fields.size(); ++i) {
+        const std::string tempFieldName = "_hidl_delta_" + fields[i]->name();
+
+        out.sIf("(_hidl_delta_present & (1ull << " + std::to_string(i) + ")) != 0", [&] {
+            out << fields[i]->type().getCppResultType() << " " << tempFieldName << ";\n";
+            fields[i]->type().emitReaderWriter(out, tempFieldName, "_hidl_data",
+                                               false /* parcelObjIsPointer */, true /* reader */,
+                                               Type::ErrorMode_Return);
+            out << "_hidl_delta_base->value." << fields[i]->name() << " = "
+                << (fields[i]->type().resultNeedsDeref() ? "*" : "") << tempFieldName << ";\n";
+        }).endl().endl();
+    }
+
+    out << "_hidl_delta_base->valid = true;\n";
+    // Structs with interfaces are read into a value rather than a pointer.
+    out << arg->name() << " = " << (arg->type().resultNeedsDeref() ? "&" : "")
+        << "_hidl_delta_base->value;\n\n";
+}
+
+void AST::generateStubDeltaSource(Formatter& out) const {
+    out << "// Values of @delta arguments last received by the stubs of this file, per\n"
+        << "// method, stub, calling process and client proxy. The first call of a\n"
+        << "// proxy sends every field, so a value left behind by a proxy that went\n"
+        << "// away is overwritten before it is used again. A call changing a value\n"
+        << "// which is no longer here fails with NAME_NOT_FOUND, and the proxy then\n"
+        << "// sends all of it.\n";
+    out << "template <typename T>\n";
+    out << "struct delta_base ";
+    out.block([&] {
+        out << "T value;\n";
+        out << "bool valid = false;\n";
+        out << "uint64_t lastUse = 0;\n";
+    });
+    out << ";\n\n";
+
+    out << "template <typename T>\n";
+    out << "static std::shared_ptr<delta_base<T>> get_delta_base(uint32_t code, const void* stub, "
+        << "uint64_t stream) ";
+    out.block([&] {
+        out << "// The stub cannot tell when a proxy goes away, so values are dropped\n"
+            << "// once there are this many, least recently used first.\n";
+        out << "constexpr size_t kMaxDeltaBases = 64;\n";
+        out << "using Key = std::tuple<uint32_t, const void*, pid_t, uint64_t>;\n";
+        out << "static std::mutex lock;\n";
+        out << "static std::map<Key, std::shared_ptr<delta_base<T>>> bases;\n";
+        out << "static uint64_t uses = 0;\n\n";
+        out << "const Key key(code, stub, "
+            << "::android::hardware::IPCThreadState::self()->getCallingPid(), stream);\n";
+        out << "std::lock_guard<std::mutex> guard(lock);\n";
+        out << "auto it = bases.find(key);\n";
+        out.sIf("it == bases.end()", [&] {
+            out.sIf("bases.size() >= kMaxDeltaBases", [&] {
+                out << "bases.erase(std::min_element(bases.begin(), bases.end(), "
+                    << "[](const auto& a, const auto& b) {\n";
+                out.indent([&] { out << "return a.second->lastUse < b.second->lastUse;\n"; });
+                out << "}));\n";
+            }).endl();
+            out << "it = bases.emplace(key, std::make_shared<delta_base<T>>()).first;\n";
+        }).endl();
+        out << "it->second->lastUse = ++uses;\n";
+        out << "return it->second;\n";
+    }).endl().endl();
+}
+
+void AST::generateStubSource(Formatter& out, const Interface* iface) const {
+    const std::string interfaceName = iface->localName();
+    const std::string klassName = iface->getStubName();
+
+    out << klassName
+        << "::"
+        << klassName
+        << "(const ::android::sp<" << interfaceName <<"> &_hidl_impl)\n";
+
+    out.indent();
+    out.indent();
+
+    if (iface->isIBase()) {
+        out << ": ::android::hardware::details::HidlInstrumentor(";
+    } else {
+        out << ": "
+            << gIBaseFqName.getInterfaceStubFqName().cppName()
+            << "(_hidl_impl, ";
+    }
+
+    out << "instrumentor_package(), instrumentor_interface()),\n"
+        << "  _hidl_mImpl(_hidl_impl) {\n";
+    out.indent();
+    // libhidl fills both maps per implementation; only a lookup shows if this one has entries.
+    out << "auto prio = ::android::hardware::details::gServicePrioMap->get("
+        << "_hidl_impl, {SCHED_NORMAL, 0});\n";
+    out << "mSchedPolicy = prio.sched_policy;\n";
+    out << "mSchedPriority = prio.prio;\n";
+    out << "setRequestingSid(::android::hardware::details::gServiceSidMap->get(_hidl_impl, "
+           "false));\n";
     out.unindent();
 
     out.unindent();
@@ -1346,6 +2140,20 @@ void AST::generateStubSource(Formatter& out, const Interface* iface) const {
             .endl()
             .endl();
 
+    if (iface->hasAdmissionControl()) {
+        generateStubAdmissionSource(out, iface);
+    }
+
+    if (iface->hasCallbackExecutor()) {
+        generateCallbackExecutorSource(out, iface);
+    }
+
+    const std::vector<Method*>& userMethods = iface->userDefinedMethods();
+    if (std::any_of(userMethods.begin(), userMethods.end(),
+                    [](const Method* method) { return method->delta() != nullptr; })) {
+        generateStubDeltaSource(out);
+    }
+
     generateMethods(out,
                     [&](const Method* method, const Interface* superInterface) {
                         return generateStaticStubMethodSource(out, iface->fqName(), method, superInterface);
@@ -1400,12 +2208,26 @@ void AST::generateStubSource(Formatter& out, const Interface* iface) const {
         out << "if (_hidl_is_oneway != " << (method->isOneway() ? "true" : "false") << ") ";
         out.block([&] { out << "return ::android::UNKNOWN_ERROR;\n"; }).endl().endl();
 
+        if (iface->hasAdmissionControl() && !method->isHidlReserved()) {
+            out.sIf("!admit_call(_hidl_code)", [&] {
+                out << "return ::android::WOULD_BLOCK;\n";
+            }).endl().endl();
+        }
+
         generateStubSourceForMethod(out, method, superInterface);
 
         out.unindent();
         out << "}\n\n";
     }
 
+    if (iface->hasCallGroup()) {
+        generateCallGroupStubSource(out, iface);
+    }
+
+    if (iface->hasSharedMemoryCalls()) {
+        generateSharedMemorySetupStubSource(out);
+    }
+
     out << "default:\n{\n";
     out.indent();
 
@@ -1447,6 +2269,224 @@ void AST::generateStubSource(Formatter& out, const Interface* iface) const {
     out << "}\n\n";
 }
 
+void AST::generateStubAdmissionSource(Formatter& out, const Interface* iface) const {
+    const std::string klassName = iface->getStubName();
+
+    out << "static std::atomic<" << klassName << "::AdmissionPolicy> admission_policy{nullptr};\n\n";
+
+    out << "void " << klassName << "::setAdmissionPolicy(AdmissionPolicy policy) ";
+    out.block([&] { out << "admission_policy.store(policy);\n"; }).endl().endl();
+
+    std::vector<const Method*> limited;
+    for (const auto& tuple : iface->allMethodsFromRoot()) {
+        if (!tuple.method()->isHidlReserved() && tuple.method()->rateLimit() != nullptr) {
+            limited.push_back(tuple.method());
+        }
+    }
+
+    if (limited.empty()) {
+        out << "bool " << klassName
+            << "::defaultAdmissionPolicy(uint32_t /* code */, pid_t /* pid */, "
+               "uid_t /* uid */) ";
+        out.block([&] { out << "return true;\n"; }).endl().endl();
+    } else {
+        out << "bool " << klassName
+            << "::defaultAdmissionPolicy(uint32_t code, pid_t pid, uid_t /* uid */) ";
+        out.block([&] {
+            out << "double callsPerSecond;\n";
+            out << "double burst;\n";
+            out << "switch (code) ";
+            out.block([&] {
+                for (const Method* method : limited) {
+                    const Annotation* annotation = method->rateLimit();
+                    const size_t callsPerSecond = annotation->getParam("callsPerSecond")
+                                                      ->getConstantExpressions()[0]
+                                                      ->castSizeT();
+                    const AnnotationParam* burst = annotation->getParam("burst");
+                    out << "case " << method->getSerialId() << " /* " << method->name()
+                        << " */:\n";
+                    out.indent([&] {
+                        out << "callsPerSecond = " << callsPerSecond << ";\n";
+                        out << "burst = "
+                            << (burst == nullptr ? callsPerSecond
+                                                 : burst->getConstantExpressions()[0]->castSizeT())
+                            << ";\n";
+                        out << "break;\n";
+                    });
+                }
+                out << "default:\n";
+                out.indent([&] { out << "return true;\n"; });
+            }).endl().endl();
+
+            out << "// A token bucket per method and calling process. Buckets which have refilled\n"
+                << "// are the same as new ones, so they are dropped once there are many. The\n"
+                << "// next sweep waits until the number of buckets has doubled, so that sweeps\n"
+                << "// cost amortized constant time per call even when all buckets are in use.\n";
+            out << "struct Bucket ";
+            out.block([&] {
+                out << "double tokens;\n";
+                out << "nsecs_t refilledNs;\n";
+                out << "nsecs_t fullNs;\n";
+            }) << ";\n";
+            out << "static std::mutex lock;\n";
+            out << "static std::map<std::pair<uint32_t, pid_t>, Bucket> buckets;\n";
+            out << "static size_t sweepAt = 1024;\n\n";
+
+            out << "const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);\n";
+            out << "std::lock_guard<std::mutex> guard(lock);\n";
+            out.sIf("buckets.size() >= sweepAt", [&] {
+                out << "for (auto it = buckets.begin(); it != buckets.end();) ";
+                out.block([&] {
+                    out << "it = it->second.fullNs <= now ? buckets.erase(it) : std::next(it);\n";
+                }).endl();
+                out << "sweepAt = std::max<size_t>(1024, 2 * buckets.size());\n";
+            }).endl();
+            out << "Bucket& bucket = buckets.emplace(std::make_pair(code, pid), "
+                << "Bucket{burst, now, now}).first->second;\n";
+            out << "bucket.tokens = std::min(burst, bucket.tokens + "
+                << "(now - bucket.refilledNs) * callsPerSecond / 1e9);\n";
+            out << "bucket.refilledNs = now;\n";
+            out.sIf("bucket.tokens < 1", [&] { out << "return false;\n"; }).endl();
+            out << "bucket.tokens -= 1;\n";
+            out << "bucket.fullNs = now + "
+                << "static_cast<nsecs_t>((burst - bucket.tokens) / callsPerSecond * 1e9);\n";
+            out << "return true;\n";
+        }).endl().endl();
+    }
+
+    out << "static bool admit_call(uint32_t code) ";
+    out.block([&] {
+        out << klassName << "::AdmissionPolicy policy = "
+            << "admission_policy.load(std::memory_order_relaxed);\n";
+        out.sIf("policy == nullptr", [&] {
+            out << "policy = &" << klassName << "::defaultAdmissionPolicy;\n";
+        }).endl();
+        out << "::android::hardware::IPCThreadState* state = "
+            << "::android::hardware::IPCThreadState::self();\n";
+        out << "return policy(code, state->getCallingPid(), state->getCallingUid());\n";
+    }).endl().endl();
+}
+
+void AST::generateCallbackExecutorSource(Formatter& out, const Interface* iface) const {
+    const std::string overflow = iface->callbackExecutorOverflow();
+    const std::string capacity = std::to_string(iface->callbackExecutorCapacity());
+
+    // One queue and worker thread per interface, created with the first
+    // queued call. Calls are run in the order they were received, and each
+    // object may have up to capacity of them queued.
+    out << "// @callbackExecutor(capacity=" << capacity << ", overflow=\"" << overflow << "\")\n";
+    out << "static void execute_callback(const void* impl, uint32_t code, "
+        << "std::function<void()> call) ";
+    out.block([&] {
+        out << "struct Queued ";
+        out.block([&] {
+            out << "const void* impl;\n";
+            out << "uint32_t code;\n";
+            out << "std::function<void()> call;\n";
+        }) << ";\n";
+        out << "struct Queue ";
+        out.block([&] {
+            out << "std::mutex lock;\n";
+            out << "std::condition_variable changed;\n";
+            out << "std::deque<Queued> calls;\n";
+            out << "// Queued calls per object. The calls hold their object, so its\n"
+                << "// address is not reused while it has any.\n";
+            out << "std::map<const void*, size_t> counts;\n";
+        }) << ";\n";
+        out << "static Queue* const queue = [] ";
+        out.block([&] {
+            out << "Queue* created = new Queue;\n";
+            out << "std::thread([created] ";
+            out.block([&] {
+                out << "for (;;) ";
+                out.block([&] {
+                    out << "std::unique_lock<std::mutex> guard(created->lock);\n";
+                    out << "created->changed.wait(guard, [created] "
+                        << "{ return !created->calls.empty(); });\n";
+                    out << "std::function<void()> next = "
+                        << "std::move(created->calls.front().call);\n";
+                    out << "auto counted = created->counts.find(created->calls.front().impl);\n";
+                    out << "if (--counted->second == 0) created->counts.erase(counted);\n";
+                    out << "created->calls.pop_front();\n";
+                    out << "guard.unlock();\n";
+                    out << "created->changed.notify_all();\n";
+                    out << "next();\n";
+                }).endl();
+            });
+            out << ").detach();\n";
+            out << "return created;\n";
+        });
+        out << "();\n\n";
+
+        if (overflow != "block") {
+            out << "// Destroyed after the lock is released, since it may hold the last\n"
+                << "// reference to its object.\n";
+            out << "std::function<void()> dropped;\n";
+        }
+        out << "std::unique_lock<std::mutex> guard(queue->lock);\n";
+        if (overflow == "block") {
+            out << "queue->changed.wait(guard, [impl] ";
+            out.block([&] {
+                out << "auto counted = queue->counts.find(impl);\n";
+                out << "return counted == queue->counts.end() || counted->second < " << capacity
+                    << ";\n";
+            });
+            out << ");\n";
+        } else {
+            out << "auto counted = queue->counts.find(impl);\n";
+            out.sIf("counted != queue->counts.end() && counted->second >= " + capacity, [&] {
+                if (overflow == "coalesce") {
+                    out << "auto pending = std::find_if(queue->calls.rbegin(), "
+                        << "queue->calls.rend(),\n";
+                    out.indent(2, [&] {
+                        out << "[impl, code](const Queued& queued) "
+                            << "{ return queued.impl == impl && queued.code == code; });\n";
+                    });
+                    out.sIf("pending != queue->calls.rend()", [&] {
+                        out << "dropped = std::move(pending->call);\n";
+                        out << "pending->call = std::move(call);\n";
+                        out << "return;\n";
+                    }).endl();
+                }
+                out << "auto oldest = std::find_if(queue->calls.begin(), queue->calls.end(),\n";
+                out.indent(2, [&] {
+                    out << "[impl](const Queued& queued) { return queued.impl == impl; });\n";
+                });
+                out << "dropped = std::move(oldest->call);\n";
+                out << "queue->calls.erase(oldest);\n";
+                out << "--counted->second;\n";
+            }).endl();
+        }
+        out << "queue->calls.push_back(Queued{impl, code, std::move(call)});\n";
+        out << "++queue->counts[impl];\n";
+        out << "guard.unlock();\n";
+        out << "queue->changed.notify_all();\n";
+    }).endl().endl();
+}
+
+void AST::generateQueuedStubCall(Formatter& out, const Method* method,
+                                 const std::string& callee) const {
+    // The arguments are views into _hidl_data, so the queued call copies them.
+    out << "::android::sp<" << mRootScope.getInterface()->localName() << "> _hidl_impl = "
+        << callee << ";\n";
+    out << "execute_callback(_hidl_impl.get(), " << method->getSerialId() << " /* "
+        << method->name() << " */, [_hidl_impl";
+    for (const auto* arg : method->args()) {
+        out << ", " << arg->name();
+        if (arg->type().resultNeedsDeref()) {
+            out << " = *" << arg->name();
+        }
+    }
+    out << "] ";
+    out.block([&] {
+        out << "_hidl_impl->" << method->name() << "(";
+        out.join(method->args().begin(), method->args().end(), ", ",
+                 [&](const auto* arg) { out << arg->name(); });
+        out << ").assertOk();\n";
+    });
+    out << ");\n\n";
+}
+
 void AST::generateStubSourceForMethod(Formatter& out, const Method* method,
                                       const Interface* superInterface) const {
     if (method->isHidlReserved() && method->overridesCppImpl(IMPL_STUB)) {
@@ -1455,6 +2495,11 @@ void AST::generateStubSourceForMethod(Formatter& out, const Method* method,
         return;
     }
 
+    const bool capture = mCoordinator->isTransactionCaptureEnabled() && !method->isHidlReserved();
+    if (capture) {
+        out << "int64_t _hidl_capture_start_ns = ::android::hardware::details::hidlCaptureBegin();\n";
+    }
+
     out << "_hidl_err = "
         << superInterface->fqName().cppNamespace()
         << "::"
@@ -1462,9 +2507,25 @@ void AST::generateStubSourceForMethod(Formatter& out, const Method* method,
         << "::_hidl_"
         << method->name()
         << "(this, _hidl_data, _hidl_reply, _hidl_cb);\n";
+
+    if (capture) {
+        generateCppCaptureCall(out, method, superInterface, "SERVER", "_hidl_flags");
+    }
     out << "break;\n";
 }
 
+void AST::generateCppCaptureCall(Formatter& out, const Method* method,
+                                 const Interface* superInterface, const std::string& side,
+                                 const std::string& flags) const {
+    out << "::android::hardware::details::hidlCaptureEnd(\n";
+    out.indent(2, [&] {
+        out << superInterface->fqName().cppName() << "::descriptor, " << method->getSerialId()
+            << " /* " << method->name() << " */, " << flags << ",\n"
+            << "::android::hardware::details::hidl_transaction_side::" << side
+            << ", _hidl_capture_start_ns, _hidl_data);\n";
+    });
+}
+
 void AST::generateStaticStubMethodSource(Formatter& out, const FQName& fqName,
                                          const Method* method, const Interface* superInterface) const {
     if (method->isHidlReserved() && method->overridesCppImpl(IMPL_STUB)) {
@@ -1506,6 +2567,10 @@ void AST::generateStaticStubMethodSource(Formatter& out, const FQName& fqName,
 
     // First DFS: write buffers
     for (const auto &arg : method->args()) {
+        if (arg == method->deltaArg()) {
+            generateStubDeltaRead(out, method);
+            continue;
+        }
         emitCppReaderWriter(
                 out,
                 "_hidl_data",
@@ -1518,6 +2583,9 @@ void AST::generateStaticStubMethodSource(Formatter& out, const FQName& fqName,
 
     // Second DFS: resolve references
     for (const auto &arg : method->args()) {
+        if (arg == method->deltaArg()) {
+            continue;
+        }
         emitCppResolveReferences(
                 out,
                 "_hidl_data",
@@ -1594,6 +2662,24 @@ void AST::generateStaticStubMethodSource(Formatter& out, const FQName& fqName,
             out << "bool _hidl_callbackCalled = false;\n\n";
         }
 
+        if (superInterface->hasCallbackExecutor() && method->isOneway() &&
+            !method->isHidlReserved()) {
+            generateQueuedStubCall(out, method, callee);
+            out << "(void) _hidl_cb;\n\n";
+            generateCppInstrumentationCall(
+                    out,
+                    InstrumentationEvent::SERVER_API_EXIT,
+                    method,
+                    superInterface);
+            out << "::android::hardware::writeToParcel("
+                << "::android::hardware::Status::ok(), "
+                << "_hidl_reply);\n\n";
+            out << "return _hidl_err;\n";
+            out.unindent();
+            out << "}\n\n";
+            return;
+        }
+
         out << "::android::hardware::Return<void> _hidl_ret = " << callee << "->" << method->name()
             << "(";
 
@@ -1832,6 +2918,19 @@ void AST::generateInterfaceSource(Formatter& out) const {
     }
 }
 
+void AST::generateCallbackThreadsSource(Formatter& out, const Interface* iface) const {
+    const size_t threads = iface->callbackThreads();
+    out << "::android::status_t " << iface->localName() << "::configureCallbackThreadpool() ";
+    out.block([&] {
+        out << "auto _hidl_state = ::android::hardware::ProcessState::self();\n";
+        out.sIf("_hidl_state->getMaxThreads() >= " + std::to_string(threads), [&] {
+            out << "return ::android::OK;\n";
+        }).endl();
+        out << "return _hidl_state->setThreadPoolConfiguration(" << threads
+            << ", false /* callerJoinsPool */);\n";
+    }).endl().endl();
+}
+
 void AST::generatePassthroughSource(Formatter& out) const {
     const Interface* iface = mRootScope.getInterface();
 
@@ -1842,11 +2941,8 @@ void AST::generatePassthroughSource(Formatter& out) const {
         << klassName
         << "(const ::android::sp<"
         << iface->fullName()
-        << "> impl) : ::android::hardware::details::HidlInstrumentor(\""
-        << mPackage.string()
-        << "\", \""
-        << iface->localName()
-        << "\"), mImpl(impl) {";
+        << "> impl) : ::android::hardware::details::HidlInstrumentor("
+        << "instrumentor_package(), instrumentor_interface()), mImpl(impl) {";
     if (iface->hasOnewayMethods()) {
         out << "\n";
         out.indent([&] {
@@ -1881,6 +2977,832 @@ void AST::generatePassthroughSource(Formatter& out) const {
     }
 }
 
+void AST::generateBroadcastSignature(Formatter& out, const Method* method,
+                                     const std::string& className) const {
+    const Interface* iface = mRootScope.getInterface();
+    out << "std::vector<::android::status_t> ";
+    if (!className.empty()) {
+        out << className << "::";
+    }
+    out << "broadcast_" << method->name() << "(std::vector<::android::sp<" << iface->localName()
+        << ">>* _hidl_targets";
+    if (!method->args().empty()) {
+        out << ", ";
+    }
+    method->emitCppArgSignature(out, true /* specify namespaces */);
+    out << ")";
+}
+
+void AST::generateBroadcastSource(Formatter& out, const Interface* iface) const {
+    for (const Method* method : iface->userDefinedMethods()) {
+        if (method->broadcast() == nullptr) {
+            continue;
+        }
+
+        generateBroadcastSignature(out, method, iface->localName());
+        out << " ";
+        out.block([&] {
+            out << "std::vector<::android::status_t> _hidl_statuses(_hidl_targets->size(), "
+                << "::android::OK);\n";
+            out << "::android::hardware::Parcel _hidl_data;\n";
+            out << "::android::status_t _hidl_err = ::android::OK;\n\n";
+
+            // The same parcel is sent to every remote target.
+            out.sIf("std::any_of(_hidl_targets->begin(), _hidl_targets->end(),\n"
+                    "        [](const auto& _hidl_target) { "
+                    "return _hidl_target != nullptr && _hidl_target->isRemote(); })",
+                    [&] {
+                out << "_hidl_err = _hidl_data.writeInterfaceToken(" << iface->localName()
+                    << "::descriptor);\n";
+                out << "if (_hidl_err != ::android::OK) { goto _hidl_error; }\n\n";
+
+                for (const auto* arg : method->args()) {
+                    emitCppReaderWriter(out, "_hidl_data", false /* parcelObjIsPointer */, arg,
+                                        false /* reader */, Type::ErrorMode_Goto,
+                                        false /* addPrefixToName */);
+                }
+                for (const auto* arg : method->args()) {
+                    emitCppResolveReferences(out, "_hidl_data", false /* parcelObjIsPointer */,
+                                             arg, false /* reader */, Type::ErrorMode_Goto,
+                                             false /* addPrefixToName */);
+                }
+            }).endl().endl();
+
+            out << "_hidl_error:\n";
+            out.sFor("size_t _hidl_index = 0; _hidl_index < _hidl_targets->size(); ++_hidl_index",
+                     [&] {
+                out << "const ::android::sp<" << iface->localName()
+                    << ">& _hidl_target = (*_hidl_targets)[_hidl_index];\n";
+                out.sIf("_hidl_target == nullptr", [&] {
+                    out << "_hidl_statuses[_hidl_index] = ::android::DEAD_OBJECT;\n";
+                }).sElseIf("!_hidl_target->isRemote()", [&] {
+                    out << "::android::hardware::Return<void> _hidl_ret = _hidl_target->"
+                        << method->name() << "(";
+                    out.join(method->args().begin(), method->args().end(), ", ",
+                             [&](const auto* arg) { out << arg->name(); });
+                    out << ");\n";
+                    out << "_hidl_statuses[_hidl_index] = _hidl_ret.isOk() ? ::android::OK\n";
+                    out.indent(2, [&] {
+                        out << ": _hidl_ret.isDeadObject() ? ::android::DEAD_OBJECT\n";
+                        out << ": ::android::UNKNOWN_ERROR;\n";
+                    });
+                }).sElseIf("_hidl_err != ::android::OK", [&] {
+                    out << "_hidl_statuses[_hidl_index] = _hidl_err;\n";
+                }).sElse([&] {
+                    out << "::android::hardware::Parcel _hidl_reply;\n";
+                    out << "_hidl_statuses[_hidl_index] = ::android::hardware::toBinder<"
+                        << iface->localName() << ">(_hidl_target)->transact(\n";
+                    out.indent(2, [&] {
+                        out << method->getSerialId() << " /* " << method->name()
+                            << " */, _hidl_data, &_hidl_reply, "
+                            << Interface::FLAG_ONE_WAY->cppValue() << ");\n";
+                    });
+                }).endl();
+            }).endl().endl();
+
+            out << "size_t _hidl_kept = 0;\n";
+            out.sFor("size_t _hidl_index = 0; _hidl_index < _hidl_targets->size(); ++_hidl_index",
+                     [&] {
+                out.sIf("_hidl_statuses[_hidl_index] != ::android::DEAD_OBJECT", [&] {
+                    out << "(*_hidl_targets)[_hidl_kept++] = "
+                        << "std::move((*_hidl_targets)[_hidl_index]);\n";
+                }).endl();
+            }).endl();
+            out << "_hidl_targets->resize(_hidl_kept);\n";
+            out << "return _hidl_statuses;\n";
+        }).endl().endl();
+    }
+}
+
+void AST::generateCallGroupDeclaration(Formatter& out, const Interface* iface) const {
+    const std::string klassName = iface->localName() + "::CallGroup";
+
+    out << "struct " << klassName << " {\n";
+    out.indent([&] {
+        out << "explicit CallGroup(const ::android::sp<" << iface->localName()
+            << ">& _hidl_interface);\n";
+
+        for (const auto& tuple : iface->callGroupMethods()) {
+            const Method* method = tuple.method();
+            const NamedReference<Type>* elidedReturn = method->canElideCallback();
+
+            out << "\n";
+            if (elidedReturn != nullptr) {
+                out << "using " << method->name() << "_cb = std::function<void("
+                    << elidedReturn->type().getCppResultType() << ")>;\n";
+            }
+            DocComment("Queues a call to " + method->name() +
+                       (method->results().empty() ? "." : ", passing its results to _hidl_cb."))
+                    .emit(out);
+            out << "void " << method->name() << "(";
+            method->emitCppArgSignature(out);
+            if (elidedReturn != nullptr) {
+                if (!method->args().empty()) {
+                    out << ", ";
+                }
+                out << method->name() << "_cb _hidl_cb";
+            }
+            out << ");\n";
+        }
+
+        out << "\n";
+        DocComment(
+                "Sends all queued calls in one transaction and empties the queue.\n"
+                "The server runs them in order and stops at the first failing call,\n"
+                "whose status is returned.")
+                .emit(out);
+        out << "::android::hardware::Return<void> execute();\n\n";
+        DocComment(
+                "Status of a call sent by the last execute().\n"
+                "Calls skipped after a failure report EX_TRANSACTION_FAILED.")
+                .emit(out);
+        out << "const ::android::hardware::Status& getStatus(size_t _hidl_index) const;\n\n";
+    });
+    out << "private:\n";
+    out.indent([&] {
+        out << "struct _hidl_Call {\n";
+        out.indent([&] {
+            out << "std::function<::android::status_t(::android::hardware::Parcel&)> write;\n"
+                << "std::function<::android::status_t(const ::android::hardware::Parcel&)> read;\n"
+                << "std::function<::android::hardware::Status(" << iface->localName()
+                << "*)> invoke;\n";
+        });
+        out << "};\n\n";
+        out << "::android::sp<" << iface->localName() << "> _hidl_mInterface;\n"
+            << "std::vector<_hidl_Call> _hidl_mCalls;\n"
+            << "std::vector<::android::hardware::Status> _hidl_mStatuses;\n";
+    });
+    out << "};\n\n";
+}
+
+void AST::generateCallGroupSource(Formatter& out, const Interface* iface) const {
+    const std::string klassName = iface->localName() + "::CallGroup";
+
+    out << klassName << "::CallGroup(const ::android::sp<" << iface->localName()
+        << ">& _hidl_interface)\n";
+    out.indent(2, [&] { out << ": _hidl_mInterface(_hidl_interface) {}\n\n"; });
+
+    for (const auto& tuple : iface->callGroupMethods()) {
+        const Method* method = tuple.method();
+        const Interface* superInterface = tuple.interface();
+        const bool returnsValue = !method->results().empty();
+        const NamedReference<Type>* elidedReturn = method->canElideCallback();
+
+        out << "void " << klassName << "::" << method->name() << "(";
+        method->emitCppArgSignature(out);
+        if (elidedReturn != nullptr) {
+            if (!method->args().empty()) {
+                out << ", ";
+            }
+            out << method->name() << "_cb _hidl_cb";
+        }
+        out << ") ";
+        out.block([&] {
+            out << "_hidl_Call _hidl_call;\n\n";
+
+            // The arguments are captured by value so that the buffers they
+            // refer to stay alive until execute() sends them.
+            out << "_hidl_call.write = [=](::android::hardware::Parcel& _hidl_data) "
+                << "-> ::android::status_t ";
+            out.block([&] {
+                bool hasInterfaceArgument = false;
+
+                out << "::android::status_t _hidl_err = _hidl_data.writeUint32("
+                    << method->getSerialId() << " /* " << method->name() << " */);\n";
+                out << "if (_hidl_err != ::android::OK) { return _hidl_err; }\n\n";
+                out << "_hidl_err = _hidl_data.writeInterfaceToken("
+                    << superInterface->fqName().cppName() << "::descriptor);\n";
+                out << "if (_hidl_err != ::android::OK) { return _hidl_err; }\n\n";
+
+                for (const auto& arg : method->args()) {
+                    if (arg->type().isInterface()) {
+                        hasInterfaceArgument = true;
+                    }
+                    emitCppReaderWriter(out, "_hidl_data", false /* parcelObjIsPointer */, arg,
+                                        false /* reader */, Type::ErrorMode_Return,
+                                        false /* addPrefixToName */);
+                }
+
+                for (const auto& arg : method->args()) {
+                    emitCppResolveReferences(out, "_hidl_data", false /* parcelObjIsPointer */,
+                                             arg, false /* reader */, Type::ErrorMode_Return,
+                                             false /* addPrefixToName */);
+                }
+
+                if (hasInterfaceArgument) {
+                    out << "start_callback_threadpool();\n";
+                }
+                out << "return ::android::OK;\n";
+            });
+            out << ";\n\n";
+
+            if (returnsValue) {
+                out << "_hidl_call.read = [_hidl_cb](const ::android::hardware::Parcel& "
+                    << "_hidl_reply) -> ::android::status_t ";
+                out.block([&] {
+                    out << "::android::status_t _hidl_err;\n";
+                    declareCppReaderLocals(out, method->results(), true /* forResults */);
+
+                    for (const auto& arg : method->results()) {
+                        emitCppReaderWriter(out, "_hidl_reply", false /* parcelObjIsPointer */,
+                                            arg, true /* reader */, Type::ErrorMode_Return,
+                                            true /* addPrefixToName */);
+                    }
+
+                    for (const auto& arg : method->results()) {
+                        emitCppResolveReferences(out, "_hidl_reply",
+                                                 false /* parcelObjIsPointer */, arg,
+                                                 true /* reader */, Type::ErrorMode_Return,
+                                                 true /* addPrefixToName */);
+                    }
+
+                    out << "_hidl_cb(";
+                    out.join(method->results().begin(), method->results().end(), ", ",
+                             [&](const auto& arg) {
+                                 if (arg->type().resultNeedsDeref()) {
+                                     out << "*";
+                                 }
+                                 out << "_hidl_out_" << arg->name();
+                             });
+                    out << ");\n";
+                    out << "return ::android::OK;\n";
+                });
+                out << ";\n\n";
+            }
+
+            out << "_hidl_call.invoke = [=](" << iface->localName()
+                << "* _hidl_interface) -> ::android::hardware::Status ";
+            out.block([&] {
+                out << "auto _hidl_ret = _hidl_interface->" << method->name() << "(";
+                out.join(method->args().begin(), method->args().end(), ", ",
+                         [&](const auto& arg) { out << arg->name(); });
+                if (returnsValue && elidedReturn == nullptr) {
+                    if (!method->args().empty()) {
+                        out << ", ";
+                    }
+                    out << "_hidl_cb";
+                }
+                out << ");\n";
+                out.sIf("!_hidl_ret.isOk()", [&] {
+                    out << "return ::android::hardware::Status::fromExceptionCode(\n";
+                    out.indent(2, [&] {
+                        out << "::android::hardware::Status::EX_TRANSACTION_FAILED,\n"
+                            << "_hidl_ret.description().c_str());\n";
+                    });
+                }).endl();
+                if (elidedReturn != nullptr) {
+                    out << "_hidl_cb(_hidl_ret);\n";
+                }
+                out << "return ::android::hardware::Status::ok();\n";
+            });
+            out << ";\n\n";
+
+            out << "_hidl_mCalls.push_back(std::move(_hidl_call));\n";
+        }).endl().endl();
+    }
+
+    out << "::android::hardware::Return<void> " << klassName << "::execute() ";
+    out.block([&] {
+        out << "std::vector<_hidl_Call> _hidl_calls;\n"
+            << "_hidl_calls.swap(_hidl_mCalls);\n"
+            << "_hidl_mStatuses.assign(_hidl_calls.size(),\n";
+        out.indent(2, [&] {
+            out << "::android::hardware::Status::fromExceptionCode(\n";
+            out.indent(2, [&] {
+                out << "::android::hardware::Status::EX_TRANSACTION_FAILED,\n"
+                    << "\"Call was not executed.\"));\n\n";
+            });
+        });
+
+        out.sIf("!_hidl_mInterface->isRemote()", [&] {
+            out.sFor("size_t _hidl_index = 0; _hidl_index < _hidl_calls.size(); ++_hidl_index",
+                     [&] {
+                         out << "_hidl_mStatuses[_hidl_index] = "
+                             << "_hidl_calls[_hidl_index].invoke(_hidl_mInterface.get());\n";
+                         out.sIf("!_hidl_mStatuses[_hidl_index].isOk()", [&] {
+                             out << "return _hidl_mStatuses[_hidl_index];\n";
+                         }).endl();
+                     }).endl();
+            out << "return ::android::hardware::Void();\n";
+        }).endl().endl();
+
+        out << "::android::hardware::Parcel _hidl_data;\n"
+            << "::android::hardware::Parcel _hidl_reply;\n"
+            << "::android::status_t _hidl_err = _hidl_data.writeUint32(_hidl_calls.size());\n"
+            << "if (_hidl_err != ::android::OK) { "
+            << "return ::android::hardware::Status::fromStatusT(_hidl_err); }\n\n";
+
+        out.sFor("const auto& _hidl_call : _hidl_calls", [&] {
+            out << "_hidl_err = _hidl_call.write(_hidl_data);\n"
+                << "if (_hidl_err != ::android::OK) { "
+                << "return ::android::hardware::Status::fromStatusT(_hidl_err); }\n";
+        }).endl().endl();
+
+        out << "_hidl_err = ::android::hardware::toBinder<" << iface->localName()
+            << ">(_hidl_mInterface)->transact(\n";
+        out.indent(2, [&] {
+            out << Interface::CALL_GROUP_TRANSACTION->cppValue() << ", _hidl_data, &_hidl_reply);\n";
+        });
+        out << "if (_hidl_err != ::android::OK) { "
+            << "return ::android::hardware::Status::fromStatusT(_hidl_err); }\n\n";
+
+        out.sFor("size_t _hidl_index = 0; _hidl_index < _hidl_calls.size(); ++_hidl_index", [&] {
+            out << "::android::hardware::Status& _hidl_status = _hidl_mStatuses[_hidl_index];\n"
+                << "_hidl_err = ::android::hardware::readFromParcel(&_hidl_status, _hidl_reply);\n"
+                << "if (_hidl_err == ::android::OK && _hidl_status.isOk() && "
+                << "_hidl_calls[_hidl_index].read) ";
+            out.block([&] { out << "_hidl_err = _hidl_calls[_hidl_index].read(_hidl_reply);\n"; })
+                    .endl();
+            out.sIf("_hidl_err != ::android::OK", [&] {
+                out << "_hidl_status = ::android::hardware::Status::fromStatusT(_hidl_err);\n";
+            }).endl();
+            out.sIf("!_hidl_status.isOk()", [&] { out << "return _hidl_status;\n"; }).endl();
+        }).endl().endl();
+
+        out << "return ::android::hardware::Void();\n";
+    }).endl().endl();
+
+    out << "const ::android::hardware::Status& " << klassName
+        << "::getStatus(size_t _hidl_index) const ";
+    out.block([&] { out << "return _hidl_mStatuses.at(_hidl_index);\n"; }).endl().endl();
+}
+
+void AST::generateCallGroupStubSource(Formatter& out, const Interface* iface) const {
+    out << "case " << Interface::CALL_GROUP_TRANSACTION->cppValue() << ":\n{\n";
+    out.indent([&] {
+        out << "bool _hidl_is_oneway = _hidl_flags & " << Interface::FLAG_ONE_WAY->cppValue()
+            << ";\n";
+        out << "if (_hidl_is_oneway != false) ";
+        out.block([&] { out << "return ::android::UNKNOWN_ERROR;\n"; }).endl().endl();
+
+        out << "uint32_t _hidl_call_count;\n"
+            << "_hidl_err = _hidl_data.readUint32(&_hidl_call_count);\n"
+            << "if (_hidl_err != ::android::OK) { break; }\n\n";
+
+        // Every call reuses the regular per-method handler, which also checks
+        // the interface token of the call. Results are appended to the same
+        // reply, which is only sent once all calls ran.
+        out << "TransactCallback _hidl_call_cb = "
+            << "[](::android::hardware::Parcel&) {};\n\n";
+
+        out.sFor("uint32_t _hidl_index = 0; _hidl_index < _hidl_call_count; ++_hidl_index", [&] {
+            out << "uint32_t _hidl_call_code;\n"
+                << "_hidl_err = _hidl_data.readUint32(&_hidl_call_code);\n\n";
+
+            out.sIf("_hidl_err == ::android::OK", [&] {
+                out << "switch (_hidl_call_code) {\n";
+                out.indent([&] {
+                    for (const auto& tuple : iface->callGroupMethods()) {
+                        const Method* method = tuple.method();
+                        const Interface* superInterface = tuple.interface();
+
+                        out << "case " << method->getSerialId() << " /* " << method->name()
+                            << " */:\n";
+                        out.indent([&] {
+                            if (iface->hasAdmissionControl()) {
+                                // Each call of the group is admitted like a call of its own.
+                                out.sIf("!admit_call(_hidl_call_code)", [&] {
+                                    out << "_hidl_err = ::android::WOULD_BLOCK;\n";
+                                    out << "break;\n";
+                                }).endl();
+                            }
+                            out << "_hidl_err = " << superInterface->fqName().cppNamespace()
+                                << "::" << superInterface->getStubName() << "::_hidl_"
+                                << method->name()
+                                << "(this, _hidl_data, _hidl_reply, _hidl_call_cb);\n";
+                            out << "break;\n";
+                        });
+                    }
+                    out << "default:\n";
+                    out.indent([&] {
+                        out << "_hidl_err = ::android::UNKNOWN_TRANSACTION;\n";
+                        out << "break;\n";
+                    });
+                });
+                out << "}\n";
+            }).endl().endl();
+
+            out.sIf("_hidl_err != ::android::OK", [&] {
+                out << "::android::hardware::writeToParcel(\n";
+                out.indent(2, [&] {
+                    out << "_hidl_err == ::android::UNEXPECTED_NULL\n";
+                    out.indent(2, [&] {
+                        out << "? ::android::hardware::Status::fromExceptionCode("
+                            << "::android::hardware::Status::EX_NULL_POINTER)\n"
+                            << ": ::android::hardware::Status::fromStatusT(_hidl_err),\n";
+                    });
+                    out << "_hidl_reply);\n";
+                });
+                out << "break;\n";
+            }).endl();
+        }).endl().endl();
+
+        out << "_hidl_err = ::android::OK;\n";
+        out << "_hidl_cb(*_hidl_reply);\n";
+        out << "break;\n";
+    });
+    out << "}\n\n";
+}
+
+void AST::generateSharedMemoryCallsSource(Formatter& out, const Interface* iface) const {
+    out << "// Shared memory region of a @sharedMemoryCalls channel: this header, then\n"
+        << "// the parcel data of the call in flight. The client writes a request and\n"
+        << "// moves state from shm_ready to shm_request; the stub thread serving the\n"
+        << "// channel runs it, writes the reply in its place and moves state back.\n"
+        << "// Either side can write to the region at any time, so each side reads\n"
+        << "// a field written by the other only once.\n";
+    out << "enum : uint32_t { shm_ready = 0, shm_request = 1, shm_closed = 2 };\n\n";
+
+    out << "struct shm_header ";
+    out.block([&] {
+        out << "std::atomic<uint32_t> state;\n";
+        out << "std::atomic<uint32_t> code;\n";
+        out << "std::atomic<int32_t> status;\n";
+        out << "std::atomic<uint32_t> size;\n";
+    });
+    out << ";\n\n";
+
+    out << "static constexpr size_t kShmRegionSize = " << iface->sharedMemoryCallsSize()
+        << ";\n";
+    out << "static constexpr size_t kShmCapacity = kShmRegionSize - sizeof(shm_header);\n\n";
+
+    out << "// Iterations to busy-wait before sleeping on the futex, so that short\n"
+        << "// calls are served without entering the kernel.\n";
+    out << "static constexpr int kShmSpinCount = 4000;\n\n";
+
+    out << "// Each channel holds a mapping and a thread of the stub process, so a\n"
+        << "// client only gets a few; its other remote objects are called through\n"
+        << "// binder.\n";
+    out << "static constexpr size_t kShmMaxChannelsPerClient = 4;\n";
+    out << "static constexpr size_t kShmMaxChannels = 64;\n\n";
+
+    out << "static uint8_t* shm_payload(shm_header* header) ";
+    out.block([&] { out << "return reinterpret_cast<uint8_t*>(header + 1);\n"; }).endl().endl();
+
+    out << "static void shm_wake(shm_header* header) ";
+    out.block([&] {
+        out << "syscall(SYS_futex, reinterpret_cast<uint32_t*>(&header->state), FUTEX_WAKE, "
+            << "INT_MAX, nullptr, nullptr, 0);\n";
+    }).endl().endl();
+
+    out << "static void shm_close(shm_header* header) ";
+    out.block([&] {
+        out << "header->state.store(shm_closed, std::memory_order_release);\n";
+        out << "shm_wake(header);\n";
+    }).endl().endl();
+
+    out << "// Waits for the state to change from the given one, and returns the new one.\n";
+    out << "static uint32_t shm_wait(shm_header* header, uint32_t from) ";
+    out.block([&] {
+        out.sFor("int i = 0; i < kShmSpinCount; ++i", [&] {
+            out << "const uint32_t state = header->state.load(std::memory_order_acquire);\n";
+            out << "if (state != from) return state;\n";
+        }).endl();
+        out.sWhile("true", [&] {
+            out << "const uint32_t state = header->state.load(std::memory_order_acquire);\n";
+            out << "if (state != from) return state;\n";
+            out << "syscall(SYS_futex, reinterpret_cast<uint32_t*>(&header->state), FUTEX_WAIT, "
+                << "from, nullptr, nullptr, 0);\n";
+        }).endl();
+    }).endl().endl();
+
+    out << "// Moves the state on unless the channel was closed meanwhile.\n";
+    out << "static bool shm_move(shm_header* header, uint32_t from, uint32_t to) ";
+    out.block([&] {
+        out.sIf("!header->state.compare_exchange_strong(from, to, std::memory_order_acq_rel)",
+                [&] { out << "return false;\n"; }).endl();
+        out << "shm_wake(header);\n";
+        out << "return true;\n";
+    }).endl().endl();
+
+    out << "// Client side of a channel to a remote object. header is nullptr if the\n"
+        << "// stub did not take the region. Destroying the channel closes it, which\n"
+        << "// ends the stub thread serving it.\n";
+    out << "struct shm_client_channel : public ::android::hardware::IBinder::DeathRecipient ";
+    out.block([&] {
+        out << "std::mutex lock;\n";
+        out << "shm_header* header = nullptr;\n";
+        out << "// Lets the stub find out when this process goes away.\n";
+        out << "::android::sp<::android::hardware::IBinder> token = "
+            << "new ::android::hardware::BHwBinder();\n\n";
+        out << "~shm_client_channel() ";
+        out.block([&] {
+            out.sIf("header != nullptr", [&] {
+                out << "shm_close(header);\n";
+                out << "munmap(header, kShmRegionSize);\n";
+            }).endl();
+        }).endl();
+        out << "void binderDied(const ::android::wp<::android::hardware::IBinder>&) override ";
+        out.block([&] { out << "if (header != nullptr) shm_close(header);\n"; }).endl();
+    });
+    out << ";\n\n";
+
+    out << "static void setup_shm_channel(const ::android::sp<::android::hardware::IBinder>& "
+        << "binder,\n";
+    out << "        const ::android::sp<shm_client_channel>& channel) ";
+    out.block([&] {
+        out << "const int fd = ashmem_create_region(\"HIDL shared memory calls\", "
+            << "kShmRegionSize);\n";
+        out << "if (fd < 0) return;\n";
+        out << "void* region = mmap(nullptr, kShmRegionSize, PROT_READ | PROT_WRITE, "
+            << "MAP_SHARED, fd, 0);\n";
+        out.sIf("region == MAP_FAILED", [&] {
+            out << "close(fd);\n";
+            out << "return;\n";
+        }).endl().endl();
+
+        out << "native_handle_t* handle = native_handle_create(1 /* numFds */, "
+            << "0 /* numInts */);\n";
+        out << "handle->data[0] = fd;\n";
+        out << "::android::hardware::Parcel data;\n";
+        out << "::android::hardware::Parcel reply;\n";
+        out << "::android::hardware::Status status;\n";
+        out << "::android::status_t err = data.writeUint64(kShmRegionSize);\n";
+        out << "if (err == ::android::OK) err = data.writeNativeHandleNoDup(handle);\n";
+        out << "if (err == ::android::OK) err = data.writeStrongBinder(channel->token);\n";
+        out.sIf("err == ::android::OK", [&] {
+            out << "err = binder->transact(" << Interface::SHARED_MEMORY_SETUP_TRANSACTION->cppValue()
+                << ", data, &reply);\n";
+        }).endl();
+        out << "if (err == ::android::OK) err = ::android::hardware::readFromParcel(&status, "
+            << "reply);\n";
+        out << "if (err == ::android::OK && !status.isOk()) err = status.transactionError();\n";
+        out << "if (err == ::android::OK) err = binder->linkToDeath(channel);\n";
+        out << "native_handle_delete(handle);\n";
+        out << "close(fd);\n\n";
+
+        out << "// Stubs without @sharedMemoryCalls, or with no channel left for this\n"
+            << "// client, reject the region and are called through binder only.\n";
+        out.sIf("err != ::android::OK", [&] {
+            out << "munmap(region, kShmRegionSize);\n";
+            out << "return;\n";
+        }).endl();
+        out << "channel->header = static_cast<shm_header*>(region);\n";
+    }).endl().endl();
+
+    out << "// Identifies the channel among the objects attached to a remote object.\n";
+    out << "static const char kShmChannelObject = 0;\n\n";
+
+    out << "// The channel of a remote object is attached to its binder proxy, which\n"
+        << "// drops it once the last interface proxy of the object is released.\n";
+    out << "static ::android::sp<shm_client_channel> get_shm_channel(\n";
+    out << "        const ::android::sp<::android::hardware::IBinder>& binder) ";
+    out.block([&] {
+        out << "static std::mutex lock;\n";
+        out << "std::lock_guard<std::mutex> guard(lock);\n";
+        out << "void* attached = binder->findObject(&kShmChannelObject);\n";
+        out << "if (attached != nullptr) return static_cast<shm_client_channel*>(attached);\n\n";
+
+        out << "::android::sp<shm_client_channel> channel = new shm_client_channel();\n";
+        out << "setup_shm_channel(binder, channel);\n";
+        out << "channel->incStrong(&kShmChannelObject);\n";
+        out << "binder->attachObject(&kShmChannelObject, channel.get(), nullptr /* cleanupCookie */,\n";
+        out.indent(2, [&] {
+            out << "[](const void* id, void* object, void* /* cleanupCookie */) {\n";
+            out.indent([&] {
+                out << "static_cast<shm_client_channel*>(object)->decStrong(id);\n";
+            });
+            out << "});\n";
+        });
+        out << "return channel;\n";
+    }).endl().endl();
+
+    out << "// Makes a call through the shared memory region of the remote object, or\n"
+        << "// through binder when there is none or the call carries binder objects.\n";
+    out << "static ::android::status_t shm_transact(::android::hardware::IInterface* _hidl_this, "
+        << "uint32_t code,\n";
+    out << "        const ::android::hardware::Parcel& data, ::android::hardware::Parcel* reply) ";
+    out.block([&] {
+        out << "const ::android::sp<::android::hardware::IBinder> binder =\n";
+        out.indent(2, [&] { out << "::android::hardware::IInterface::asBinder(_hidl_this);\n"; });
+        out.sIf("data.objectsCount() == 0 && data.dataSize() <= kShmCapacity", [&] {
+            out << "const ::android::sp<shm_client_channel> channel = get_shm_channel(binder);\n";
+            out << "std::lock_guard<std::mutex> guard(channel->lock);\n";
+            out << "shm_header* header = channel->header;\n";
+            out.sIf("header != nullptr && "
+                    "header->state.load(std::memory_order_acquire) == shm_ready",
+                    [&] {
+                out << "header->code.store(code, std::memory_order_relaxed);\n";
+                out << "header->size.store(data.dataSize(), std::memory_order_relaxed);\n";
+                out << "memcpy(shm_payload(header), data.data(), data.dataSize());\n";
+                out.sIf("shm_move(header, shm_ready, shm_request)", [&] {
+                    out << "// The stub went away during the call.\n";
+                    out << "if (shm_wait(header, shm_request) != shm_ready) "
+                        << "return ::android::DEAD_OBJECT;\n";
+                    out << "const int32_t status = header->status.load(std::memory_order_relaxed);\n";
+                    out << "const uint32_t size = header->size.load(std::memory_order_relaxed);\n";
+                    out << "if (status != ::android::OK) return status;\n";
+                    out << "if (size > kShmCapacity) return ::android::BAD_VALUE;\n";
+                    out << "return reply->setData(shm_payload(header), size);\n";
+                }).endl();
+            }).endl();
+        }).endl();
+        out << "return binder->transact(code, data, reply);\n";
+    }).endl().endl();
+
+    out << "// Transaction codes of the calls which proxies make through the region.\n"
+        << "// Stub threads serving a region refuse any other code.\n";
+    out << "static bool shm_allowed_code(uint32_t code) ";
+    out.block([&] {
+        std::vector<const Method*> allowed;
+        for (const auto& tuple : iface->allMethodsFromRoot()) {
+            if (canCallOverSharedMemory(tuple.method())) allowed.push_back(tuple.method());
+        }
+        if (allowed.empty()) {
+            out << "(void)code;\n";
+            out << "return false;\n";
+            return;
+        }
+        out << "switch (code) {\n";
+        out.indent([&] {
+            for (const Method* method : allowed) {
+                out << "case " << method->getSerialId() << " /* " << method->name() << " */:\n";
+            }
+            out.indent([&] { out << "return true;\n"; });
+            out << "default:\n";
+            out.indent([&] { out << "return false;\n"; });
+        });
+        out << "}\n";
+    }).endl().endl();
+
+    out << "// Stub side of a channel. The region stays mapped until the client is\n"
+        << "// gone, since its death notification still writes to it.\n";
+    out << "struct shm_server_channel : public ::android::hardware::IBinder::DeathRecipient ";
+    out.block([&] {
+        out << "shm_header* header = nullptr;\n";
+        out << "size_t size = 0;\n";
+        out << "int64_t identity = 0;\n\n";
+        out << "~shm_server_channel() ";
+        out.block([&] { out << "if (header != nullptr) munmap(header, size);\n"; }).endl();
+        out << "void binderDied(const ::android::wp<::android::hardware::IBinder>&) override ";
+        out.block([&] { out << "shm_close(header);\n"; }).endl();
+    });
+    out << ";\n\n";
+
+    out << "// Channels served by this process, per client identity.\n";
+    out << "struct shm_server_count ";
+    out.block([&] {
+        out << "std::mutex lock;\n";
+        out << "std::map<int64_t, size_t> perClient;\n";
+        out << "size_t total = 0;\n";
+    });
+    out << ";\n\n";
+
+    out << "static shm_server_count& get_shm_server_count() ";
+    out.block([&] {
+        out << "static shm_server_count* count = new shm_server_count();\n";
+        out << "return *count;\n";
+    }).endl().endl();
+
+    out << "static bool reserve_shm_channel(int64_t identity) ";
+    out.block([&] {
+        out << "shm_server_count& count = get_shm_server_count();\n";
+        out << "std::lock_guard<std::mutex> guard(count.lock);\n";
+        out << "auto it = count.perClient.find(identity);\n";
+        out << "const size_t client = it == count.perClient.end() ? 0 : it->second;\n";
+        out.sIf("client >= kShmMaxChannelsPerClient || count.total >= kShmMaxChannels", [&] {
+            out << "return false;\n";
+        }).endl();
+        out << "count.perClient[identity] = client + 1;\n";
+        out << "++count.total;\n";
+        out << "return true;\n";
+    }).endl().endl();
+
+    out << "static void release_shm_channel(int64_t identity) ";
+    out.block([&] {
+        out << "shm_server_count& count = get_shm_server_count();\n";
+        out << "std::lock_guard<std::mutex> guard(count.lock);\n";
+        out << "if (--count.perClient[identity] == 0) count.perClient.erase(identity);\n";
+        out << "--count.total;\n";
+    }).endl().endl();
+
+    out << "// Runs the calls of a channel with the identity of the client which set it\n"
+        << "// up, through the same transaction handling as binder calls, until either\n"
+        << "// side closes it.\n";
+    out << "static void serve_shm_channel(const ::android::wp<::android::hardware::BHwBinder>& "
+        << "weakStub,\n";
+    out << "        const ::android::sp<shm_server_channel>& channel) ";
+    out.block([&] {
+        out << "pthread_setname_np(pthread_self(), \"HwShmChannel\");\n";
+        out << "::android::hardware::IPCThreadState::self()->restoreCallingIdentity("
+            << "channel->identity);\n";
+        out << "shm_header* header = channel->header;\n";
+        out << "const size_t capacity = channel->size - sizeof(shm_header);\n\n";
+        out.sWhile("shm_wait(header, shm_ready) == shm_request", [&] {
+            out << "const uint32_t code = header->code.load(std::memory_order_relaxed);\n";
+            out << "const uint32_t size = header->size.load(std::memory_order_relaxed);\n";
+            out << "// Only calls keep the stub alive, so that a released object goes away\n"
+                << "// even if its channel is still open.\n";
+            out << "const ::android::sp<::android::hardware::BHwBinder> stub = weakStub.promote();\n";
+            out.sIf("stub == nullptr", [&] {
+                out << "shm_close(header);\n";
+                out << "break;\n";
+            }).endl();
+            out << "::android::hardware::Parcel data;\n";
+            out << "::android::hardware::Parcel reply;\n";
+            out << "bool replied = false;\n";
+            out << "::android::status_t err = ::android::BAD_VALUE;\n";
+            out.sIf("shm_allowed_code(code) && size <= capacity", [&] {
+                out << "err = data.setData(shm_payload(header), size);\n";
+            }).endl();
+            out.sIf("err == ::android::OK", [&] {
+                out << "err = stub->transact(code, data, &reply, 0 /* flags */,\n";
+                out.indent(2, [&] {
+                    out << "[&](::android::hardware::Parcel& replyParcel) {\n";
+                    out.indent([&] {
+                        out << "replied = true;\n";
+                        out.sIf("replyParcel.objectsCount() != 0 || "
+                                "replyParcel.dataSize() > capacity",
+                                [&] {
+                                    out << "header->status.store(::android::FAILED_TRANSACTION, "
+                                        << "std::memory_order_relaxed);\n";
+                                    out << "return;\n";
+                                }).endl();
+                        out << "memcpy(shm_payload(header), replyParcel.data(), "
+                            << "replyParcel.dataSize());\n";
+                        out << "header->size.store(replyParcel.dataSize(), "
+                            << "std::memory_order_relaxed);\n";
+                        out << "header->status.store(::android::OK, std::memory_order_relaxed);\n";
+                    });
+                    out << "});\n";
+                });
+            }).endl();
+            out.sIf("!replied", [&] {
+                out << "header->status.store(err == ::android::OK ? ::android::UNKNOWN_ERROR : "
+                    << "err,\n";
+                out.indent(2, [&] { out << "std::memory_order_relaxed);\n"; });
+            }).endl();
+            out << "if (!shm_move(header, shm_request, shm_ready)) break;\n";
+        }).endl();
+        out << "release_shm_channel(channel->identity);\n";
+    }).endl().endl();
+
+    out << "static ::android::status_t accept_shm_channel(::android::hardware::BHwBinder* stub,\n";
+    out << "        const ::android::hardware::Parcel& data) ";
+    out.block([&] {
+        out << "uint64_t size;\n";
+        out << "const native_handle_t* handle = nullptr;\n";
+        out << "::android::sp<::android::hardware::IBinder> token;\n";
+        out << "::android::status_t err = data.readUint64(&size);\n";
+        out << "if (err == ::android::OK) err = data.readNativeHandleNoDup(&handle);\n";
+        out << "if (err == ::android::OK) err = data.readNullableStrongBinder(&token);\n";
+        out << "if (err != ::android::OK) return err;\n";
+        out.sIf("handle == nullptr || handle->numFds != 1 || token == nullptr ||\n"
+                "        size <= sizeof(shm_header) || size > kShmRegionSize ||\n"
+                "        ashmem_get_size_region(handle->data[0]) < static_cast<int>(size)",
+                [&] { out << "return ::android::BAD_VALUE;\n"; })
+            .endl().endl();
+
+        out << "::android::hardware::IPCThreadState* state = "
+            << "::android::hardware::IPCThreadState::self();\n";
+        out << "const int64_t identity =\n";
+        out.indent(2, [&] {
+            out << "(static_cast<int64_t>(state->getCallingUid()) << 32) | "
+                << "static_cast<uint32_t>(state->getCallingPid());\n";
+        });
+        out << "if (!reserve_shm_channel(identity)) return ::android::INVALID_OPERATION;\n\n";
+
+        out << "void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, "
+            << "handle->data[0], 0);\n";
+        out.sIf("region == MAP_FAILED", [&] {
+            out << "release_shm_channel(identity);\n";
+            out << "return ::android::NO_MEMORY;\n";
+        }).endl().endl();
+
+        out << "::android::sp<shm_server_channel> channel = new shm_server_channel();\n";
+        out << "channel->header = static_cast<shm_header*>(region);\n";
+        out << "channel->size = size;\n";
+        out << "channel->identity = identity;\n";
+        out << "err = token->linkToDeath(channel);\n";
+        out.sIf("err != ::android::OK", [&] {
+            out << "release_shm_channel(identity);\n";
+            out << "return err;\n";
+        }).endl().endl();
+
+        out << "::android::wp<::android::hardware::BHwBinder> weakStub = stub;\n";
+        out << "std::thread([weakStub, channel] { serve_shm_channel(weakStub, channel); }).detach();\n";
+        out << "return ::android::OK;\n";
+    }).endl().endl();
+}
+
+void AST::generateSharedMemorySetupStubSource(Formatter& out) const {
+    out << "case " << Interface::SHARED_MEMORY_SETUP_TRANSACTION->cppValue() << ":\n{\n";
+    out.indent([&] {
+        out << "bool _hidl_is_oneway = _hidl_flags & " << Interface::FLAG_ONE_WAY->cppValue()
+            << ";\n";
+        out << "if (_hidl_is_oneway != false) ";
+        out.block([&] { out << "return ::android::UNKNOWN_ERROR;\n"; }).endl().endl();
+
+        out << "_hidl_err = accept_shm_channel(this, _hidl_data);\n";
+        out << "if (_hidl_err != ::android::OK) { break; }\n\n";
+        out << "::android::hardware::writeToParcel(::android::hardware::Status::ok(), "
+            << "_hidl_reply);\n";
+        out << "_hidl_cb(*_hidl_reply);\n";
+        out << "break;\n";
+    });
+    out << "}\n\n";
+}
+
 void AST::generateCppAtraceCall(Formatter &out,
                                     InstrumentationEvent event,
                                     const Method *method) const {
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AST.h"
+
+#include "DocComment.h"
+#include "Interface.h"
+
+#include <android-base/logging.h>
+#include <hidl-util/Formatter.h>
+#include <string>
+#include <vector>
+
+namespace android {
+
+void AST::generateCppReplayHeader(Formatter& out) const {
+    const std::string klassName =
+        AST::isInterface() ? getInterface()->fqName().getInterfaceReplayName() : "Rtypes";
+    const std::string guard = makeHeaderGuard(klassName, true /* indicateGenerated */);
+
+    out << "#ifndef " << guard << "\n";
+    out << "#define " << guard << "\n\n";
+
+    if (AST::isInterface()) {
+        const Interface* iface = getInterface();
+
+        generateCppPackageInclude(out, mPackage, iface->localName());
+        out << "#include <hidl-gen-support/TransactionCapture.h>\n";
+        out << "#include <hwbinder/IBinder.h>\n\n";
+
+        enterLeaveNamespace(out, true /* enter */);
+        out.endl();
+
+        DocComment(
+            "Re-issues the transactions recorded by proxies and stubs generated with -T against "
+            "an implementation of " +
+            iface->localName() + ", passthrough or binderized.")
+            .emit(out);
+        out << "class " << klassName << " ";
+        out.block([&] {
+            out << "public:\n";
+            out << "explicit " << klassName << "(const ::android::sp<" << iface->localName()
+                << ">& impl);\n\n";
+
+            DocComment(
+                "Issues the calls to " + iface->localName() +
+                " and the interfaces it extends which were recorded on side of the "
+                "transaction in trace. Calls are spaced as recorded divided by speed, or issued "
+                "back to back if speed is 0. Returns BAD_VALUE if trace is malformed.")
+                .emit(out);
+            out << "::android::status_t replay(const std::vector<uint8_t>& trace, double speed,\n";
+            out.indent(2, [&] {
+                out << "::android::hardware::details::hidl_transaction_side side =\n";
+                out.indent(2, [&] {
+                    out << "::android::hardware::details::hidl_transaction_side::CLIENT);\n\n";
+                });
+            });
+
+            out << "// Calls which were issued, of which failed, and which couldn't be rebuilt.\n";
+            out << "size_t replayedCount() const { return mReplayed; }\n";
+            out << "size_t failedCount() const { return mFailed; }\n";
+            out << "size_t skippedCount() const { return mSkipped; }\n\n";
+
+            out << "private:\n";
+            out << "::android::sp<::android::hardware::IBinder> mBinder;\n";
+            out << "size_t mReplayed = 0;\n";
+            out << "size_t mFailed = 0;\n";
+            out << "size_t mSkipped = 0;\n";
+        }) << ";\n\n";
+
+        enterLeaveNamespace(out, false /* enter */);
+    } else {
+        out << "// no replay drivers for types.hal\n";
+    }
+
+    out << "#endif // " << guard << "\n";
+}
+
+void AST::generateCppReplaySource(Formatter& out) const {
+    const std::string klassName =
+        AST::isInterface() ? getInterface()->fqName().getInterfaceReplayName() : "Rtypes";
+
+    generateCppPackageInclude(out, mPackage, klassName);
+
+    if (!AST::isInterface()) {
+        out << "// no replay drivers for types.hal\n";
+        return;
+    }
+
+    const Interface* iface = getInterface();
+
+    out << "#include <hidl/HidlBinderSupport.h>\n";
+    out << "#include <algorithm>\n";
+    out << "#include <chrono>\n";
+    out << "#include <string>\n";
+    out << "#include <thread>\n\n";
+
+    enterLeaveNamespace(out, true /* enter */);
+    out.endl();
+
+    out << klassName << "::" << klassName << "(const ::android::sp<" << iface->localName()
+        << ">& impl)\n";
+    out.indent(2, [&] {
+        out << ": mBinder(::android::hardware::toBinder<" << iface->localName()
+            << ">(impl)) {}\n\n";
+    });
+
+    out << "::android::status_t " << klassName
+        << "::replay(const std::vector<uint8_t>& trace, double speed,\n";
+    out.indent(2, [&] {
+        out << "::android::hardware::details::hidl_transaction_side side) ";
+    });
+    out.block([&] {
+        out << "static const std::string kDescriptors[] = ";
+        out.block([&] {
+            for (const Interface* superType : iface->typeChain()) {
+                if (superType->isIBase()) {
+                    continue;
+                }
+                out << superType->fqName().cppName() << "::descriptor,\n";
+            }
+        }) << ";\n\n";
+
+        out << "const uint8_t* cursor = trace.data();\n";
+        out << "const uint8_t* end = cursor + trace.size();\n";
+        out << "bool started = false;\n";
+        out << "int64_t firstStartNs = 0;\n";
+        out << "std::chrono::steady_clock::time_point replayStart;\n\n";
+
+        out << "while (cursor != end) ";
+        out.block([&] {
+            out << "::android::hardware::details::hidl_transaction transaction;\n";
+            out.sIf("!::android::hardware::details::readHidlTransaction(\n"
+                    "        &cursor, end, &transaction)",
+                    [&] { out << "return ::android::BAD_VALUE;\n"; })
+                .endl();
+            out.sIf("transaction.side != side ||\n"
+                    "    std::find(std::begin(kDescriptors), std::end(kDescriptors),\n"
+                    "              transaction.descriptor) == std::end(kDescriptors)",
+                    [&] { out << "continue;\n"; })
+                .endl().endl();
+
+            out.sIf("!started", [&] {
+                out << "started = true;\n";
+                out << "firstStartNs = transaction.startNs;\n";
+                out << "replayStart = std::chrono::steady_clock::now();\n";
+            }).endl();
+            out.sIf("speed > 0", [&] {
+                out << "std::this_thread::sleep_until(replayStart + std::chrono::nanoseconds(\n";
+                out.indent(2, [&] {
+                    out << "static_cast<int64_t>((transaction.startNs - firstStartNs) / "
+                        << "speed)));\n";
+                });
+            }).endl().endl();
+
+            out << "::android::hardware::Parcel request;\n";
+            out << "::android::hardware::Parcel reply;\n";
+            out.sIf("::android::hardware::details::writeHidlRequest(&transaction, &request) !=\n"
+                    "        ::android::OK",
+                    [&] {
+                        out << "++mSkipped;\n";
+                        out << "continue;\n";
+                    })
+                .endl();
+            out << "++mReplayed;\n";
+            out << "const ::android::status_t err = mBinder->transact(\n";
+            out.indent(2, [&] {
+                out << "transaction.code, request, &reply, transaction.flags, [](auto&) {});\n";
+            });
+            out.sIf("err != ::android::OK", [&] { out << "++mFailed;\n"; }).endl();
+        }).endl();
+        out << "return ::android::OK;\n";
+    }).endl().endl();
+
+    enterLeaveNamespace(out, false /* enter */);
+}
+
+}  // namespace android
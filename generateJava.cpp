@@ -17,6 +17,7 @@
 #include "AST.h"
 
 #include "Coordinator.h"
+#include "CompoundType.h"
 #include "Interface.h"
 #include "Method.h"
 #include "Reference.h"
@@ -27,6 +28,24 @@
 
 namespace android {
 
+// Methods with several results also get a <method>Results holder class and an
+// overload filling it in, which the Proxy and Stub implement without
+// allocating a callback per call.
+static bool hasResultsHolder(const Method* method) {
+    return method->results().size() > 1 && !method->isHidlReserved();
+}
+
+static void emitJavaArgNames(Formatter& out, const Method* method) {
+    bool first = true;
+    for (const auto& arg : method->args()) {
+        if (!first) {
+            out << ", ";
+        }
+        out << arg->name();
+        first = false;
+    }
+}
+
 void AST::emitJavaReaderWriter(Formatter& out, const std::string& parcelObj,
                                const NamedReference<Type>* arg, bool isReader,
                                bool addPrefixToName) const {
@@ -198,6 +217,12 @@ void AST::generateJava(Formatter& out, const std::string& limitToType) const {
     out.unindent();
     out << "}\n\n";
 
+    out << "android.os.IHwBinder verified = Proxy.getVerified(binder);\n";
+    out << "if (verified != null) {\n";
+    out.indent();
+    out << "return new " << ifaceName << ".Proxy(verified);\n";
+    out.unindent();
+    out << "}\n\n";
     out << ifaceName << " proxy = new " << ifaceName << ".Proxy(binder);\n\n";
     out << "try {\n";
     out.indent();
@@ -205,6 +230,7 @@ void AST::generateJava(Formatter& out, const std::string& limitToType) const {
     out.indent();
     out << "if (descriptor.equals(kInterfaceName)) {\n";
     out.indent();
+    out << "Proxy.setVerified(binder);\n";
     out << "return proxy;\n";
     out.unindent();
     out << "}\n";
@@ -221,6 +247,25 @@ void AST::generateJava(Formatter& out, const std::string& limitToType) const {
     out.unindent();
     out << "}\n\n";
 
+    if (iface->isJavaTrustedDeclaredType()) {
+        DocComment(
+            "Converts a binder read as this type without checking its interface chain "
+            "(@javaTrustDeclaredType).")
+            .emit(out);
+        out << "public static " << ifaceName
+            << " asDeclaredInterface(android.os.IHwBinder binder) ";
+        out.block([&] {
+            out.sIf("binder == null", [&] { out << "return null;\n"; }).endl().endl();
+            out << "android.os.IHwInterface iface =\n";
+            out.indent(2, [&] { out << "binder.queryLocalInterface(kInterfaceName);\n\n"; });
+            out.sIf("(iface != null) && (iface instanceof " + ifaceName + ")",
+                    [&] { out << "return (" << ifaceName << ")iface;\n"; })
+                .endl()
+                .endl();
+            out << "return new " << ifaceName << ".Proxy(binder);\n";
+        }).endl().endl();
+    }
+
     DocComment("Does a checked conversion from any interface to this class.").emit(out);
     out << "public static "
         << ifaceName
@@ -285,6 +330,55 @@ void AST::generateJava(Formatter& out, const std::string& limitToType) const {
         out.indent();
         out << "throws android.os.RemoteException;\n";
         out.unindent();
+
+        if (!hasResultsHolder(method)) {
+            continue;
+        }
+
+        const std::string holderName = method->name() + "Results";
+
+        out << "\n";
+        DocComment("Results of " + method->name() + "(), may be reused across calls.\n" +
+                   "Also the callback storing the values it is called with.")
+                .emit(out);
+        out << "public static final class " << holderName << " implements " << method->name()
+            << "Callback ";
+        out.block([&] {
+            for (const auto& arg : method->results()) {
+                out << "public ";
+                arg->type().emitJavaFieldInitializer(out, arg->name());
+            }
+            out << "\n@Override\npublic void onValues(";
+            method->emitJavaResultSignature(out);
+            out << ") ";
+            out.block([&] {
+                for (const auto& arg : method->results()) {
+                    out << "this." << arg->name() << " = " << arg->name() << ";\n";
+                }
+            }).endl();
+        }).endl().endl();
+
+        out << "/**\n"
+            << " * Like " << method->name() << "(), but stores the results in _hidl_out\n"
+            << " * instead of calling back. Proxy and Stub use this overload, so\n"
+            << " * implementations overriding it need no callback object per call. By\n"
+            << " * default, _hidl_out itself is passed as the callback.\n"
+            << " */\n";
+        out << "default void " << method->name() << "(";
+        method->emitJavaArgSignature(out);
+        if (!method->args().empty()) {
+            out << ", ";
+        }
+        out << holderName << " _hidl_out)\n";
+        out.indent(2, [&] { out << "throws android.os.RemoteException "; });
+        out.block([&] {
+            out << method->name() << "(";
+            emitJavaArgNames(out, method);
+            if (!method->args().empty()) {
+                out << ", ";
+            }
+            out << "(" << method->name() << "Callback) _hidl_out);\n";
+        }).endl();
     }
 
     out << "\npublic static final class Proxy implements "
@@ -294,6 +388,62 @@ void AST::generateJava(Formatter& out, const std::string& limitToType) const {
     out.indent();
 
     out << "private android.os.IHwBinder mRemote;\n\n";
+
+    // Remote binders that asInterface already found to implement this
+    // interface, so that receiving the same binder again (e.g. a callback
+    // passed on every call) doesn't need another interfaceChain transaction.
+    // Every read of a binder returns a new, equal IHwBinder. The proxies of a
+    // cached binder all wrap the one in the cache, which so stays cached
+    // while any of them is in use and is linked to death only once. Keys and
+    // values are weak so that the cache never keeps a remote object alive,
+    // and entries are dropped when the remote process dies.
+    out << "private static final java.util.Map<android.os.IHwBinder,\n";
+    out.indent(2, [&] {
+        out << "java.lang.ref.WeakReference<android.os.IHwBinder>> sVerified =\n";
+        out.indent(2, [&] {
+            out << "java.util.Collections.synchronizedMap(new java.util.WeakHashMap<>());\n\n";
+        });
+    });
+
+    out << "private static final class VerifiedDeathRecipient\n";
+    out.indent(2, [&] { out << "implements android.os.IHwBinder.DeathRecipient "; });
+    out.block([&] {
+        out << "private final java.lang.ref.WeakReference<android.os.IHwBinder> mBinder;\n\n";
+        out << "VerifiedDeathRecipient(android.os.IHwBinder binder) ";
+        out.block([&] {
+            out << "mBinder = new java.lang.ref.WeakReference<>(binder);\n";
+        }).endl().endl();
+        out << "@Override\npublic void serviceDied(long cookie) ";
+        out.block([&] {
+            out << "android.os.IHwBinder binder = mBinder.get();\n";
+            out.sIf("binder != null", [&] { out << "sVerified.remove(binder);\n"; }).endl();
+        }).endl();
+    }).endl().endl();
+
+    out << "/* package private */ static android.os.IHwBinder getVerified("
+        << "android.os.IHwBinder binder) ";
+    out.block([&] {
+        out << "java.lang.ref.WeakReference<android.os.IHwBinder> verified = "
+            << "sVerified.get(binder);\n";
+        out << "return verified == null ? null : verified.get();\n";
+    }).endl().endl();
+
+    out << "/* package private */ static void setVerified(android.os.IHwBinder binder) ";
+    out.block([&] {
+        out << "synchronized (sVerified) ";
+        out.block([&] {
+            // Another thread may have cached an equal binder meanwhile.
+            out.sIf("getVerified(binder) != null", [&] { out << "return;\n"; }).endl();
+            // A binder which is already dead is not cached, asInterface keeps
+            // failing for it as before.
+            out.sIf("binder.linkToDeath(new VerifiedDeathRecipient(binder), 0 /* cookie */)",
+                    [&] {
+                        out << "sVerified.put(binder, new java.lang.ref.WeakReference<>(binder));\n";
+                    })
+                .endl();
+        }).endl();
+    }).endl().endl();
+
     out << "public Proxy(android.os.IHwBinder remote) {\n";
     out.indent();
     out << "mRemote = java.util.Objects.requireNonNull(remote);\n";
@@ -344,115 +494,195 @@ void AST::generateJava(Formatter& out, const std::string& limitToType) const {
         const bool returnsValue = !method->results().empty();
         const bool needsCallback = method->results().size() > 1;
 
-        out << "@Override\npublic ";
-        if (returnsValue && !needsCallback) {
-            out << method->results()[0]->type().getJavaType();
-        } else {
-            out << "void";
-        }
-
-        out << " "
-            << method->name()
-            << "(";
-        method->emitJavaArgSignature(out);
-
-        if (needsCallback) {
-            if (!method->args().empty()) {
-                out << ", ";
+        const auto emitProxyMethod = [&](bool intoHolder) {
+            out << "@Override\npublic ";
+            if (returnsValue && !needsCallback) {
+                out << method->results()[0]->type().getJavaType();
+            } else {
+                out << "void";
             }
 
-            out << method->name()
-                << "Callback _hidl_cb";
-        }
-
-        out << ")\n";
-        out.indent();
-        out.indent();
-        out << "throws android.os.RemoteException {\n";
-        out.unindent();
+            out << " "
+                << method->name()
+                << "(";
+            method->emitJavaArgSignature(out);
 
-        if (method->isHidlReserved() && method->overridesJavaImpl(IMPL_PROXY)) {
-            method->javaImpl(IMPL_PROXY, out);
-            out.unindent();
-            out << "}\n";
-            continue;
-        }
-        out << "android.os.HwParcel _hidl_request = new android.os.HwParcel();\n";
-        out << "_hidl_request.writeInterfaceToken("
-            << superInterface->fullJavaName()
-            << ".kInterfaceName);\n";
+            if (needsCallback) {
+                if (!method->args().empty()) {
+                    out << ", ";
+                }
 
-        for (const auto &arg : method->args()) {
-            emitJavaReaderWriter(
-                    out,
-                    "_hidl_request",
-                    arg,
-                    false /* isReader */,
-                    false /* addPrefixToName */);
-        }
+                out << method->name() << (intoHolder ? "Results _hidl_out" : "Callback _hidl_cb");
+            }
 
-        out << "\nandroid.os.HwParcel _hidl_reply = new android.os.HwParcel();\n";
+            out << ")\n";
+            out.indent();
+            out.indent();
+            out << "throws android.os.RemoteException {\n";
+            out.unindent();
 
-        out.sTry([&] {
-            out << "mRemote.transact("
-                << method->getSerialId()
-                << " /* "
-                << method->name()
-                << " */, _hidl_request, _hidl_reply, ";
+            if (method->isHidlReserved() && method->overridesJavaImpl(IMPL_PROXY)) {
+                method->javaImpl(IMPL_PROXY, out);
+                out.unindent();
+                out << "}\n";
+                return;
+            }
+            out << "android.os.HwParcel _hidl_request = new android.os.HwParcel();\n";
+            out << "_hidl_request.writeInterfaceToken("
+                << superInterface->fullJavaName()
+                << ".kInterfaceName);\n";
 
-            if (method->isOneway()) {
-                out << Interface::FLAG_ONE_WAY->javaValue();
-            } else {
-                out << "0 /* flags */";
+            for (const auto &arg : method->args()) {
+                emitJavaReaderWriter(
+                        out,
+                        "_hidl_request",
+                        arg,
+                        false /* isReader */,
+                        false /* addPrefixToName */);
             }
 
-            out << ");\n";
+            out << "\nandroid.os.HwParcel _hidl_reply = new android.os.HwParcel();\n";
 
-            if (!method->isOneway()) {
-                out << "_hidl_reply.verifySuccess();\n";
-            } else {
-                CHECK(!returnsValue);
-            }
+            out.sTry([&] {
+                out << "mRemote.transact("
+                    << method->getSerialId()
+                    << " /* "
+                    << method->name()
+                    << " */, _hidl_request, _hidl_reply, ";
 
-            out << "_hidl_request.releaseTemporaryStorage();\n";
+                if (method->isOneway()) {
+                    out << Interface::FLAG_ONE_WAY->javaValue();
+                } else {
+                    out << "0 /* flags */";
+                }
 
-            if (returnsValue) {
-                out << "\n";
-
-                for (const auto &arg : method->results()) {
-                    emitJavaReaderWriter(
-                            out,
-                            "_hidl_reply",
-                            arg,
-                            true /* isReader */,
-                            true /* addPrefixToName */);
+                out << ");\n";
+
+                if (!method->isOneway()) {
+                    out << "_hidl_reply.verifySuccess();\n";
+                } else {
+                    CHECK(!returnsValue);
                 }
 
-                if (needsCallback) {
-                    out << "_hidl_cb.onValues(";
+                out << "_hidl_request.releaseTemporaryStorage();\n";
+
+                if (returnsValue) {
+                    out << "\n";
 
-                    bool firstField = true;
                     for (const auto &arg : method->results()) {
-                        if (!firstField) {
-                            out << ", ";
+                        emitJavaReaderWriter(
+                                out,
+                                "_hidl_reply",
+                                arg,
+                                true /* isReader */,
+                                true /* addPrefixToName */);
+                    }
+
+                    if (intoHolder) {
+                        for (const auto& arg : method->results()) {
+                            out << "_hidl_out." << arg->name() << " = _hidl_out_" << arg->name()
+                                << ";\n";
                         }
+                    } else if (needsCallback) {
+                        out << "_hidl_cb.onValues(";
 
-                        out << "_hidl_out_" << arg->name();
-                        firstField = false;
-                    }
+                        bool firstField = true;
+                        for (const auto &arg : method->results()) {
+                            if (!firstField) {
+                                out << ", ";
+                            }
 
-                    out << ");\n";
-                } else {
-                    const std::string returnName = method->results()[0]->name();
-                    out << "return _hidl_out_" << returnName << ";\n";
+                            out << "_hidl_out_" << arg->name();
+                            firstField = false;
+                        }
+
+                        out << ");\n";
+                    } else {
+                        const std::string returnName = method->results()[0]->name();
+                        out << "return _hidl_out_" << returnName << ";\n";
+                    }
                 }
+            }).sFinally([&] {
+                out << "_hidl_reply.release();\n";
+            }).endl();
+
+            out.unindent();
+            out << "}\n\n";
+        };
+
+        emitProxyMethod(false /* intoHolder */);
+        if (hasResultsHolder(method)) {
+            emitProxyMethod(true /* intoHolder */);
+        }
+
+
+        if (method->isOneway() || method->results().size() != 1) {
+            continue;
+        }
+
+        const NamedReference<Type>* result = method->results()[0];
+        if (!result->type().isCompoundType() ||
+            !static_cast<const CompoundType&>(result->type()).hasJavaView()) {
+            continue;
+        }
+
+        bool viewNameTaken = false;
+        for (const auto& other : iface->allMethodsFromRoot()) {
+            viewNameTaken |= other.method()->name() == method->name() + "View";
+        }
+        if (viewNameTaken) {
+            continue;
+        }
+
+        out << "/**\n"
+            << " * Like " << method->name() << "(), but returns a view decoding the result\n"
+            << " * on access. The reply is kept until the view is released.\n"
+            << " */\n";
+        out << "public " << result->type().getJavaType() << ".View " << method->name()
+            << "View(";
+        method->emitJavaArgSignature(out);
+        out << ")\n";
+        out.indent(2, [&] {
+            out << "throws android.os.RemoteException ";
+        });
+        out.block([&] {
+            out << "android.os.HwParcel _hidl_request = new android.os.HwParcel();\n";
+            out << "_hidl_request.writeInterfaceToken("
+                << superInterface->fullJavaName()
+                << ".kInterfaceName);\n";
+
+            for (const auto &arg : method->args()) {
+                emitJavaReaderWriter(
+                        out,
+                        "_hidl_request",
+                        arg,
+                        false /* isReader */,
+                        false /* addPrefixToName */);
             }
-        }).sFinally([&] {
-            out << "_hidl_reply.release();\n";
-        }).endl();
 
-        out.unindent();
-        out << "}\n\n";
+            out << "\nandroid.os.HwParcel _hidl_reply = new android.os.HwParcel();\n"
+                << "boolean _hidl_keep_reply = false;\n";
+
+            out.sTry([&] {
+                out << "mRemote.transact("
+                    << method->getSerialId()
+                    << " /* "
+                    << method->name()
+                    << " */, _hidl_request, _hidl_reply, 0 /* flags */);\n"
+                    << "_hidl_reply.verifySuccess();\n"
+                    << "_hidl_request.releaseTemporaryStorage();\n\n";
+
+                out << result->type().getJavaType() << ".View _hidl_out_" << result->name()
+                    << " = " << result->type().getJavaType()
+                    << ".View.readFromParcel(_hidl_reply);\n"
+                    << "_hidl_keep_reply = true;\n"
+                    << "return _hidl_out_" << result->name() << ";\n";
+            }).sFinally([&] {
+                out.sIf("!_hidl_keep_reply", [&] {
+                    out << "_hidl_reply.release();\n";
+                }).endl();
+            }).endl();
+        }).endl().endl();
     }
 
     out.unindent();
@@ -588,6 +818,13 @@ void AST::generateJava(Formatter& out, const std::string& limitToType) const {
                 << " = ";
         }
 
+        if (hasResultsHolder(method)) {
+            // A new holder per call, since implementations may leave fields
+            // unset and calls on one thread may nest.
+            out << method->name() << "Results _hidl_out = new " << method->name()
+                << "Results();\n";
+        }
+
         out << method->name()
             << "(";
 
@@ -602,7 +839,13 @@ void AST::generateJava(Formatter& out, const std::string& limitToType) const {
             firstField = false;
         }
 
-        if (needsCallback) {
+        if (hasResultsHolder(method)) {
+            if (!firstField) {
+                out << ", ";
+            }
+
+            out << "_hidl_out";
+        } else if (needsCallback) {
             if (!firstField) {
                 out << ", ";
             }
@@ -654,6 +897,19 @@ void AST::generateJava(Formatter& out, const std::string& limitToType) const {
             out << "_hidl_reply.send();\n";
         }
 
+        if (hasResultsHolder(method)) {
+            out << "_hidl_reply.writeStatus(android.os.HwParcel.STATUS_SUCCESS);\n";
+
+            for (const auto& arg : method->results()) {
+                out << arg->type().getJavaType() << " _hidl_out_" << arg->name()
+                    << " = _hidl_out." << arg->name() << ";\n";
+                emitJavaReaderWriter(out, "_hidl_reply", arg, false /* isReader */,
+                                     true /* addPrefixToName */);
+            }
+
+            out << "_hidl_reply.send();\n";
+        }
+
         out << "break;\n";
         out.unindent();
         out << "}\n\n";
@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AST.h"
+
+#include <android-base/logging.h>
+#include <hidl-util/Formatter.h>
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Annotation.h"
+#include "ArrayType.h"
+#include "CompoundType.h"
+#include "Coordinator.h"
+#include "Interface.h"
+#include "Method.h"
+#include "VectorType.h"
+
+namespace android {
+
+namespace {
+
+// Checks run by -Lperf-lint, with their default severities. Severities can be
+// changed (or the check turned off) with -W <check>=<severity>, and a check
+// can be suppressed with @perfLintSuppress(checks={"<check>"}) on a method or
+// on the whole interface.
+struct PerfLintCheck {
+    const char* name;
+    const char* severity;
+};
+
+const PerfLintCheck kPerfLintChecks[] = {
+    {"oneway-unbounded", "warning"},
+    {"vec-embedded-buffers", "warning"},
+    {"transaction-size", "error"},
+    {"nested-vectors", "warning"},
+    {"many-results", "note"},
+};
+
+// Size of the buffer the binder driver maps for receiving transactions
+// (BINDER_VM_SIZE). Oneway transactions may only use half of it.
+constexpr size_t kBinderBufferSize = 1024 * 1024 - 2 * 4096;
+constexpr size_t kBinderAsyncBufferSize = kBinderBufferSize / 2;
+
+// Results are always returned through a callback once there are two of them,
+// but (status, value) pairs are too common to report.
+constexpr size_t kManyResults = 3;
+
+// What a single argument or result puts into a transaction.
+struct PayloadTraits {
+    // Contains a vec or a string, so its size is only known at runtime.
+    bool unbounded = false;
+    // Deepest nesting of vectors, 0 if there are none.
+    size_t vectorDepth = 0;
+    // A vector whose elements each need buffers of their own.
+    const Type* embeddedBufferVector = nullptr;
+};
+
+void collectPayloadTraits(const Type* type, size_t vectorDepth, PayloadTraits* traits) {
+    type = type->resolve();
+
+    if (type->isString()) {
+        traits->unbounded = true;
+        return;
+    }
+
+    if (type->isVector()) {
+        const Type* elementType = static_cast<const VectorType*>(type)->getElementType();
+        traits->unbounded = true;
+        traits->vectorDepth = std::max(traits->vectorDepth, vectorDepth + 1);
+        // Vectors of vectors are reported as nested-vectors instead.
+        if (traits->embeddedBufferVector == nullptr && !elementType->resolve()->isVector() &&
+            elementType->resolve()->needsEmbeddedReadWrite()) {
+            traits->embeddedBufferVector = type;
+        }
+        collectPayloadTraits(elementType, vectorDepth + 1, traits);
+        return;
+    }
+
+    if (type->isArray()) {
+        collectPayloadTraits(static_cast<const ArrayType*>(type)->getElementType(), vectorDepth,
+                             traits);
+        return;
+    }
+
+    if (type->isCompoundType()) {
+        for (const auto* field : static_cast<const CompoundType*>(type)->getFields()) {
+            collectPayloadTraits(field->get(), vectorDepth, traits);
+        }
+    }
+}
+
+// Bytes a list of arguments or results takes in a transaction at least: the
+// fixed-size part of each of them, without the contents of vectors and strings.
+size_t minimumPayloadSize(const std::vector<NamedReference<Type>*>& args) {
+    size_t size = 0;
+    for (const auto* arg : args) {
+        size_t align, argSize;
+        arg->get()->getAlignmentAndSize(&align, &argSize);
+        size += argSize;
+    }
+    return size;
+}
+
+bool isKnownPerfLintCheck(const std::string& name) {
+    return std::any_of(std::begin(kPerfLintChecks), std::end(kPerfLintChecks),
+                       [&](const PerfLintCheck& check) { return name == check.name; });
+}
+
+// Adds the checks named by @perfLintSuppress in annotations to *suppressed.
+status_t collectSuppressions(const std::vector<Annotation*>& annotations, const Location& location,
+                             std::set<std::string>* suppressed) {
+    for (const Annotation* annotation : annotations) {
+        if (annotation->name() != "perfLintSuppress") {
+            continue;
+        }
+
+        const AnnotationParam* checks = annotation->getParam("checks");
+        if (checks == nullptr || annotation->params().size() != 1) {
+            std::cerr << "ERROR: @perfLintSuppress takes checks={\"<check>\", ...} at " << location
+                      << std::endl;
+            return UNKNOWN_ERROR;
+        }
+
+        for (std::string value : checks->getValues()) {
+            if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+                value = value.substr(1, value.size() - 2);
+            }
+            if (!isKnownPerfLintCheck(value)) {
+                std::cerr << "ERROR: @perfLintSuppress names unknown check '" << value << "' at "
+                          << location << std::endl;
+                return UNKNOWN_ERROR;
+            }
+            suppressed->insert(value);
+        }
+    }
+    return OK;
+}
+
+}  // namespace
+
+// static
+bool AST::isPerfLintCheck(const std::string& name) {
+    return isKnownPerfLintCheck(name);
+}
+
+status_t AST::generatePerfLint(Formatter& out) const {
+    const Interface* iface = getInterface();
+    CHECK(iface != nullptr);
+
+    std::set<std::string> interfaceSuppressed;
+    status_t err = collectSuppressions(iface->annotations(), iface->location(), &interfaceSuppressed);
+    if (err != OK) return err;
+
+    bool failed = false;
+
+    for (const Method* method : iface->userDefinedMethods()) {
+        std::set<std::string> suppressed = interfaceSuppressed;
+        err = collectSuppressions(method->annotations(), method->location(), &suppressed);
+        if (err != OK) return err;
+
+        // One finding per line: severity, check, location, method and
+        // message, separated by tabs.
+        auto report = [&](const std::string& check, const std::string& message) {
+            if (suppressed.find(check) != suppressed.end()) return;
+
+            const auto* entry = std::find_if(
+                std::begin(kPerfLintChecks), std::end(kPerfLintChecks),
+                [&](const PerfLintCheck& c) { return check == c.name; });
+            CHECK(entry != std::end(kPerfLintChecks)) << check;
+
+            const std::string severity =
+                mCoordinator->getPerfLintSeverity(check, entry->severity);
+            if (severity == "off") return;
+            if (severity == "error") failed = true;
+
+            // The location of a method starts after the preceding one, so
+            // its end is the line the method is declared on.
+            const Position& end = method->location().end();
+            std::ostringstream location;
+            location << end.filename() << ":" << end.line();
+
+            out << severity << "\t" << check << "\t" << location.str() << "\t"
+                << iface->fqName().string() << "::" << method->name() << "\t" << message << "\n";
+        };
+
+        for (bool isResult : {false, true}) {
+            const auto& payload = isResult ? method->results() : method->args();
+            const char* kind = isResult ? "result" : "argument";
+
+            for (const auto* arg : payload) {
+                PayloadTraits traits;
+                collectPayloadTraits(arg->get(), 0 /* vectorDepth */, &traits);
+
+                if (method->isOneway() && traits.unbounded) {
+                    report("oneway-unbounded",
+                           "oneway " + std::string(kind) + " '" + arg->name() +
+                               "' has no size bound; oneway transactions share " +
+                               std::to_string(kBinderAsyncBufferSize) +
+                               " bytes of async buffer per process");
+                }
+
+                if (traits.embeddedBufferVector != nullptr) {
+                    report("vec-embedded-buffers",
+                           std::string(kind) + " '" + arg->name() + "' contains " +
+                               traits.embeddedBufferVector->typeName() +
+                               ", whose elements each need buffers of their own");
+                }
+
+                if (traits.vectorDepth >= 2) {
+                    report("nested-vectors", std::string(kind) + " '" + arg->name() +
+                                                 "' nests vectors " +
+                                                 std::to_string(traits.vectorDepth) +
+                                                 " deep, each row is a separate buffer");
+                }
+            }
+
+            const size_t limit = method->isOneway() ? kBinderAsyncBufferSize : kBinderBufferSize;
+            const size_t size = minimumPayloadSize(payload);
+            if (size > limit) {
+                report("transaction-size", std::string(isResult ? "results take" : "arguments take") +
+                                               " at least " + std::to_string(size) +
+                                               " bytes, over the binder limit of " +
+                                               std::to_string(limit));
+            }
+        }
+
+        if (method->results().size() >= kManyResults) {
+            report("many-results", std::to_string(method->results().size()) +
+                                       " results are returned through a synchronous callback");
+        }
+    }
+
+    return failed ? UNKNOWN_ERROR : OK;
+}
+
+}  // namespace android
@@ -52,6 +52,48 @@ void leaveScope(AST* ast, Scope** scope) {
     *scope = (*scope)->parent();
 }
 
+// Applies @bounded and @flatten, which replace fields of a struct with
+// generated nested structs, see CompoundType::boundFields and
+// CompoundType::flattenNestedVectorFields.
+bool applyFieldStorageAnnotations(AST* ast, Scope* type, std::string* errorMsg) {
+    std::vector<CompoundType*> generated;
+    bool flatten = false;
+
+    for (auto* annotation : type->annotations()) {
+        if (annotation->name() != "bounded" && annotation->name() != "flatten") {
+            continue;
+        }
+
+        if (!type->isCompoundType() ||
+            static_cast<CompoundType*>(type)->style() != CompoundType::STYLE_STRUCT) {
+            *errorMsg = "@" + annotation->name() + " can only be applied to structs";
+            return false;
+        }
+
+        if (annotation->name() == "flatten") {
+            flatten = true;
+        } else if (!static_cast<CompoundType*>(type)->boundFields(annotation, &generated,
+                                                                  errorMsg)) {
+            return false;
+        }
+    }
+
+    if (flatten) {
+        std::vector<CompoundType*> flattened =
+            static_cast<CompoundType*>(type)->flattenNestedVectorFields();
+        if (flattened.empty()) {
+            *errorMsg = "@flatten struct " + type->localName() + " has no vec<vec<T>> fields";
+            return false;
+        }
+        generated.insert(generated.end(), flattened.begin(), flattened.end());
+    }
+
+    for (CompoundType* compound : generated) {
+        ast->addScopedType(compound, type);
+    }
+    return true;
+}
+
 ::android::Location convertYYLoc(const yy::parser::location_type &loc) {
     return ::android::Location(
             ::android::Position(*(loc.begin.filename), loc.begin.line, loc.begin.column),
@@ -484,6 +526,7 @@ error_stmt
     {
       $$ = $1;
       ast->addSyntaxError();
+      if (ast->errorLimitReached()) YYABORT;
     }
   ;
 
@@ -548,6 +591,7 @@ package
       std::cerr << "ERROR: Package statement must be at the beginning of the file (" << @1 << ")\n";
       $$ = $1;
       ast->addSyntaxError();
+      if (ast->errorLimitReached()) YYABORT;
     }
     ;
 
@@ -594,7 +638,7 @@ interface_declarations
                     &errorMsg)) {
               std::cerr << "ERROR: " << errorMsg << " at "
                         << @2 << "\n";
-              YYERROR;
+              ast->addSyntaxError();
           }
       }
     | interface_declarations commentable_method_declaration
@@ -606,16 +650,14 @@ interface_declarations
               !isValidInterfaceField($2->name().c_str(), &errorMsg)) {
               std::cerr << "ERROR: " << errorMsg << " at "
                         << @2 << "\n";
-              YYERROR;
-          }
-
-          if ($2 != nullptr) {
+              ast->addSyntaxError();
+          } else if ($2 != nullptr) {
             Interface *iface = static_cast<Interface*>(*scope);
             if (!iface->addMethod($2)) {
                 std::cerr << "ERROR: Unable to add method '" << $2->name()
                           << "' at " << @2 << "\n";
 
-                YYERROR;
+                ast->addSyntaxError();
             }
           }
           // ignore if $2 is nullptr (from error recovery)
@@ -624,8 +666,8 @@ interface_declarations
 
 type_declarations
     : /* empty */
-    | error_stmt
     | type_declarations commentable_type_declaration
+    | type_declarations error_stmt
     ;
 
 commentable_type_declaration
@@ -643,6 +685,12 @@ type_declaration
           if (!$2->isTypeDef()) {
               CHECK($2->isScope());
               static_cast<Scope*>($2)->setAnnotations($1);
+
+              std::string errorMsg;
+              if (!applyFieldStorageAnnotations(ast, static_cast<Scope*>($2), &errorMsg)) {
+                  std::cerr << "ERROR: " << errorMsg << " at " << @2 << "\n";
+                  YYERROR;
+              }
           } else if (!$1->empty()) {
               // Since typedefs are always resolved to their target it makes
               // little sense to annotate them and have their annotations
@@ -795,6 +843,7 @@ const_expr
     | '(' error ')'
       {
         ast->addSyntaxError();
+        if (ast->errorLimitReached()) YYABORT;
         // to avoid segfaults
         $$ = ConstantExpression::Zero(ScalarType::KIND_INT32).release();
       }
@@ -988,6 +1037,12 @@ annotated_compound_declaration
       {
           CHECK($2->isScope());
           static_cast<Scope*>($2)->setAnnotations($1);
+
+          std::string errorMsg;
+          if (!applyFieldStorageAnnotations(ast, static_cast<Scope*>($2), &errorMsg)) {
+              std::cerr << "ERROR: " << errorMsg << " at " << @2 << "\n";
+              YYERROR;
+          }
           $$ = $2;
       }
     ;
@@ -1075,6 +1130,7 @@ enum_values
     | error ',' commentable_enum_value
       {
           ast->addSyntaxError();
+          if (ast->errorLimitReached()) YYABORT;
 
           CHECK((*scope)->isEnum());
           static_cast<EnumType *>(*scope)->addValue($3);
@@ -1082,6 +1138,7 @@ enum_values
     | enum_values ',' error ',' commentable_enum_value
       {
           ast->addSyntaxError();
+          if (ast->errorLimitReached()) YYABORT;
 
           CHECK((*scope)->isEnum());
           static_cast<EnumType *>(*scope)->addValue($5);
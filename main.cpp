@@ -25,8 +25,10 @@
 #include <hidl-util/Formatter.h>
 #include <hidl-util/StringHelper.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <algorithm>
 #include <iostream>
 #include <set>
 #include <string>
@@ -140,11 +142,12 @@ struct OutputHandler {
 
     status_t writeDepFile(const FQName& fqName, const Coordinator* coordinator) const;
 
+    status_t appendOutputFiles(const FQName& fqName, const Coordinator* coordinator,
+                               std::vector<std::string>* outputFiles) const;
+
    private:
     status_t appendTargets(const FQName& fqName, const Coordinator* coordinator,
                            std::vector<FQName>* targets) const;
-    status_t appendOutputFiles(const FQName& fqName, const Coordinator* coordinator,
-                               std::vector<std::string>* outputFiles) const;
 };
 
 // Helper method for GenerationGranularity::PER_TYPE
@@ -213,14 +216,21 @@ status_t OutputHandler::generate(const FQName& fqName, const Coordinator* coordi
     status_t err = appendTargets(fqName, coordinator, &targets);
     if (err != OK) return err;
 
+    bool failed = false;
     for (const FQName& fqName : targets) {
         for (const FileGenerator& file : mGenerateFunctions) {
+            const size_t errorsBefore = coordinator->errorCount();
             status_t err = file.generate(fqName, coordinator, mLocation);
-            if (err != OK) return err;
+            if (err == OK) continue;
+
+            // Other targets may have errors of their own to report.
+            if (!coordinator->continueAfterError(errorsBefore)) return err;
+            failed = true;
+            break;
         }
     }
 
-    return OK;
+    return failed ? UNKNOWN_ERROR : OK;
 }
 
 status_t OutputHandler::appendOutputFiles(const FQName& fqName, const Coordinator* coordinator,
@@ -852,6 +862,63 @@ FileGenerator::GenerationFunction generateExportHeaderForPackage(bool forJava) {
     };
 }
 
+// A header including every C++ header generated for a package, types first
+// and then interfaces in name order, so that it can be precompiled once for
+// all translation units using the package. The generated headers define no
+// macros besides their include guards, but the libhidl, libhwbinder, libutils
+// and liblog headers they include define theirs, as when the headers are
+// included one by one. This includes liblog's default LOG_TAG, so users have
+// to define LOG_TAG before including this header.
+static status_t generateCppPackageHeader(Formatter& out, const FQName& packageFQName,
+                                         const Coordinator* coordinator) {
+    CHECK(!packageFQName.package().empty() && !packageFQName.version().empty() &&
+          packageFQName.name().empty());
+
+    std::vector<FQName> packageInterfaces;
+    status_t err = coordinator->appendPackageInterfacesToVector(packageFQName, &packageInterfaces);
+    if (err != OK) return err;
+
+    for (const auto& fqName : packageInterfaces) {
+        if (coordinator->parse(fqName) == nullptr) {
+            fprintf(stderr, "ERROR: Could not parse %s. Aborting.\n", fqName.string().c_str());
+            return UNKNOWN_ERROR;
+        }
+    }
+
+    if (!out.isValid()) {
+        return UNKNOWN_ERROR;
+    }
+
+    // appendPackageInterfacesToVector sorts by name, which puts "types" after
+    // any interface.
+    std::stable_partition(packageInterfaces.begin(), packageInterfaces.end(),
+                          [](const FQName& fqName) { return fqName.name() == "types"; });
+
+    const std::string guard =
+        "HIDL_GENERATED_" + StringHelper::Uppercase(packageFQName.tokenName()) + "_PACKAGEALL_H";
+
+    out << "#ifndef " << guard << "\n";
+    out << "#define " << guard << "\n\n";
+
+    for (const auto& fqName : packageInterfaces) {
+        if (fqName.name() == "types") {
+            AST::generateCppPackageInclude(out, packageFQName, "types");
+            AST::generateCppPackageInclude(out, packageFQName, "hwtypes");
+            continue;
+        }
+
+        AST::generateCppPackageInclude(out, packageFQName, fqName.name());
+        AST::generateCppPackageInclude(out, packageFQName, fqName.getInterfaceHwName());
+        AST::generateCppPackageInclude(out, packageFQName, fqName.getInterfaceStubName());
+        AST::generateCppPackageInclude(out, packageFQName, fqName.getInterfaceProxyName());
+        AST::generateCppPackageInclude(out, packageFQName, fqName.getInterfacePassthroughName());
+    }
+
+    out << "\n#endif  // " << guard << "\n";
+
+    return OK;
+}
+
 static status_t generateHashOutput(Formatter& out, const FQName& fqName,
                                    const Coordinator* coordinator) {
     CHECK(fqName.isFullyQualified());
@@ -895,6 +962,19 @@ static status_t generateFunctionCount(Formatter& out, const FQName& fqName,
     return OK;
 }
 
+static status_t generatePerfLintOutput(Formatter& out, const FQName& fqName,
+                                       const Coordinator* coordinator) {
+    CHECK(fqName.isFullyQualified());
+
+    AST* ast = coordinator->parse(fqName);
+    if (ast == nullptr) {
+        fprintf(stderr, "ERROR: Could not parse %s. Aborting.\n", fqName.string().c_str());
+        return UNKNOWN_ERROR;
+    }
+
+    return ast->generatePerfLint(out);
+}
+
 template <typename T>
 std::vector<T> operator+(const std::vector<T>& lhs, const std::vector<T>& rhs) {
     std::vector<T> ret;
@@ -971,6 +1051,19 @@ static const std::vector<FileGenerator> kCppAdapterHeaderFormats = {
     },
 };
 
+static const std::vector<FileGenerator> kCppReplayFormats = {
+    {
+        FileGenerator::generateForInterfaces,
+        [](const FQName& fqName) { return fqName.getInterfaceReplayName() + ".h"; },
+        astGenerationFunction(&AST::generateCppReplayHeader),
+    },
+    {
+        FileGenerator::generateForInterfaces,
+        [](const FQName& fqName) { return fqName.getInterfaceReplayName() + ".cpp"; },
+        astGenerationFunction(&AST::generateCppReplaySource),
+    },
+};
+
 static const std::vector<FileGenerator> kCppAdapterSourceFormats = {
     {
         FileGenerator::alwaysGenerate,
@@ -1024,6 +1117,16 @@ static const std::vector<OutputHandler> kFormats = {
         validateForSource,
         kCppSourceFormats,
     },
+    {
+        "c++-package-header",
+        "(internal) Generates PackageAll.h, which includes all C++ headers of a package, for "
+        "use as a precompiled header.",
+        OutputMode::NEEDS_DIR,
+        Coordinator::Location::GEN_OUTPUT,
+        GenerationGranularity::PER_PACKAGE,
+        validateIsPackage,
+        {singleFileGenerator("PackageAll.h", generateCppPackageHeader)},
+    },
     {
         "export-header",
         "Generates a header file from @export enumerations to help maintain legacy code.",
@@ -1096,6 +1199,15 @@ static const std::vector<OutputHandler> kFormats = {
         validateIsPackage,
         {singleFileGenerator("main.cpp", generateAdapterMainSource)},
     },
+    {
+        "c++-replay",
+        "Generates drivers which replay transactions captured with -T against an implementation.",
+        OutputMode::NEEDS_DIR,
+        Coordinator::Location::GEN_OUTPUT,
+        GenerationGranularity::PER_FILE,
+        validateForSource,
+        kCppReplayFormats,
+    },
     {
         "java",
         "(internal) Generates Java library for talking to HIDL interfaces in Java.",
@@ -1199,6 +1311,22 @@ static const std::vector<OutputHandler> kFormats = {
             },
         }
     },
+    {
+        "perf-lint",
+        "Prints performance hazards in interface methods, one per line with tab-separated "
+        "severity, check, location, method and message. Fails on findings of severity error.",
+        OutputMode::NOT_NEEDED,
+        Coordinator::Location::STANDARD_OUT,
+        GenerationGranularity::PER_FILE,
+        validateForSource,
+        {
+            {
+                FileGenerator::generateForInterfaces,
+                nullptr /* file name for fqName */,
+                generatePerfLintOutput,
+            },
+        }
+    },
     {
         "dependencies",
         "Prints all depended types.",
@@ -1220,7 +1348,8 @@ static const std::vector<OutputHandler> kFormats = {
 static void usage(const char *me) {
     fprintf(stderr,
             "usage: %s [-p <root path>] -o <output path> -L <language> [-O <owner>] (-r <interface "
-            "root>)+ [-R] [-v] [-d <depfile>] FQNAME...\n\n",
+            "root>)+ [-R] [-v] [-d <depfile>] [-M <manifest>] [-E <count>] [-T] "
+            "[-W <check>=<severity>] FQNAME...\n\n",
             me);
 
     fprintf(stderr,
@@ -1238,6 +1367,20 @@ static void usage(const char *me) {
     fprintf(stderr, "         -r <package:path root>: E.g., android.hardware:hardware/interfaces.\n");
     fprintf(stderr, "         -v: verbose output.\n");
     fprintf(stderr, "         -d <depfile>: location of depfile to write to.\n");
+    fprintf(stderr, "         -M <manifest>: location of the list of generated files. When given,\n");
+    fprintf(stderr, "                        unchanged outputs are not rewritten and outputs from\n");
+    fprintf(stderr, "                        a previous run which are no longer generated are removed.\n");
+    fprintf(stderr, "         -E <count>: stop after <count> errors (default 20, 0 for no limit).\n");
+    fprintf(stderr, "                     Independent errors across files and packages are all\n");
+    fprintf(stderr, "                     reported up to this limit.\n");
+    fprintf(stderr, "         -T: C++ proxies and stubs report each transaction to the recorder\n");
+    fprintf(stderr, "             installed with setHidlTransactionRecorder from\n");
+    fprintf(stderr, "             libhidl-gen-support. Only affects -Lc++-sources.\n");
+    fprintf(stderr, "         -W <check>=<severity>: severity of a -Lperf-lint check, one of\n");
+    fprintf(stderr, "                                off, note, warning or error. Checks:\n");
+    fprintf(stderr, "                                oneway-unbounded, vec-embedded-buffers,\n");
+    fprintf(stderr, "                                transaction-size, nested-vectors,\n");
+    fprintf(stderr, "                                many-results.\n");
 }
 
 // hidl is intentionally leaky. Turn off LeakSanitizer by default.
@@ -1258,7 +1401,7 @@ int main(int argc, char **argv) {
     bool suppressDefaultPackagePaths = false;
 
     int res;
-    while ((res = getopt(argc, argv, "hp:o:O:r:L:vd:R")) >= 0) {
+    while ((res = getopt(argc, argv, "hp:o:O:r:L:vd:M:RE:TW:")) >= 0) {
         switch (res) {
             case 'p': {
                 if (!coordinator.getRootPath().empty()) {
@@ -1279,6 +1422,11 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 'M': {
+                coordinator.setOutputManifest(optarg);
+                break;
+            }
+
             case 'o': {
                 if (!outputPath.empty()) {
                     fprintf(stderr, "ERROR: -o <output path> can only be specified once.\n");
@@ -1323,6 +1471,42 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 'E': {
+                char* end;
+                unsigned long limit = strtoul(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0') {
+                    fprintf(stderr, "ERROR: -E option must be a number: %s\n", optarg);
+                    exit(1);
+                }
+                coordinator.setErrorLimit(limit);
+                break;
+            }
+
+            case 'T': {
+                coordinator.setTransactionCapture(true);
+                break;
+            }
+
+            case 'W': {
+                std::string val(optarg);
+                auto index = val.find('=');
+                std::string check = val.substr(0, index);
+                std::string severity = index == std::string::npos ? "" : val.substr(index + 1);
+                if (!AST::isPerfLintCheck(check)) {
+                    fprintf(stderr, "ERROR: -W names unknown check: %s\n", val.c_str());
+                    exit(1);
+                }
+                if (severity != "off" && severity != "note" && severity != "warning" &&
+                    severity != "error") {
+                    fprintf(stderr,
+                            "ERROR: -W severity must be off, note, warning or error: %s\n",
+                            val.c_str());
+                    exit(1);
+                }
+                coordinator.setPerfLintSeverity(check, severity);
+                break;
+            }
+
             case 'L': {
                 if (outputFormat != nullptr) {
                     fprintf(stderr,
@@ -1419,6 +1603,9 @@ int main(int argc, char **argv) {
         coordinator.addDefaultPackagePath("android.system", "system/hardware/interfaces");
     }
 
+    std::vector<std::string> outputFiles;
+    bool failed = false;
+
     for (int i = 0; i < argc; ++i) {
         const char* arg = argv[i];
 
@@ -1440,18 +1627,31 @@ int main(int argc, char **argv) {
             if (err != OK) return err;
         }
 
+        const size_t errorsBefore = coordinator.errorCount();
+
         if (!outputFormat->validate(fqName, &coordinator, outputFormat->name())) {
             fprintf(stderr,
                     "ERROR: output handler failed.\n");
-            exit(1);
+            if (!coordinator.continueAfterError(errorsBefore)) exit(1);
+            failed = true;
+            continue;
         }
 
         status_t err = outputFormat->generate(fqName, &coordinator);
-        if (err != OK) exit(1);
+        if (err == OK) err = outputFormat->writeDepFile(fqName, &coordinator);
+        if (err == OK) err = outputFormat->appendOutputFiles(fqName, &coordinator, &outputFiles);
 
-        err = outputFormat->writeDepFile(fqName, &coordinator);
-        if (err != OK) exit(1);
+        if (err != OK) {
+            // Keep going: the remaining packages may have errors of their own.
+            if (!coordinator.continueAfterError(errorsBefore)) exit(1);
+            failed = true;
+        }
     }
 
+    if (failed) exit(1);
+
+    status_t err = coordinator.commitOutputs(outputFiles);
+    if (err != OK) exit(1);
+
     return 0;
 }
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl-gen-support/TransactionCapture.h>
+
+#include <linux/android/binder.h>
+#include <utils/Timers.h>
+
+#include <atomic>
+#include <cstring>
+
+namespace android {
+namespace hardware {
+namespace details {
+
+static std::atomic<hidl_transaction_recorder> gRecorder{nullptr};
+
+void setHidlTransactionRecorder(hidl_transaction_recorder recorder) {
+    gRecorder.store(recorder);
+}
+
+int64_t hidlCaptureBegin() {
+    if (gRecorder.load(std::memory_order_relaxed) == nullptr) {
+        return -1;
+    }
+    return systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+void hidlCaptureEnd(const char* descriptor, uint32_t code, uint32_t flags,
+                    hidl_transaction_side side, int64_t startNs,
+                    const ::android::hardware::Parcel& data) {
+    if (startNs < 0) {
+        return;
+    }
+    hidl_transaction_recorder recorder = gRecorder.load();
+    if (recorder != nullptr) {
+        recorder(hidl_transaction_record{descriptor, code, flags, side, startNs,
+                                         systemTime(SYSTEM_TIME_MONOTONIC) - startNs, &data});
+    }
+}
+
+template <typename T>
+static void append(std::vector<uint8_t>* trace, const T& value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    trace->insert(trace->end(), bytes, bytes + sizeof(value));
+}
+
+bool appendHidlTransaction(const hidl_transaction_record& record, std::vector<uint8_t>* trace) {
+    const ::android::hardware::Parcel& data = *record.data;
+    const uint8_t* ipcData = reinterpret_cast<const uint8_t*>(data.ipcData());
+    const binder_size_t* objects = reinterpret_cast<const binder_size_t*>(data.ipcObjects());
+    const size_t objectCount = data.ipcObjectsCount();
+    // Objects are only 4-byte aligned in the data, so they are copied out
+    // before their fields are read.
+    for (size_t i = 0; i < objectCount; ++i) {
+        binder_object_header header;
+        memcpy(&header, ipcData + objects[i], sizeof(header));
+        if (header.type != BINDER_TYPE_PTR) {
+            return false;
+        }
+    }
+
+    append(trace, static_cast<uint8_t>(record.side));
+    append(trace, record.code);
+    append(trace, record.flags);
+    append(trace, record.startNs);
+    append(trace, record.durationNs);
+    const uint32_t descriptorSize = strlen(record.descriptor);
+    append(trace, descriptorSize);
+    trace->insert(trace->end(), record.descriptor, record.descriptor + descriptorSize);
+    append(trace, static_cast<uint32_t>(data.ipcDataSize()));
+    trace->insert(trace->end(), ipcData, ipcData + data.ipcDataSize());
+    append(trace, static_cast<uint32_t>(objectCount));
+    for (size_t i = 0; i < objectCount; ++i) {
+        binder_buffer_object buffer;
+        memcpy(&buffer, ipcData + objects[i], sizeof(buffer));
+        const bool hasParent = buffer.flags & BINDER_BUFFER_FLAG_HAS_PARENT;
+        append(trace, static_cast<uint32_t>(objects[i]));
+        append(trace, hasParent ? static_cast<uint32_t>(buffer.parent) : UINT32_MAX);
+        append(trace, hasParent ? static_cast<uint32_t>(buffer.parent_offset) : 0u);
+        append(trace, static_cast<uint32_t>(buffer.length));
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(buffer.buffer);
+        trace->insert(trace->end(), bytes, bytes + buffer.length);
+    }
+    return true;
+}
+
+template <typename T>
+static bool read(const uint8_t** cursor, const uint8_t* end, T* value) {
+    if (static_cast<size_t>(end - *cursor) < sizeof(T)) {
+        return false;
+    }
+    memcpy(value, *cursor, sizeof(T));
+    *cursor += sizeof(T);
+    return true;
+}
+
+template <typename Bytes>
+static bool readBytes(const uint8_t** cursor, const uint8_t* end, Bytes* bytes) {
+    uint32_t size;
+    if (!read(cursor, end, &size) || static_cast<size_t>(end - *cursor) < size) {
+        return false;
+    }
+    bytes->assign(*cursor, *cursor + size);
+    *cursor += size;
+    return true;
+}
+
+bool readHidlTransaction(const uint8_t** cursor, const uint8_t* end,
+                         hidl_transaction* transaction) {
+    uint8_t side;
+    uint32_t bufferCount;
+    if (!read(cursor, end, &side) || side > static_cast<uint8_t>(hidl_transaction_side::SERVER) ||
+        !read(cursor, end, &transaction->code) || !read(cursor, end, &transaction->flags) ||
+        !read(cursor, end, &transaction->startNs) || !read(cursor, end, &transaction->durationNs) ||
+        !readBytes(cursor, end, &transaction->descriptor) ||
+        !readBytes(cursor, end, &transaction->data) || !read(cursor, end, &bufferCount)) {
+        return false;
+    }
+    transaction->side = static_cast<hidl_transaction_side>(side);
+
+    // Each buffer takes at least its four u32 fields, which bounds the
+    // count before anything is allocated for it.
+    if (bufferCount > static_cast<size_t>(end - *cursor) / (4 * sizeof(uint32_t))) {
+        return false;
+    }
+    transaction->buffers.resize(bufferCount);
+    for (hidl_transaction::buffer& buffer : transaction->buffers) {
+        if (!read(cursor, end, &buffer.objectOffset) || !read(cursor, end, &buffer.parent) ||
+            !read(cursor, end, &buffer.parentOffset) || !readBytes(cursor, end, &buffer.bytes)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+::android::status_t writeHidlRequest(hidl_transaction* transaction,
+                                     ::android::hardware::Parcel* request) {
+    const std::vector<uint8_t>& data = transaction->data;
+    std::vector<hidl_transaction::buffer>& buffers = transaction->buffers;
+    size_t position = 0;
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        hidl_transaction::buffer& buffer = buffers[i];
+        if (buffer.objectOffset < position ||
+            buffer.objectOffset + sizeof(binder_buffer_object) > data.size()) {
+            return ::android::BAD_VALUE;
+        }
+        ::android::status_t err =
+                request->write(data.data() + position, buffer.objectOffset - position);
+        if (err != ::android::OK) {
+            return err;
+        }
+
+        size_t handle;
+        if (buffer.parent == UINT32_MAX) {
+            err = request->writeBuffer(buffer.bytes.data(), buffer.bytes.size(), &handle);
+        } else {
+            if (buffer.parent >= i ||
+                buffer.parentOffset + sizeof(uint64_t) > buffers[buffer.parent].bytes.size()) {
+                return ::android::BAD_VALUE;
+            }
+            const uint64_t address = reinterpret_cast<uintptr_t>(buffer.bytes.data());
+            memcpy(buffers[buffer.parent].bytes.data() + buffer.parentOffset, &address,
+                   sizeof(address));
+            err = request->writeEmbeddedBuffer(buffer.bytes.data(), buffer.bytes.size(), &handle,
+                                               buffer.parent, buffer.parentOffset);
+        }
+        if (err != ::android::OK) {
+            return err;
+        }
+        if (handle != i) {
+            return ::android::BAD_VALUE;
+        }
+        position = buffer.objectOffset + sizeof(binder_buffer_object);
+    }
+    return request->write(data.data() + position, data.size() - position);
+}
+
+}  // namespace details
+}  // namespace hardware
+}  // namespace android
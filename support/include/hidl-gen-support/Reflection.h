@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HIDL_GEN_SUPPORT_REFLECTION_H_
+
+#define ANDROID_HIDL_GEN_SUPPORT_REFLECTION_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Declarations of the reflection tables which hidl-gen emits into the
+// headers of generated types.
+
+namespace android {
+namespace hardware {
+namespace details {
+
+enum class hidl_field_kind : uint8_t {
+    SCALAR,
+    ENUM,
+    STRING,
+    VECTOR,
+    ARRAY,
+    STRUCT,
+    UNION,
+    SAFE_UNION,
+    HANDLE,
+    MEMORY,
+    POINTER,
+    OTHER,
+};
+
+// A field of a struct or union as laid out by hidl-gen. For a safe_union,
+// offset is relative to the start of the safe_union. For a STRUCT, UNION or
+// SAFE_UNION field, fields points to hidl_fields<T> of its type; it is null
+// for other kinds and for types which have no table.
+struct hidl_field_descriptor {
+    const char* name;
+    size_t offset;
+    size_t size;
+    hidl_field_kind kind;
+    const hidl_field_descriptor* fields;
+    size_t fieldCount;
+};
+
+template <typename T>
+constexpr std::array<hidl_field_descriptor, 0> hidl_fields{};
+
+template <typename T>
+struct hidl_field_visitor;
+
+// In the same order as hidl_enum_values<T>.
+template <typename T>
+constexpr std::array<const char*, 0> hidl_enum_names{};
+
+}  // namespace details
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HIDL_GEN_SUPPORT_REFLECTION_H_
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HIDL_GEN_SUPPORT_TRANSACTION_CAPTURE_H_
+
+#define ANDROID_HIDL_GEN_SUPPORT_TRANSACTION_CAPTURE_H_
+
+#include <hwbinder/Parcel.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Recorder hooks called by proxies and stubs generated with hidl-gen -T,
+// and the trace format read by the -Lc++-replay drivers. The recorder is
+// process-wide, so it is kept by this library rather than by the generated
+// code of each package.
+
+namespace android {
+namespace hardware {
+namespace details {
+
+enum class hidl_transaction_side : uint8_t {
+    CLIENT,
+    SERVER,
+};
+
+// A transaction seen by a proxy (CLIENT) or a stub (SERVER). data is the
+// request as marshalled by the proxy and is only valid during the call to
+// the recorder.
+struct hidl_transaction_record {
+    const char* descriptor;
+    uint32_t code;
+    uint32_t flags;
+    hidl_transaction_side side;
+    int64_t startNs;
+    int64_t durationNs;
+    const ::android::hardware::Parcel* data;
+};
+
+using hidl_transaction_recorder = void (*)(const hidl_transaction_record&);
+
+// Installs the recorder called after each captured transaction of this
+// process, or removes it when recorder is nullptr.
+void setHidlTransactionRecorder(hidl_transaction_recorder recorder);
+
+// Returns the start time of a transaction to capture, or -1 if none is
+// recorded.
+int64_t hidlCaptureBegin();
+
+void hidlCaptureEnd(const char* descriptor, uint32_t code, uint32_t flags,
+                    hidl_transaction_side side, int64_t startNs,
+                    const ::android::hardware::Parcel& data);
+
+// Appends record to trace. Integers are in host byte order: side (u8),
+// code, flags (u32), startNs, durationNs (i64), the descriptor and the
+// request data (each a u32 size then the bytes), then the count (u32) of
+// the buffers of the request. Each buffer is the offset of its object in
+// the data, the index of its parent buffer or UINT32_MAX, its offset in the
+// parent, and its size (u32) and bytes. Returns false, leaving trace
+// unchanged, if the request holds binders or file descriptors, which can't
+// be replayed.
+bool appendHidlTransaction(const hidl_transaction_record& record, std::vector<uint8_t>* trace);
+
+// A transaction read back from a trace.
+struct hidl_transaction {
+    struct buffer {
+        uint32_t objectOffset;
+        uint32_t parent;
+        uint32_t parentOffset;
+        std::vector<uint8_t> bytes;
+    };
+
+    hidl_transaction_side side;
+    uint32_t code;
+    uint32_t flags;
+    int64_t startNs;
+    int64_t durationNs;
+    std::string descriptor;
+    std::vector<uint8_t> data;
+    std::vector<buffer> buffers;
+};
+
+// Reads the transaction at *cursor and moves *cursor past it. Returns false
+// if the trace is malformed.
+bool readHidlTransaction(const uint8_t** cursor, const uint8_t* end,
+                         hidl_transaction* transaction);
+
+// Rebuilds the request of transaction, pointing its buffers at each other
+// as the binder driver does when it copies them.
+::android::status_t writeHidlRequest(hidl_transaction* transaction,
+                                     ::android::hardware::Parcel* request);
+
+}  // namespace details
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HIDL_GEN_SUPPORT_TRANSACTION_CAPTURE_H_
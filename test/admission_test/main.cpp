@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl/tests/admission_test/1.0/BnHwThrottled.h>
+#include <hidl/tests/admission_test/1.0/IThrottled.h>
+
+#include <android-base/logging.h>
+#include <gtest/gtest.h>
+#include <hidl/HidlTransportSupport.h>
+#include <signal.h>
+#include <unistd.h>
+
+using ::android::sp;
+using ::android::hardware::configureRpcThreadpool;
+using ::android::hardware::joinRpcThreadpool;
+using ::android::hardware::Return;
+using ::android::hardware::Void;
+using ::hidl::tests::admission_test::V1_0::BnHwThrottled;
+using ::hidl::tests::admission_test::V1_0::IThrottled;
+
+// Serial IDs of the methods of IThrottled. limited is annotated with
+// @rateLimit(callsPerSecond=1, burst=2).
+static constexpr uint32_t kLimited = 1;
+static constexpr uint32_t kUnlimited = 2;
+
+struct Throttled : public IThrottled {
+    Return<void> limited() override { return Void(); }
+    Return<void> unlimited() override { return Void(); }
+    Return<void> grouped() override { return Void(); }
+};
+
+TEST(AdmissionTest, DefaultPolicyLimitsEachCaller) {
+    EXPECT_TRUE(BnHwThrottled::defaultAdmissionPolicy(kLimited, 100, 0));
+    EXPECT_TRUE(BnHwThrottled::defaultAdmissionPolicy(kLimited, 100, 0));
+    EXPECT_FALSE(BnHwThrottled::defaultAdmissionPolicy(kLimited, 100, 0));
+
+    EXPECT_TRUE(BnHwThrottled::defaultAdmissionPolicy(kLimited, 101, 0));
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(BnHwThrottled::defaultAdmissionPolicy(kUnlimited, 100, 0));
+    }
+}
+
+TEST(AdmissionTest, ManyCallersKeepTheirLimits) {
+    // Drain one caller, then track far more callers than the point at which
+    // the policy starts sweeping refilled buckets. None of them refills
+    // within the test, so none may be forgotten.
+    constexpr pid_t kDrained = 200;
+    constexpr pid_t kFirstCaller = 1000;
+    constexpr pid_t kCallers = 20000;
+    EXPECT_TRUE(BnHwThrottled::defaultAdmissionPolicy(kLimited, kDrained, 0));
+    EXPECT_TRUE(BnHwThrottled::defaultAdmissionPolicy(kLimited, kDrained, 0));
+    for (pid_t pid = kFirstCaller; pid < kFirstCaller + kCallers; ++pid) {
+        EXPECT_TRUE(BnHwThrottled::defaultAdmissionPolicy(kLimited, pid, 0));
+        EXPECT_TRUE(BnHwThrottled::defaultAdmissionPolicy(kLimited, pid, 0));
+    }
+
+    EXPECT_FALSE(BnHwThrottled::defaultAdmissionPolicy(kLimited, kDrained, 0));
+    for (pid_t pid = kFirstCaller; pid < kFirstCaller + kCallers; ++pid) {
+        EXPECT_FALSE(BnHwThrottled::defaultAdmissionPolicy(kLimited, pid, 0)) << pid;
+    }
+}
+
+TEST(AdmissionTest, RejectedCallsFailTheTransaction) {
+    sp<IThrottled> throttled = IThrottled::getService();
+    ASSERT_NE(nullptr, throttled.get());
+    ASSERT_TRUE(throttled->isRemote());
+
+    EXPECT_TRUE(throttled->limited().isOk());
+    EXPECT_TRUE(throttled->limited().isOk());
+    EXPECT_FALSE(throttled->limited().isOk());
+    EXPECT_TRUE(throttled->unlimited().isOk());
+}
+
+TEST(AdmissionTest, GroupedCallsAreAdmittedOneByOne) {
+    sp<IThrottled> throttled = IThrottled::getService();
+    ASSERT_NE(nullptr, throttled.get());
+    ASSERT_TRUE(throttled->isRemote());
+
+    // grouped has the same limit as limited, and a bucket of its own.
+    IThrottled::CallGroup group(throttled);
+    group.grouped();
+    group.grouped();
+    group.grouped();
+    group.unlimited();
+    EXPECT_FALSE(group.execute().isOk());
+    EXPECT_TRUE(group.getStatus(0).isOk());
+    EXPECT_TRUE(group.getStatus(1).isOk());
+    EXPECT_FALSE(group.getStatus(2).isOk());
+    EXPECT_FALSE(group.getStatus(3).isOk());
+}
+
+int main(int argc, char** argv) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        configureRpcThreadpool(1, true /* callerWillJoin */);
+        sp<IThrottled> throttled = new Throttled();
+        CHECK_EQ(::android::OK, throttled->registerAsService());
+        joinRpcThreadpool();
+        return 1;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+    int status = RUN_ALL_TESTS();
+    kill(pid, SIGTERM);
+    return status;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl/tests/bounded_test/1.0/types.h>
+
+#include <gtest/gtest.h>
+
+using ::android::hardware::hidl_string;
+using ::android::hardware::hidl_vec;
+using ::hidl::tests::bounded_test::V1_0::Point;
+using ::hidl::tests::bounded_test::V1_0::Shape;
+
+TEST(BoundedTest, VectorRoundTrips) {
+    Shape shape = {};
+    const hidl_vec<Point> points = {{1, 2}, {3, 4}, {5, 6}};
+
+    ASSERT_TRUE(shape.points.assign(points));
+    EXPECT_EQ(3u, shape.points.size);
+    EXPECT_EQ(points, shape.points.get());
+}
+
+TEST(BoundedTest, VectorOverCapacityIsRejected) {
+    Shape shape = {};
+    ASSERT_TRUE(shape.points.assign({{1, 2}}));
+
+    EXPECT_FALSE(shape.points.assign({{1, 1}, {2, 2}, {3, 3}, {4, 4}, {5, 5}}));
+    EXPECT_EQ(1u, shape.points.size);
+    EXPECT_EQ(1, shape.points.get()[0].x);
+}
+
+TEST(BoundedTest, StringRoundTrips) {
+    Shape shape = {};
+
+    ASSERT_TRUE(shape.name.assign("square"));
+    EXPECT_EQ(hidl_string("square"), shape.name.get());
+    EXPECT_FALSE(shape.name.assign("rectangle"));
+    EXPECT_EQ(hidl_string("square"), shape.name.get());
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl/tests/broadcast_test/1.0/IListener.h>
+
+#include <android-base/logging.h>
+#include <gtest/gtest.h>
+#include <hidl/HidlTransportSupport.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using ::android::DEAD_OBJECT;
+using ::android::OK;
+using ::android::sp;
+using ::android::status_t;
+using ::android::hardware::configureRpcThreadpool;
+using ::android::hardware::hidl_string;
+using ::android::hardware::hidl_vec;
+using ::android::hardware::joinRpcThreadpool;
+using ::android::hardware::Return;
+using ::android::hardware::Void;
+using ::hidl::tests::broadcast_test::V1_0::IListener;
+
+struct Listener : public IListener {
+    Return<void> onEvent(int32_t value, const hidl_string& tag) override {
+        std::lock_guard<std::mutex> guard(mLock);
+        mEvents.push_back(std::string(tag) + " " + std::to_string(value));
+        return Void();
+    }
+    Return<void> takeEvents(takeEvents_cb _hidl_cb) override {
+        std::vector<hidl_string> events;
+        {
+            std::lock_guard<std::mutex> guard(mLock);
+            events.assign(mEvents.begin(), mEvents.end());
+            mEvents.clear();
+        }
+        _hidl_cb(events);
+        return Void();
+    }
+
+  private:
+    std::mutex mLock;
+    std::vector<std::string> mEvents;
+};
+
+// Oneway calls may still be on their way when a two-way call returns, so the
+// events are collected until there are at least count of them, or a second
+// has passed.
+static std::vector<std::string> takeEvents(const sp<IListener>& listener, size_t count) {
+    std::vector<std::string> events;
+    for (int i = 0; i < 100; ++i) {
+        if (i > 0) {
+            if (events.size() >= count) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        Return<void> ret = listener->takeEvents([&](const hidl_vec<hidl_string>& taken) {
+            for (const auto& event : taken) events.push_back(event);
+        });
+        EXPECT_TRUE(ret.isOk()) << ret.description();
+    }
+    return events;
+}
+
+// Serves the instance which the test kills. Servers are forked before the
+// test process uses binder.
+static pid_t gDoomed;
+
+static pid_t serve(const std::vector<std::string>& instances) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        configureRpcThreadpool(1, true /* callerWillJoin */);
+        std::vector<sp<IListener>> listeners;
+        for (const auto& instance : instances) {
+            listeners.push_back(new Listener());
+            CHECK_EQ(OK, listeners.back()->registerAsService(instance));
+        }
+        joinRpcThreadpool();
+        exit(1);
+    }
+    return pid;
+}
+
+static sp<IListener> getRemote(const std::string& instance) {
+    sp<IListener> listener = IListener::getService(instance);
+    CHECK(listener != nullptr) << instance;
+    CHECK(listener->isRemote()) << instance;
+    return listener;
+}
+
+TEST(BroadcastTest, ReachesLiveTargetsAndDropsDeadOnes) {
+    sp<IListener> dead = getRemote("doomed");
+    ASSERT_EQ(0, kill(gDoomed, SIGKILL));
+    ASSERT_EQ(gDoomed, waitpid(gDoomed, nullptr, 0));
+    gDoomed = 0;
+
+    sp<IListener> local = new Listener();
+    sp<IListener> first = getRemote("first");
+    sp<IListener> second = getRemote("second");
+    std::vector<sp<IListener>> targets = {first, dead, local, nullptr, second};
+
+    std::vector<status_t> statuses = IListener::broadcast_onEvent(&targets, 7, "seven");
+    EXPECT_EQ(std::vector<status_t>({OK, DEAD_OBJECT, OK, DEAD_OBJECT, OK}), statuses);
+    EXPECT_EQ(std::vector<sp<IListener>>({first, local, second}), targets);
+
+    EXPECT_EQ(std::vector<std::string>({"seven 7"}), takeEvents(local, 1));
+    EXPECT_EQ(std::vector<std::string>({"seven 7"}), takeEvents(first, 1));
+    EXPECT_EQ(std::vector<std::string>({"seven 7"}), takeEvents(second, 1));
+
+    // The targets left are all live.
+    statuses = IListener::broadcast_onEvent(&targets, 8, "eight");
+    EXPECT_EQ(std::vector<status_t>({OK, OK, OK}), statuses);
+    EXPECT_EQ(3u, targets.size());
+    EXPECT_EQ(std::vector<std::string>({"eight 8"}), takeEvents(first, 1));
+}
+
+TEST(BroadcastTest, EmptyTargets) {
+    std::vector<sp<IListener>> targets;
+    EXPECT_TRUE(IListener::broadcast_onEvent(&targets, 1, "one").empty());
+    EXPECT_TRUE(targets.empty());
+}
+
+int main(int argc, char** argv) {
+    pid_t pid = serve({"first", "second"});
+    gDoomed = serve({"doomed"});
+
+    ::testing::InitGoogleTest(&argc, argv);
+    int status = RUN_ALL_TESTS();
+    kill(pid, SIGTERM);
+    if (gDoomed != 0) kill(gDoomed, SIGTERM);
+    return status;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl/tests/call_group_test/1.0/BnHwCalculator.h>
+#include <hidl/tests/call_group_test/1.0/ICalculator.h>
+
+#include <android-base/logging.h>
+#include <gtest/gtest.h>
+#include <hidl/HidlTransportSupport.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+using ::android::sp;
+using ::android::hardware::configureRpcThreadpool;
+using ::android::hardware::hidl_string;
+using ::android::hardware::joinRpcThreadpool;
+using ::android::hardware::Return;
+using ::android::hardware::Status;
+using ::android::hardware::Void;
+using ::hidl::tests::call_group_test::V1_0::BnHwCalculator;
+using ::hidl::tests::call_group_test::V1_0::ICalculator;
+
+// Serial ID of ICalculator::fail.
+static constexpr uint32_t kFail = 3;
+
+struct Calculator : public ICalculator {
+    Return<int32_t> add(int32_t a, int32_t b) override { return a + b; }
+    Return<void> split(const hidl_string& text, uint32_t at, split_cb _hidl_cb) override {
+        std::string whole = text;
+        _hidl_cb(whole.substr(0, at), whole.substr(at));
+        return Void();
+    }
+    Return<int32_t> fail() override {
+        return Status::fromExceptionCode(Status::EX_ILLEGAL_STATE, "fail() was called");
+    }
+};
+
+static sp<ICalculator> getRemote() {
+    sp<ICalculator> calculator = ICalculator::getService();
+    CHECK(calculator != nullptr);
+    CHECK(calculator->isRemote());
+    return calculator;
+}
+
+// Queues add(1, 2), split("head|tail", 5), fail(), add(3, 4), recording the
+// results passed to the callbacks in *results.
+static void queueCalls(ICalculator::CallGroup* group, std::vector<std::string>* results) {
+    group->add(1, 2, [results](int32_t sum) { results->push_back(std::to_string(sum)); });
+    group->split("head|tail", 5, [results](const hidl_string& head, const hidl_string& tail) {
+        results->push_back(std::string(head) + "/" + std::string(tail));
+    });
+    group->fail([results](int32_t value) { results->push_back(std::to_string(value)); });
+    group->add(3, 4, [results](int32_t sum) { results->push_back(std::to_string(sum)); });
+}
+
+TEST(CallGroupTest, RemoteCallsRunInOrder) {
+    ICalculator::CallGroup group(getRemote());
+    std::vector<std::string> results;
+    group.add(1, 2, [&](int32_t sum) { results.push_back(std::to_string(sum)); });
+    group.split("ab", 1, [&](const hidl_string& head, const hidl_string& tail) {
+        results.push_back(std::string(head) + "/" + std::string(tail));
+    });
+    group.add(3, 4, [&](int32_t sum) { results.push_back(std::to_string(sum)); });
+
+    Return<void> ret = group.execute();
+    ASSERT_TRUE(ret.isOk()) << ret.description();
+    EXPECT_EQ(std::vector<std::string>({"3", "a/b", "7"}), results);
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_TRUE(group.getStatus(i).isOk()) << i;
+    }
+}
+
+TEST(CallGroupTest, RemoteGroupStopsAtFailingCall) {
+    ICalculator::CallGroup group(getRemote());
+    std::vector<std::string> results;
+    queueCalls(&group, &results);
+
+    Return<void> ret = group.execute();
+    EXPECT_FALSE(ret.isOk());
+    EXPECT_EQ(std::vector<std::string>({"3", "head|/tail"}), results);
+    EXPECT_TRUE(group.getStatus(0).isOk());
+    EXPECT_TRUE(group.getStatus(1).isOk());
+    EXPECT_EQ(::android::WOULD_BLOCK, group.getStatus(2).transactionError());
+    EXPECT_EQ(Status::EX_TRANSACTION_FAILED, group.getStatus(3).exceptionCode());
+
+    // The group is empty again, and can be reused.
+    results.clear();
+    group.add(5, 6, [&](int32_t sum) { results.push_back(std::to_string(sum)); });
+    ret = group.execute();
+    ASSERT_TRUE(ret.isOk()) << ret.description();
+    EXPECT_EQ(std::vector<std::string>({"11"}), results);
+}
+
+TEST(CallGroupTest, LocalGroupStopsAtFailingCall) {
+    ICalculator::CallGroup group(new Calculator());
+    std::vector<std::string> results;
+    queueCalls(&group, &results);
+
+    Return<void> ret = group.execute();
+    EXPECT_FALSE(ret.isOk());
+    EXPECT_EQ(std::vector<std::string>({"3", "head|/tail"}), results);
+    EXPECT_TRUE(group.getStatus(0).isOk());
+    EXPECT_TRUE(group.getStatus(1).isOk());
+    EXPECT_FALSE(group.getStatus(2).isOk());
+    EXPECT_FALSE(group.getStatus(3).isOk());
+}
+
+int main(int argc, char** argv) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        BnHwCalculator::setAdmissionPolicy(
+                [](uint32_t code, pid_t, uid_t) { return code != kFail; });
+        configureRpcThreadpool(1, true /* callerWillJoin */);
+        sp<ICalculator> calculator = new Calculator();
+        CHECK_EQ(::android::OK, calculator->registerAsService());
+        joinRpcThreadpool();
+        return 1;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+    int status = RUN_ALL_TESTS();
+    kill(pid, SIGTERM);
+    return status;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl/tests/callback_executor_test/1.0/BnHwCoalescing.h>
+#include <hidl/tests/callback_executor_test/1.0/BnHwDropping.h>
+#include <hidl/tests/callback_executor_test/1.0/ICoalescing.h>
+#include <hidl/tests/callback_executor_test/1.0/IDropping.h>
+
+#include <gtest/gtest.h>
+#include <hwbinder/Parcel.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+using ::android::sp;
+using ::android::hardware::BHwBinder;
+using ::android::hardware::Parcel;
+using ::android::hardware::Return;
+using ::android::hardware::Void;
+using ::hidl::tests::callback_executor_test::V1_0::BnHwCoalescing;
+using ::hidl::tests::callback_executor_test::V1_0::BnHwDropping;
+using ::hidl::tests::callback_executor_test::V1_0::ICoalescing;
+using ::hidl::tests::callback_executor_test::V1_0::IDropping;
+
+// Serial IDs of the methods of IDropping and ICoalescing.
+static constexpr uint32_t kHold = 1;
+static constexpr uint32_t kEvent = 2;
+static constexpr uint32_t kFirst = 2;
+static constexpr uint32_t kSecond = 3;
+
+// Keeps the worker thread of a queue in hold() until opened.
+struct Gate {
+    std::mutex lock;
+    std::condition_variable changed;
+    bool entered = false;
+    bool open = false;
+
+    void pass() {
+        std::unique_lock<std::mutex> guard(lock);
+        entered = true;
+        changed.notify_all();
+        changed.wait(guard, [this] { return open; });
+    }
+
+    void waitEntered() {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [this] { return entered; });
+    }
+
+    void letThrough() {
+        std::lock_guard<std::mutex> guard(lock);
+        open = true;
+        changed.notify_all();
+    }
+};
+
+// Values an object received, in the order its calls were run.
+struct Received {
+    std::mutex lock;
+    std::vector<int32_t> values;
+
+    void add(int32_t value) {
+        std::lock_guard<std::mutex> guard(lock);
+        values.push_back(value);
+    }
+
+    std::vector<int32_t> get() {
+        std::lock_guard<std::mutex> guard(lock);
+        return values;
+    }
+};
+
+struct Dropping : public IDropping, public Received {
+    explicit Dropping(Gate* gate) : mGate(gate) {}
+    Return<void> hold() override {
+        mGate->pass();
+        return Void();
+    }
+    Return<void> event(int32_t value) override {
+        add(value);
+        return Void();
+    }
+    Gate* mGate;
+};
+
+struct Coalescing : public ICoalescing, public Received {
+    explicit Coalescing(Gate* gate) : mGate(gate) {}
+    Return<void> hold() override {
+        mGate->pass();
+        return Void();
+    }
+    Return<void> first(int32_t value) override {
+        add(value);
+        return Void();
+    }
+    Return<void> second(int32_t value) override {
+        add(value);
+        return Void();
+    }
+    Gate* mGate;
+};
+
+// Makes a oneway call straight to a stub, so that the calls reach its queue
+// in the order they are made here.
+static void call(const sp<BHwBinder>& stub, const char* descriptor, uint32_t code,
+                 const std::vector<int32_t>& args = {}) {
+    Parcel data;
+    Parcel reply;
+    ASSERT_EQ(::android::OK, data.writeInterfaceToken(descriptor));
+    for (int32_t arg : args) {
+        ASSERT_EQ(::android::OK, data.writeInt32(arg));
+    }
+    ASSERT_EQ(::android::OK, stub->transact(code, data, &reply, 1 /* oneway */, [](Parcel&) {}));
+}
+
+// Queues hold() of a new object behind the calls made so far, and waits for
+// it to run, so that they have all been run.
+template <typename Impl, typename Stub>
+static void drain(const char* descriptor) {
+    Gate gate;
+    gate.letThrough();
+    sp<Impl> impl = new Impl(&gate);
+    call(new Stub(impl), descriptor, kHold);
+    gate.waitEntered();
+}
+
+TEST(CallbackExecutorTest, DroppingKeepsTheCallsOfOtherObjects) {
+    Gate gate;
+    sp<Dropping> a = new Dropping(&gate);
+    sp<Dropping> b = new Dropping(&gate);
+    sp<BHwBinder> stubA = new BnHwDropping(a);
+    sp<BHwBinder> stubB = new BnHwDropping(b);
+
+    call(stubB, IDropping::descriptor, kHold);
+    gate.waitEntered();
+
+    call(stubB, IDropping::descriptor, kEvent, {10});
+    call(stubA, IDropping::descriptor, kEvent, {1});
+    call(stubA, IDropping::descriptor, kEvent, {2});
+    call(stubA, IDropping::descriptor, kEvent, {3});
+    gate.letThrough();
+    drain<Dropping, BnHwDropping>(IDropping::descriptor);
+
+    EXPECT_EQ(std::vector<int32_t>({2, 3}), a->get());
+    EXPECT_EQ(std::vector<int32_t>({10}), b->get());
+}
+
+TEST(CallbackExecutorTest, CoalescingMatchesObjectAndMethod) {
+    Gate gate;
+    sp<Coalescing> a = new Coalescing(&gate);
+    sp<Coalescing> b = new Coalescing(&gate);
+    sp<BHwBinder> stubA = new BnHwCoalescing(a);
+    sp<BHwBinder> stubB = new BnHwCoalescing(b);
+
+    call(stubB, ICoalescing::descriptor, kHold);
+    gate.waitEntered();
+
+    call(stubB, ICoalescing::descriptor, kFirst, {10});
+    call(stubA, ICoalescing::descriptor, kFirst, {1});
+    call(stubA, ICoalescing::descriptor, kFirst, {2});
+    // Replaces 2, the newest queued first() of a.
+    call(stubA, ICoalescing::descriptor, kFirst, {3});
+    // No second() of a is queued, so this drops 1, the oldest call of a.
+    call(stubA, ICoalescing::descriptor, kSecond, {4});
+    call(stubB, ICoalescing::descriptor, kSecond, {11});
+    gate.letThrough();
+    drain<Coalescing, BnHwCoalescing>(ICoalescing::descriptor);
+
+    EXPECT_EQ(std::vector<int32_t>({3, 4}), a->get());
+    EXPECT_EQ(std::vector<int32_t>({10, 11}), b->get());
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl/tests/callback_threads_test/1.0/IPool.h>
+
+#include <android-base/logging.h>
+#include <gtest/gtest.h>
+#include <hidl/HidlTransportSupport.h>
+#include <hwbinder/ProcessState.h>
+#include <signal.h>
+#include <unistd.h>
+
+using ::android::sp;
+using ::android::hardware::configureRpcThreadpool;
+using ::android::hardware::joinRpcThreadpool;
+using ::android::hardware::ProcessState;
+using ::android::hardware::Return;
+using ::hidl::tests::callback_threads_test::V1_0::IPool;
+
+// From @callbackThreads(count=8) in IPool.hal.
+static constexpr size_t kCallbackThreads = 8;
+
+struct Pool : public IPool {
+    Return<int32_t> call(const sp<IPool>& callback, int32_t value) override {
+        if (callback == nullptr) {
+            return value + 1;
+        }
+        return 2 * static_cast<int32_t>(callback->call(nullptr, value));
+    }
+};
+
+TEST(CallbackThreadsTest, ProxyLeavesThreadpoolSizeToOwner) {
+    sp<IPool> pool = IPool::getService();
+    ASSERT_NE(nullptr, pool.get());
+    ASSERT_TRUE(pool->isRemote());
+
+    size_t maxThreads = ProcessState::self()->getMaxThreads();
+    ASSERT_LT(maxThreads, kCallbackThreads);
+
+    // Sending a callback starts the threadpool, which then serves the call
+    // back, but doesn't resize it.
+    EXPECT_EQ(12, static_cast<int32_t>(pool->call(new Pool(), 5)));
+    EXPECT_EQ(maxThreads, ProcessState::self()->getMaxThreads());
+}
+
+TEST(CallbackThreadsTest, ConfigureRaisesThreadpoolMaximum) {
+    EXPECT_EQ(::android::OK, IPool::configureCallbackThreadpool());
+    EXPECT_EQ(kCallbackThreads, ProcessState::self()->getMaxThreads());
+
+    // A larger maximum set by the process owner is kept.
+    ASSERT_EQ(::android::OK,
+              ProcessState::self()->setThreadPoolConfiguration(2 * kCallbackThreads, false));
+    EXPECT_EQ(::android::OK, IPool::configureCallbackThreadpool());
+    EXPECT_EQ(2 * kCallbackThreads, ProcessState::self()->getMaxThreads());
+}
+
+int main(int argc, char** argv) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        configureRpcThreadpool(1, true /* callerWillJoin */);
+        sp<IPool> pool = new Pool();
+        CHECK_EQ(::android::OK, pool->registerAsService());
+        joinRpcThreadpool();
+        return 1;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+    int status = RUN_ALL_TESTS();
+    kill(pid, SIGTERM);
+    return status;
+}
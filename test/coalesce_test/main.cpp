@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl/tests/coalesce_test/1.0/ISensor.h>
+
+#include <android-base/logging.h>
+#include <gtest/gtest.h>
+#include <hidl/HidlTransportSupport.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using ::android::sp;
+using ::android::hardware::configureRpcThreadpool;
+using ::android::hardware::hidl_string;
+using ::android::hardware::hidl_vec;
+using ::android::hardware::joinRpcThreadpool;
+using ::android::hardware::Return;
+using ::android::hardware::Void;
+using ::hidl::tests::coalesce_test::V1_0::ISensor;
+
+struct Sensor : public ISensor {
+    Return<void> setLevel(int32_t level) override {
+        record("level " + std::to_string(level));
+        return Void();
+    }
+    Return<void> setName(int32_t id, const hidl_string& name) override {
+        record("name " + std::to_string(id) + " " + std::string(name));
+        return Void();
+    }
+    Return<void> poke(int32_t value) override {
+        record("poke " + std::to_string(value));
+        return Void();
+    }
+    Return<void> takeEvents(takeEvents_cb _hidl_cb) override {
+        std::vector<hidl_string> events;
+        {
+            std::lock_guard<std::mutex> guard(mLock);
+            events.assign(mEvents.begin(), mEvents.end());
+            mEvents.clear();
+        }
+        _hidl_cb(events);
+        return Void();
+    }
+
+  private:
+    void record(std::string event) {
+        std::lock_guard<std::mutex> guard(mLock);
+        mEvents.push_back(std::move(event));
+    }
+
+    std::mutex mLock;
+    std::vector<std::string> mEvents;
+};
+
+// Oneway calls may still be on their way when a two-way call returns, so the
+// events are collected until there are at least count of them, or a second
+// has passed.
+static std::vector<std::string> takeEvents(const sp<ISensor>& sensor, size_t count) {
+    std::vector<std::string> events;
+    for (int i = 0; i < 100; ++i) {
+        if (i > 0) {
+            if (events.size() >= count) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        Return<void> ret = sensor->takeEvents([&](const hidl_vec<hidl_string>& taken) {
+            for (const auto& event : taken) events.push_back(event);
+        });
+        EXPECT_TRUE(ret.isOk()) << ret.description();
+    }
+    return events;
+}
+
+static sp<ISensor> getSensor() {
+    sp<ISensor> sensor = ISensor::getService();
+    CHECK(sensor != nullptr);
+    CHECK(sensor->isRemote());
+    takeEvents(sensor, 0);
+    return sensor;
+}
+
+TEST(CoalesceTest, RepeatedCallsAreCoalesced) {
+    sp<ISensor> sensor = getSensor();
+    EXPECT_TRUE(sensor->setLevel(1).isOk());
+    EXPECT_TRUE(sensor->setLevel(2).isOk());
+    EXPECT_TRUE(sensor->setLevel(3).isOk());
+
+    // Wait for the worker to send the call, rather than having takeEvents
+    // flush it.
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(std::vector<std::string>({"level 3"}), takeEvents(sensor, 1));
+    EXPECT_TRUE(takeEvents(sensor, 0).empty());
+}
+
+TEST(CoalesceTest, OtherCallsKeepTheirOrder) {
+    sp<ISensor> sensor = getSensor();
+
+    // A waiting call is sent before any other call of the proxy.
+    EXPECT_TRUE(sensor->setLevel(1).isOk());
+    EXPECT_TRUE(sensor->poke(1).isOk());
+    EXPECT_TRUE(sensor->setLevel(2).isOk());
+    EXPECT_TRUE(sensor->poke(2).isOk());
+    EXPECT_EQ(std::vector<std::string>({"level 1", "poke 1", "level 2", "poke 2"}),
+              takeEvents(sensor, 4));
+}
+
+TEST(CoalesceTest, KeysTellCallsApart) {
+    sp<ISensor> sensor = getSensor();
+
+    // The replacement goes after the calls made since the one it replaces.
+    EXPECT_TRUE(sensor->setName(1, "a").isOk());
+    EXPECT_TRUE(sensor->setName(2, "b").isOk());
+    EXPECT_TRUE(sensor->setLevel(7).isOk());
+    EXPECT_TRUE(sensor->setName(1, "c").isOk());
+    EXPECT_EQ(std::vector<std::string>({"name 2 b", "level 7", "name 1 c"}),
+              takeEvents(sensor, 3));
+}
+
+int main(int argc, char** argv) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        configureRpcThreadpool(1, true /* callerWillJoin */);
+        sp<ISensor> sensor = new Sensor();
+        CHECK_EQ(::android::OK, sensor->registerAsService());
+        joinRpcThreadpool();
+        return 1;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+    int status = RUN_ALL_TESTS();
+    kill(pid, SIGTERM);
+    return status;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl/tests/delta_test/1.0/IGauge.h>
+
+#include <android-base/logging.h>
+#include <gtest/gtest.h>
+#include <hidl/HidlTransportSupport.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using ::android::sp;
+using ::android::hardware::configureRpcThreadpool;
+using ::android::hardware::hidl_memory;
+using ::android::hardware::joinRpcThreadpool;
+using ::android::hardware::Return;
+using ::android::hardware::Void;
+using ::hidl::tests::delta_test::V1_0::IGauge;
+
+struct Gauge : public IGauge {
+    Return<void> setLevel(const Level& level, setLevel_cb _hidl_cb) override {
+        _hidl_cb(level);
+        return Void();
+    }
+    Return<void> setScratch(const hidl_memory&) override { return Void(); }
+};
+
+static IGauge::Level makeLevel(int32_t low, int32_t high, const std::string& name) {
+    IGauge::Level level;
+    level.low = low;
+    level.high = high;
+    level.name = name;
+    return level;
+}
+
+// Sets level through gauge and checks that the stub saw all of it.
+static void expectSeen(const sp<IGauge>& gauge, const IGauge::Level& level) {
+    IGauge::Level seen;
+    Return<void> ret = gauge->setLevel(level, [&](const IGauge::Level& l) { seen = l; });
+    ASSERT_TRUE(ret.isOk()) << ret.description();
+    EXPECT_EQ(level, seen);
+}
+
+static sp<IGauge> getGauge() {
+    sp<IGauge> gauge = IGauge::getService();
+    CHECK(gauge != nullptr);
+    CHECK(gauge->isRemote());
+    return gauge;
+}
+
+TEST(DeltaTest, PartialUpdatesRebuildTheWholeLevel) {
+    sp<IGauge> gauge = getGauge();
+    expectSeen(gauge, makeLevel(1, 2, "first"));
+    expectSeen(gauge, makeLevel(1, 3, "first"));
+    expectSeen(gauge, makeLevel(4, 3, "second"));
+    expectSeen(gauge, makeLevel(4, 3, "second"));
+}
+
+TEST(DeltaTest, ConcurrentCallsSendTheWholeLevel) {
+    // Calls made while another call of the same proxy sends changes go
+    // on stream 0 with every field.
+    sp<IGauge> gauge = getGauge();
+    expectSeen(gauge, makeLevel(0, 0, "start"));
+
+    std::vector<std::thread> threads;
+    for (int32_t i = 1; i <= 8; ++i) {
+        threads.emplace_back([gauge, i] {
+            for (int32_t j = 0; j < 50; ++j) {
+                expectSeen(gauge, makeLevel(i, j, "thread " + std::to_string(i)));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    expectSeen(gauge, makeLevel(0, 1, "start"));
+}
+
+TEST(DeltaTest, DroppedLevelsAreSentAgain) {
+    // The stub only keeps the levels of so many proxies, so the first ones
+    // are dropped before they change again.
+    constexpr int32_t kProxies = 100;
+    std::vector<sp<IGauge>> gauges;
+    for (int32_t i = 0; i < kProxies; ++i) {
+        gauges.push_back(getGauge());
+        expectSeen(gauges.back(), makeLevel(i, 0, "gauge " + std::to_string(i)));
+    }
+    for (int32_t i = 0; i < kProxies; ++i) {
+        expectSeen(gauges[i], makeLevel(i, 1, "gauge " + std::to_string(i)));
+    }
+}
+
+TEST(DeltaTest, FailedCallsAreRecoveredFrom) {
+    sp<IGauge> gauge = getGauge();
+    expectSeen(gauge, makeLevel(1, 2, "small"));
+
+    // Larger than a binder transaction may be.
+    Return<void> ret =
+            gauge->setLevel(makeLevel(1, 2, std::string(2 * 1024 * 1024, 'x')), [](const auto&) {});
+    EXPECT_FALSE(ret.isOk());
+
+    expectSeen(gauge, makeLevel(1, 5, "small"));
+    expectSeen(gauge, makeLevel(6, 5, "small"));
+}
+
+int main(int argc, char** argv) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        configureRpcThreadpool(4, true /* callerWillJoin */);
+        sp<IGauge> gauge = new Gauge();
+        CHECK_EQ(::android::OK, gauge->registerAsService());
+        joinRpcThreadpool();
+        return 1;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+    int status = RUN_ALL_TESTS();
+    kill(pid, SIGTERM);
+    return status;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl/tests/flatten_test/1.0/types.h>
+
+#include <gtest/gtest.h>
+
+using ::android::hardware::hidl_vec;
+using ::hidl::tests::flatten_test::V1_0::Point;
+using ::hidl::tests::flatten_test::V1_0::Table;
+
+TEST(FlattenTest, RoundTripsNestedVectors) {
+    const hidl_vec<hidl_vec<Point>> nested = {{{1, 2}, {3, 4}}, {}, {{5, 6}}};
+
+    const Table::FlatRows flat = Table::FlatRows::fromNested(nested);
+
+    ASSERT_EQ(3u, flat.rowCount());
+    EXPECT_EQ(2u, flat.row(0).size);
+    EXPECT_EQ(3, flat.row(0)[1].x);
+    EXPECT_EQ(0u, flat.row(1).size);
+    EXPECT_EQ(1u, flat.row(2).size);
+    EXPECT_EQ(6, flat.row(2)[0].y);
+    EXPECT_EQ(nested, flat.toNested());
+}
+
+TEST(FlattenTest, EmptyTable) {
+    const Table::FlatRows flat = Table::FlatRows::fromNested({});
+
+    EXPECT_EQ(0u, flat.rowCount());
+    EXPECT_EQ(0u, flat.toNested().size());
+}
@@ -21,6 +21,12 @@
 #include <ConstantExpression.h>
 #include <Coordinator.h>
 #include <hidl-util/FQName.h>
+#include <hidl-util/Formatter.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <map>
 
 #define EXPECT_EQ_OK(expectResult, call, ...)        \
     do {                                             \
@@ -94,6 +100,64 @@ TEST_F(HidlGenHostTest, CoordinatorFilepathTest) {
     EXPECT_EQ_OK("foo/a/b/c/V1_2/", coordinator.getFilepath, kName, Location::GEN_SANITIZED, "");
 }
 
+TEST_F(HidlGenHostTest, CoordinatorOutputManifestTest) {
+    using Location = Coordinator::Location;
+
+    char dirTemplate[] = "/tmp/hidl-gen-host-test-XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dirTemplate));
+    const std::string dir = std::string(dirTemplate) + "/";
+    const std::string manifest = dir + "manifest";
+
+    const auto exists = [](const std::string& path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0;
+    };
+    const auto mtime = [](const std::string& path) {
+        struct stat st;
+        EXPECT_EQ(0, stat(path.c_str(), &st));
+        return st.st_mtime;
+    };
+    const auto generate = [&](const std::map<std::string, std::string>& files) {
+        Coordinator coordinator;
+        coordinator.setOutputPath(dir + "out/");
+        coordinator.setOutputManifest(manifest);
+
+        std::vector<std::string> outputFiles;
+        for (const auto& file : files) {
+            std::string path;
+            EXPECT_EQ(OK, coordinator.getFilepath(FQName("a.b", "1.0"), Location::DIRECT,
+                                                  file.first, &path));
+            outputFiles.push_back(path);
+
+            Formatter out = coordinator.getFormatter(FQName("a.b", "1.0"), Location::DIRECT,
+                                                     file.first);
+            EXPECT_TRUE(out.isValid());
+            out << file.second;
+        }
+        EXPECT_EQ(OK, coordinator.commitOutputs(outputFiles));
+    };
+
+    generate({{"x/a.h", "a"}, {"x/b.h", "b"}, {"c.h", "c"}});
+    EXPECT_TRUE(exists(dir + "out/x/a.h"));
+    EXPECT_TRUE(exists(dir + "out/x/b.h"));
+    EXPECT_TRUE(exists(dir + "out/c.h"));
+
+    // Make sure an unchanged file would get a different timestamp if it were rewritten.
+    struct timeval past[2] = {{1, 0}, {1, 0}};
+    ASSERT_EQ(0, utimes((dir + "out/c.h").c_str(), past));
+
+    generate({{"c.h", "c"}, {"d.h", "d"}});
+    EXPECT_FALSE(exists(dir + "out/x/a.h"));
+    EXPECT_FALSE(exists(dir + "out/x/b.h"));
+    EXPECT_FALSE(exists(dir + "out/x"));  // left empty
+    EXPECT_EQ(1, mtime(dir + "out/c.h"));
+    EXPECT_TRUE(exists(dir + "out/d.h"));
+
+    generate({{"c.h", "changed"}});
+    EXPECT_NE(1, mtime(dir + "out/c.h"));
+    EXPECT_FALSE(exists(dir + "out/d.h"));
+}
+
 TEST_F(HidlGenHostTest, LocationTest) {
     Location a{{"file", 3, 4}, {"file", 3, 5}};
     Location b{{"file", 3, 6}, {"file", 3, 7}};
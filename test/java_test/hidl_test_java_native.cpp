@@ -23,6 +23,7 @@
 #include <android/hardware/tests/baz/1.0/IBaz.h>
 #include <android/hardware/tests/safeunion/1.0/IOtherInterface.h>
 #include <android/hardware/tests/safeunion/1.0/ISafeUnion.h>
+#include <hidl/tests/java_vec_test/1.0/ISamples.h>
 
 #include <hidl/LegacySupport.h>
 #include <hidl/ServiceManagement.h>
@@ -40,6 +41,7 @@ using ::android::hardware::tests::baz::V1_0::IBaz;
 using ::android::hardware::tests::baz::V1_0::IBazCallback;
 using ::android::hardware::tests::safeunion::V1_0::IOtherInterface;
 using ::android::hardware::tests::safeunion::V1_0::ISafeUnion;
+using ::hidl::tests::java_vec_test::V1_0::ISamples;
 
 using ::android::hardware::hidl_array;
 using ::android::hardware::hidl_vec;
@@ -82,6 +84,28 @@ struct OtherInterface : public IOtherInterface {
     }
 };
 
+// What ISamples::transform does to each sample.
+static ISamples::Sample transformSample(const ISamples::Sample& sample) {
+    ISamples::Sample result;
+    result.valid = !sample.valid;
+    result.mode = static_cast<ISamples::Mode>((static_cast<uint8_t>(sample.mode) + 1) % 3);
+    result.value = sample.value * 2;
+    result.time = sample.time + 1;
+    result.last = !sample.last;
+    return result;
+}
+
+struct Samples : public ISamples {
+    Return<void> transform(const hidl_vec<Sample>& samples, transform_cb _hidl_cb) override {
+        hidl_vec<Sample> result(samples.size());
+        for (size_t i = 0; i < samples.size(); ++i) {
+            result[i] = transformSample(samples[i]);
+        }
+        _hidl_cb(result);
+        return Void();
+    }
+};
+
 using std::to_string;
 
 static void usage(const char *me) {
@@ -100,6 +124,7 @@ struct HidlTest : public ::testing::Test {
     sp<IBaz> baz;
     sp<ISafeUnion> safeunionInterface;
     sp<IOtherInterface> otherInterface;
+    sp<ISamples> samples;
 
     void SetUp() override {
         using namespace ::android::hardware;
@@ -118,6 +143,11 @@ struct HidlTest : public ::testing::Test {
         otherInterface = IOtherInterface::getService();
         CHECK(otherInterface != nullptr);
         CHECK(otherInterface->isRemote());
+
+        ::android::hardware::details::waitForHwService(ISamples::descriptor, "default");
+        samples = ISamples::getService();
+        CHECK(samples != nullptr);
+        CHECK(samples->isRemote());
     }
 
     void TearDown() override {
@@ -1023,6 +1053,27 @@ TEST_F(HidlTest, SafeUnionEqualityTest) {
     }));
 }
 
+TEST_F(HidlTest, VecOfScalarStructTest) {
+    hidl_vec<ISamples::Sample> input(100);
+    hidl_vec<ISamples::Sample> expected(input.size());
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i].valid = i % 2 == 0;
+        input[i].mode = static_cast<ISamples::Mode>(i % 3);
+        input[i].value = i * -1.25f;
+        input[i].time = INT64_MAX - 1000 + static_cast<int64_t>(i);
+        input[i].last = i % 5 == 0;
+        expected[i] = transformSample(input[i]);
+    }
+
+    EXPECT_OK(samples->transform(input, [&](const hidl_vec<ISamples::Sample>& result) {
+        EXPECT_EQ(expected, result);
+    }));
+    EXPECT_OK(samples->transform(hidl_vec<ISamples::Sample>(),
+                                 [&](const hidl_vec<ISamples::Sample>& result) {
+                                     EXPECT_EQ(0u, result.size());
+                                 }));
+}
+
 int main(int argc, char **argv) {
     setenv("TREBLE_TESTING_OVERRIDE", "true", true);
 
@@ -1084,6 +1135,10 @@ int main(int argc, char **argv) {
     status = otherInterface->registerAsService();
     CHECK(status == ::android::OK) << "IOtherInterface didn't register";
 
+    sp<ISamples> samples = new Samples();
+    status = samples->registerAsService();
+    CHECK(status == ::android::OK) << "ISamples didn't register";
+
     joinRpcThreadpool();
     return 0;
 }
@@ -35,6 +35,8 @@ import android.os.RemoteException;
 import android.os.HidlSupport;
 import android.util.Log;
 
+import hidl.tests.java_vec_test.V1_0.ISamples;
+
 import java.io.File;
 import java.io.FileDescriptor;
 import java.io.FileInputStream;
@@ -227,6 +229,41 @@ public final class HidlTestJava {
         ExpectTrue(!HidlSupport.deepEquals(l, r));
     }
 
+    // What ISamples.transform does to each sample.
+    private static ISamples.Sample transformSample(ISamples.Sample sample) {
+        ISamples.Sample result = new ISamples.Sample();
+        result.valid = !sample.valid;
+        result.mode = (byte) ((sample.mode + 1) % 3);
+        result.value = sample.value * 2;
+        result.time = sample.time + 1;
+        result.last = !sample.last;
+        return result;
+    }
+
+    private void runClientVecStructTests() throws RemoteException {
+        ISamples samplesInterface = ISamples.getService();
+        ExpectTrue(samplesInterface != null);
+
+        ArrayList<ISamples.Sample> samples = new ArrayList<>();
+        for (int i = 0; i < 100; ++i) {
+            ISamples.Sample sample = new ISamples.Sample();
+            sample.valid = i % 2 == 0;
+            sample.mode = (byte) (i % 3);
+            sample.value = i * -1.25f;
+            sample.time = Long.MAX_VALUE - 1000 + i;
+            sample.last = i % 5 == 0;
+            samples.add(sample);
+        }
+
+        ArrayList<ISamples.Sample> expected = new ArrayList<>();
+        for (ISamples.Sample sample : samples) {
+            expected.add(transformSample(sample));
+        }
+        ExpectDeepEq(expected, samplesInterface.transform(samples));
+        ExpectDeepEq(new ArrayList<ISamples.Sample>(),
+                     samplesInterface.transform(new ArrayList<ISamples.Sample>()));
+    }
+
     private void runClientSafeUnionTests() throws RemoteException, IOException {
         ISafeUnion safeunionInterface = ISafeUnion.getService();
 
@@ -869,6 +906,36 @@ public final class HidlTestJava {
 
         proxy.returnABunchOfStrings((a,b,c) -> Expect(a + b + c, "EinsZweiDrei"));
 
+        {
+            // A result the implementation leaves unset must not keep the
+            // value of an earlier call.
+            IBase.MyMask mask = new IBase.MyMask();
+            mask.value = IBaz.BitField.VALL;
+            IBaz.takeAMaskResults out = new IBaz.takeAMaskResults();
+
+            proxy.takeAMask(IBaz.BitField.VALL, (byte) 0, mask, IBaz.BitField.V1, out);
+            ExpectTrue(out.third == IBaz.BitField.V1);
+
+            out = new IBaz.takeAMaskResults();
+            proxy.takeAMask(IBaz.BitField.VALL, (byte) 0, mask, (byte) 0, out);
+            ExpectTrue(out.third == 0);
+        }
+
+        {
+            // Results start out empty rather than null, so that a stub can
+            // send the ones an implementation leaves unset.
+            IBaz.returnABunchOfStringsResults out = new IBaz.returnABunchOfStringsResults();
+            Expect(out.a + out.b + out.c, "");
+
+            proxy.returnABunchOfStrings(out);
+            Expect(out.a + out.b + out.c, "EinsZweiDrei");
+
+            // The holder is also a callback.
+            out = new IBaz.returnABunchOfStringsResults();
+            proxy.returnABunchOfStrings((IBaz.returnABunchOfStringsCallback) out);
+            Expect(out.a + out.b + out.c, "EinsZweiDrei");
+        }
+
         proxy.callMeLater(new BazCallback());
         System.gc();
         proxy.iAmFreeNow();
@@ -1103,6 +1170,7 @@ public final class HidlTestJava {
         }
 
         runClientSafeUnionTests();
+        runClientVecStructTests();
 
         // --- DEATH RECIPIENT TESTING ---
         // This must always be done last, since it will kill the native server process
@@ -1296,6 +1364,18 @@ public final class HidlTestJava {
                     (byte)(second.value & bf), (byte)((bf | bf) & third));
         }
 
+        @Override
+        public void takeAMask(byte bf, byte first, IBase.MyMask second, byte third,
+                takeAMaskResults out) {
+            out.bf = bf;
+            out.first = (byte)(bf | first);
+            out.second = (byte)(second.value & bf);
+            // Left unset, and so 0, when no bits of third are set.
+            if (third != 0) {
+                out.third = (byte)((bf | bf) & third);
+            }
+        }
+
         public LotsOfPrimitiveArrays testArrays(LotsOfPrimitiveArrays in) {
             return in;
         }
@@ -1620,6 +1700,17 @@ public final class HidlTestJava {
         }
     }
 
+    class Samples extends ISamples.Stub {
+        @Override
+        public ArrayList<ISamples.Sample> transform(ArrayList<ISamples.Sample> samples) {
+            ArrayList<ISamples.Sample> result = new ArrayList<>();
+            for (ISamples.Sample sample : samples) {
+                result.add(transformSample(sample));
+            }
+            return result;
+        }
+    }
+
     private void server() throws RemoteException {
         HwBinder.configureRpcThreadpool(1, true);
 
@@ -1632,6 +1723,9 @@ public final class HidlTestJava {
         OtherInterface otherInterface = new OtherInterface();
         otherInterface.registerAsService("default");
 
+        Samples samplesInterface = new Samples();
+        samplesInterface.registerAsService("default");
+
         HwBinder.joinRpcThreadpool();
     }
 }
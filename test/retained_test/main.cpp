@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl/tests/retained_test/1.0/BpHwStore.h>
+#include <hidl/tests/retained_test/1.0/IStore.h>
+
+#include <android-base/logging.h>
+#include <gtest/gtest.h>
+#include <hidl/HidlTransportSupport.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+using ::android::sp;
+using ::android::hardware::configureRpcThreadpool;
+using ::android::hardware::hidl_string;
+using ::android::hardware::hidl_vec;
+using ::android::hardware::joinRpcThreadpool;
+using ::android::hardware::Return;
+using ::android::hardware::Void;
+using ::hidl::tests::retained_test::V1_0::BpHwStore;
+using ::hidl::tests::retained_test::V1_0::IStore;
+
+struct Store : public IStore {
+    Return<void> getItems(uint32_t count, getItems_cb _hidl_cb) override {
+        hidl_vec<Item> items(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            items[i].name = "item " + std::to_string(i);
+            items[i].data = std::vector<uint8_t>(i, static_cast<uint8_t>(i));
+        }
+        _hidl_cb(items, "count " + std::to_string(count));
+        return Void();
+    }
+};
+
+static void expectItems(const BpHwStore::getItems_reply& reply, uint32_t count) {
+    EXPECT_EQ("count " + std::to_string(count), std::string(reply.label()));
+    ASSERT_EQ(count, reply.items().size());
+    for (uint32_t i = 0; i < count; ++i) {
+        EXPECT_EQ("item " + std::to_string(i), std::string(reply.items()[i].name));
+        EXPECT_EQ(std::vector<uint8_t>(i, static_cast<uint8_t>(i)),
+                  std::vector<uint8_t>(reply.items()[i].data));
+    }
+}
+
+// Makes the call through a proxy which is released before the reply is used.
+static BpHwStore::getItems_reply getItemsFromReleasedProxy(uint32_t count) {
+    sp<IStore> store = IStore::getService();
+    CHECK(store != nullptr);
+    CHECK(store->isRemote());
+    BpHwStore::getItems_reply reply;
+    Return<void> ret = BpHwStore::getItems_retained(store, count, &reply);
+    CHECK(ret.isOk()) << ret.description();
+    return reply;
+}
+
+TEST(RetainedTest, ReplyOutlivesTheCallAndTheProxy) {
+    BpHwStore::getItems_reply reply = getItemsFromReleasedProxy(50);
+
+    // Later calls do not reuse the retained parcel.
+    BpHwStore::getItems_reply other = getItemsFromReleasedProxy(3);
+    expectItems(reply, 50);
+    expectItems(other, 3);
+}
+
+TEST(RetainedTest, MovedReplyKeepsItsViews) {
+    BpHwStore::getItems_reply reply = getItemsFromReleasedProxy(10);
+    const IStore::Item* first = &reply.items()[0];
+
+    BpHwStore::getItems_reply moved = std::move(reply);
+    EXPECT_EQ(first, &moved.items()[0]);
+    expectItems(moved, 10);
+
+    // Assigning over a reply releases its parcel and takes the other one.
+    moved = getItemsFromReleasedProxy(4);
+    expectItems(moved, 4);
+}
+
+TEST(RetainedTest, LocalInterfacesAreRejected) {
+    sp<IStore> store = new Store();
+    BpHwStore::getItems_reply reply;
+    Return<void> ret = BpHwStore::getItems_retained(store, 1, &reply);
+    ASSERT_FALSE(ret.isOk());
+}
+
+int main(int argc, char** argv) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        configureRpcThreadpool(1, true /* callerWillJoin */);
+        sp<IStore> store = new Store();
+        CHECK_EQ(::android::OK, store->registerAsService());
+        joinRpcThreadpool();
+        return 1;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+    int status = RUN_ALL_TESTS();
+    kill(pid, SIGTERM);
+    return status;
+}
@@ -11,6 +11,16 @@ function run() {
 
     local RUN_TIME_TESTS=(\
         libhidl-gen-utils_test \
+        hidl_admission_test \
+        hidl_broadcast_test \
+        hidl_call_group_test \
+        hidl_callback_executor_test \
+        hidl_callback_threads_test \
+        hidl_coalesce_test \
+        hidl_delta_test \
+        hidl_retained_test \
+        hidl_shared_memory_test \
+        hidl_transaction_capture_test \
     )
     RUN_TIME_TESTS+=(${RELATED_RUNTIME_TESTS[@]})
 
@@ -5,8 +5,11 @@ function run() {
 
     local COMPILE_TIME_TESTS=(\
         hidl_error_test \
+        hidl_flatten_test \
+        hidl_bounded_test \
         hidl_export_test \
         hidl_hash_test \
+        hidl_perf_lint_test \
         hidl_impl_test \
         hidl_system_api_test \
         android.hardware.tests.foo@1.0-vts.driver \
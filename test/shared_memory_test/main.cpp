@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl/tests/shared_memory_test/1.0/IShared.h>
+
+#include <android-base/logging.h>
+#include <gtest/gtest.h>
+#include <hidl/HidlTransportSupport.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+using ::android::sp;
+using ::android::hardware::configureRpcThreadpool;
+using ::android::hardware::joinRpcThreadpool;
+using ::android::hardware::Return;
+using ::hidl::tests::shared_memory_test::V1_0::IShared;
+
+// Channels a client gets from one stub process before falling back to binder.
+static constexpr size_t kMaxChannelsPerClient = 4;
+
+struct Shared : public IShared {
+    static std::atomic<int32_t> sLive;
+
+    Shared() { ++sLive; }
+    ~Shared() { --sLive; }
+
+    Return<int32_t> add(int32_t a, int32_t b) override { return a + b; }
+
+    Return<bool> isSharedMemoryCall() override {
+        char name[16] = {};
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        return strcmp(name, "HwShmChannel") == 0;
+    }
+
+    Return<sp<IShared>> create() override { return new Shared(); }
+
+    Return<int32_t> liveObjects() override { return sLive.load(); }
+};
+
+std::atomic<int32_t> Shared::sLive{0};
+
+// Creates another object of shared whose calls go through shared memory,
+// waiting for the stub process to take back the channels of objects which
+// were released.
+static sp<IShared> createWithChannel(const sp<IShared>& shared) {
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        sp<IShared> other = shared->create();
+        if (other != nullptr && other->isSharedMemoryCall()) return other;
+        usleep(10000);
+    }
+    return nullptr;
+}
+
+TEST(SharedMemoryTest, CallsGoThroughSharedMemory) {
+    sp<IShared> shared = IShared::getService();
+    ASSERT_NE(nullptr, shared.get());
+
+    EXPECT_TRUE(shared->isSharedMemoryCall());
+    for (int32_t i = 0; i < 1000; ++i) {
+        EXPECT_EQ(2 * i + 1, static_cast<int32_t>(shared->add(i, i + 1)));
+    }
+}
+
+TEST(SharedMemoryTest, ChannelsPerClientAreCapped) {
+    sp<IShared> shared = IShared::getService();
+    ASSERT_NE(nullptr, shared.get());
+    ASSERT_TRUE(shared->isSharedMemoryCall());
+
+    // The service holds one channel; the objects created here take the rest,
+    // and the calls of any later object go through binder.
+    std::vector<sp<IShared>> created;
+    for (size_t i = 1; i <= kMaxChannelsPerClient; ++i) {
+        sp<IShared> other = shared->create();
+        ASSERT_NE(nullptr, other.get());
+        EXPECT_EQ(i < kMaxChannelsPerClient, static_cast<bool>(other->isSharedMemoryCall()));
+        EXPECT_EQ(3, static_cast<int32_t>(other->add(1, 2)));
+        created.push_back(other);
+    }
+}
+
+TEST(SharedMemoryTest, ReleasedObjectsGiveBackTheirChannels) {
+    sp<IShared> shared = IShared::getService();
+    ASSERT_NE(nullptr, shared.get());
+    ASSERT_TRUE(shared->isSharedMemoryCall());
+    const int32_t live = shared->liveObjects();
+
+    // Each round takes every channel left, which it only gets back once the
+    // objects of the round before are released.
+    for (int round = 0; round < 3; ++round) {
+        std::vector<sp<IShared>> created;
+        for (size_t i = 1; i < kMaxChannelsPerClient; ++i) {
+            created.push_back(createWithChannel(shared));
+            ASSERT_NE(nullptr, created.back().get());
+        }
+        created.clear();
+
+        // Open channels do not keep the objects alive.
+        for (int attempt = 0; attempt < 100 && shared->liveObjects() != live; ++attempt) {
+            usleep(10000);
+        }
+        EXPECT_EQ(live, static_cast<int32_t>(shared->liveObjects()));
+    }
+}
+
+int main(int argc, char** argv) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        configureRpcThreadpool(1, true /* callerWillJoin */);
+        sp<IShared> shared = new Shared();
+        CHECK_EQ(::android::OK, shared->registerAsService());
+        joinRpcThreadpool();
+        return 1;
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+    int status = RUN_ALL_TESTS();
+    kill(pid, SIGTERM);
+    return status;
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl/tests/transaction_capture_test/1.0/BpHwCounter.h>
+#include <hidl/tests/transaction_capture_test/1.0/ICounter.h>
+#include <hidl/tests/transaction_capture_test/1.0/ReplayCounter.h>
+
+#include <gtest/gtest.h>
+#include <hidl-gen-support/TransactionCapture.h>
+#include <hidl/HidlTransportSupport.h>
+
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+using ::android::OK;
+using ::android::sp;
+using ::android::hardware::hidl_string;
+using ::android::hardware::hidl_vec;
+using ::android::hardware::Parcel;
+using ::android::hardware::Return;
+using ::android::hardware::toBinder;
+using ::android::hardware::Void;
+using ::android::hardware::details::appendHidlTransaction;
+using ::android::hardware::details::hidl_transaction;
+using ::android::hardware::details::hidl_transaction_record;
+using ::android::hardware::details::hidl_transaction_side;
+using ::android::hardware::details::hidlCaptureBegin;
+using ::android::hardware::details::hidlCaptureEnd;
+using ::android::hardware::details::readHidlTransaction;
+using ::android::hardware::details::setHidlTransactionRecorder;
+using ::android::hardware::details::writeHidlRequest;
+using ::hidl::tests::transaction_capture_test::V1_0::BpHwCounter;
+using ::hidl::tests::transaction_capture_test::V1_0::ICounter;
+using ::hidl::tests::transaction_capture_test::V1_0::ReplayCounter;
+
+static std::mutex gTraceLock;
+static std::vector<uint8_t> gTrace;
+
+static void recordTransaction(const hidl_transaction_record& record) {
+    std::lock_guard<std::mutex> lock(gTraceLock);
+    EXPECT_TRUE(appendHidlTransaction(record, &gTrace));
+}
+
+struct Counter : public ICounter {
+    Return<int32_t> add(int32_t value) override { return mTotal += value; }
+
+    Return<void> addName(const hidl_string& name) override {
+        mNames.push_back(name);
+        return Void();
+    }
+
+    Return<void> getNames(getNames_cb _hidl_cb) override {
+        _hidl_cb(hidl_vec<hidl_string>(mNames));
+        return Void();
+    }
+
+    int32_t mTotal = 0;
+    std::vector<hidl_string> mNames;
+};
+
+class TransactionCaptureTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        std::lock_guard<std::mutex> lock(gTraceLock);
+        gTrace.clear();
+    }
+
+    void TearDown() override { setHidlTransactionRecorder(nullptr); }
+
+    // Calls counter through a proxy while recording both sides of each call.
+    void record(const sp<Counter>& counter) {
+        sp<ICounter> proxy = new BpHwCounter(toBinder<ICounter>(counter));
+
+        setHidlTransactionRecorder(recordTransaction);
+        EXPECT_EQ(3, static_cast<int32_t>(proxy->add(3)));
+        EXPECT_TRUE(proxy->addName("first").isOk());
+        EXPECT_EQ(7, static_cast<int32_t>(proxy->add(4)));
+        EXPECT_TRUE(proxy->addName("second").isOk());
+        setHidlTransactionRecorder(nullptr);
+    }
+};
+
+struct Str {
+    const char* data;
+    uint64_t size;
+};
+
+TEST_F(TransactionCaptureTest, TraceRoundTrip) {
+    const char text[] = "hello";
+    Str str{text, 5};
+    Parcel data;
+    size_t parent;
+    size_t child;
+    data.writeInt32(7);
+    ASSERT_EQ(OK, data.writeBuffer(&str, sizeof(str), &parent));
+    ASSERT_EQ(OK, data.writeEmbeddedBuffer(text, sizeof(text), &child, parent, 0));
+    data.writeInt32(9);
+
+    EXPECT_LT(hidlCaptureBegin(), 0);
+    setHidlTransactionRecorder(recordTransaction);
+    int64_t startNs = hidlCaptureBegin();
+    ASSERT_GE(startNs, 0);
+    hidlCaptureEnd("hidl.tests@1.0::IFoo", 3, 1, hidl_transaction_side::SERVER, startNs, data);
+    setHidlTransactionRecorder(nullptr);
+
+    const uint8_t* cursor = gTrace.data();
+    const uint8_t* end = cursor + gTrace.size();
+    hidl_transaction transaction;
+    ASSERT_TRUE(readHidlTransaction(&cursor, end, &transaction));
+    EXPECT_EQ(end, cursor);
+    EXPECT_EQ(hidl_transaction_side::SERVER, transaction.side);
+    EXPECT_EQ(3u, transaction.code);
+    EXPECT_EQ(1u, transaction.flags);
+    EXPECT_EQ(startNs, transaction.startNs);
+    EXPECT_EQ("hidl.tests@1.0::IFoo", transaction.descriptor);
+    ASSERT_EQ(2u, transaction.buffers.size());
+
+    Parcel request;
+    ASSERT_EQ(OK, writeHidlRequest(&transaction, &request));
+    ASSERT_EQ(data.ipcDataSize(), request.ipcDataSize());
+    int32_t first;
+    int32_t last;
+    memcpy(&first, request.ipcData(), sizeof(first));
+    memcpy(&last, request.ipcData() + request.ipcDataSize() - sizeof(last), sizeof(last));
+    EXPECT_EQ(7, first);
+    EXPECT_EQ(9, last);
+
+    // The rebuilt parent points at the rebuilt copy of its embedded buffer.
+    binder_buffer_object object;
+    memcpy(&object, request.ipcData() + request.ipcObjects()[0], sizeof(object));
+    const Str* rebuilt = reinterpret_cast<const Str*>(object.buffer);
+    EXPECT_EQ(5u, rebuilt->size);
+    EXPECT_STREQ("hello", rebuilt->data);
+    EXPECT_NE(static_cast<const void*>(text), static_cast<const void*>(rebuilt->data));
+}
+
+TEST_F(TransactionCaptureTest, TruncatedTraceIsRejected) {
+    record(new Counter());
+    ASSERT_FALSE(gTrace.empty());
+
+    const uint8_t* cursor = gTrace.data();
+    hidl_transaction transaction;
+    ASSERT_TRUE(readHidlTransaction(&cursor, gTrace.data() + gTrace.size(), &transaction));
+    size_t firstSize = cursor - gTrace.data();
+    for (size_t size = 0; size < firstSize; ++size) {
+        cursor = gTrace.data();
+        EXPECT_FALSE(readHidlTransaction(&cursor, gTrace.data() + size, &transaction)) << size;
+    }
+
+    std::vector<uint8_t> truncated(gTrace.begin(), gTrace.end() - 1);
+    ReplayCounter replay(new Counter());
+    EXPECT_EQ(::android::BAD_VALUE, replay.replay(truncated, 0));
+}
+
+TEST_F(TransactionCaptureTest, ReplaysClientCalls) {
+    record(new Counter());
+
+    sp<Counter> target = new Counter();
+    ReplayCounter replay(target);
+    ASSERT_EQ(OK, replay.replay(gTrace, 0));
+    EXPECT_EQ(4u, replay.replayedCount());
+    EXPECT_EQ(0u, replay.failedCount());
+    EXPECT_EQ(0u, replay.skippedCount());
+    EXPECT_EQ(7, target->mTotal);
+    EXPECT_EQ((std::vector<hidl_string>{"first", "second"}), target->mNames);
+}
+
+TEST_F(TransactionCaptureTest, ReplaysServerCallsThroughProxy) {
+    record(new Counter());
+
+    sp<Counter> target = new Counter();
+    sp<ICounter> proxy = new BpHwCounter(toBinder<ICounter>(target));
+    ReplayCounter replay(proxy);
+    ASSERT_EQ(OK, replay.replay(gTrace, 0, hidl_transaction_side::SERVER));
+    EXPECT_EQ(4u, replay.replayedCount());
+    EXPECT_EQ(7, target->mTotal);
+
+    hidl_vec<hidl_string> names;
+    EXPECT_TRUE(proxy->getNames([&](const auto& seen) { names = seen; }).isOk());
+    EXPECT_EQ((std::vector<hidl_string>{"first", "second"}), std::vector<hidl_string>(names));
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -318,6 +318,10 @@ std::string FQName::getInterfaceAdapterName() const {
     return "A" + getInterfaceBaseName();
 }
 
+std::string FQName::getInterfaceReplayName() const {
+    return "Replay" + getInterfaceBaseName();
+}
+
 std::string FQName::getInterfaceHwName() const {
     return "IHw" + getInterfaceBaseName();
 }
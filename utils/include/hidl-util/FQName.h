@@ -118,6 +118,11 @@ struct FQName {
     // -> ABar
     std::string getInterfaceAdapterName() const;
 
+    // Must be called on an interface
+    // android.hardware.foo@1.0::IBar
+    // -> ReplayBar
+    std::string getInterfaceReplayName() const;
+
     // Must be called on an interface
     // android.hardware.foo@1.0::IBar
     // -> IBar